@@ -38,6 +38,7 @@
 #include <seccomp.h>
 
 #include "arch.h"
+#include "cache.h"
 #include "db.h"
 #include "gen_pfc.h"
 #include "gen_bpf.h"
@@ -322,6 +323,51 @@ API int seccomp_load(const scmp_filter_ctx ctx)
 	return sys_filter_load(col);
 }
 
+/* NOTE - function header comment in include/seccomp.h */
+API int seccomp_load_raw(const void *bpf, size_t len, uint32_t flags)
+{
+	struct bpf_program prgm;
+
+	if (bpf == NULL || len == 0 || len % sizeof(bpf_instr_raw) != 0 ||
+	    len / sizeof(bpf_instr_raw) > BPF_MAXINSNS)
+		return -EINVAL;
+	if (flags & ~(SCMP_LOAD_NNP | SCMP_LOAD_TSYNC | SCMP_LOAD_LOG |
+		      SCMP_LOAD_SPEC_ALLOW | SCMP_LOAD_NEW_LISTENER))
+		return -EINVAL;
+
+	prgm.blk_cnt = len / sizeof(bpf_instr_raw);
+	prgm.blks = (bpf_instr_raw *)bpf;
+
+	return sys_filter_load_raw(&prgm, flags);
+}
+
+/* NOTE - function header comment in include/seccomp.h */
+API int seccomp_prepare(const scmp_filter_ctx ctx, scmp_filter_prep *prep)
+{
+	struct db_filter_col *col;
+
+	if (_ctx_valid(ctx) || prep == NULL)
+		return -EINVAL;
+	col = (struct db_filter_col *)ctx;
+
+	return sys_filter_prepare(col, (struct sys_filter_prep **)prep);
+}
+
+/* NOTE - function header comment in include/seccomp.h */
+API int seccomp_load_prepared(const scmp_filter_prep prep)
+{
+	if (prep == NULL)
+		return -EINVAL;
+
+	return sys_filter_load_prepared((const struct sys_filter_prep *)prep);
+}
+
+/* NOTE - function header comment in include/seccomp.h */
+API void seccomp_prepare_release(scmp_filter_prep prep)
+{
+	sys_filter_prepare_release((struct sys_filter_prep *)prep);
+}
+
 /* NOTE - function header comment in include/seccomp.h */
 API int seccomp_attr_get(const scmp_filter_ctx ctx,
 			 enum scmp_filter_attr attr, uint32_t *value)
@@ -342,12 +388,34 @@ API int seccomp_attr_set(scmp_filter_ctx ctx,
 	return db_col_attr_set((struct db_filter_col *)ctx, attr, value);
 }
 
+/* NOTE - function header comment in include/seccomp.h */
+API int seccomp_stat_get(const scmp_filter_ctx ctx,
+			 enum scmp_filter_stat stat, uint64_t *value)
+{
+	if (_ctx_valid(ctx) || value == NULL)
+		return -EINVAL;
+
+	return db_col_stat_get((const struct db_filter_col *)ctx, stat, value);
+}
+
 /* NOTE - function header comment in include/seccomp.h */
 API char *seccomp_syscall_resolve_num_arch(uint32_t arch_token, int num)
 {
-	const struct arch_def *arch;
 	const char *name;
 
+	name = seccomp_syscall_resolve_num_arch_static(arch_token, num);
+	if (name == NULL)
+		return NULL;
+
+	return strdup(name);
+}
+
+/* NOTE - function header comment in include/seccomp.h */
+API const char *seccomp_syscall_resolve_num_arch_static(uint32_t arch_token,
+							int num)
+{
+	const struct arch_def *arch;
+
 	if (arch_token == 0)
 		arch_token = arch_def_native->token;
 	if (arch_valid(arch_token))
@@ -356,11 +424,9 @@ API char *seccomp_syscall_resolve_num_arch(uint32_t arch_token, int num)
 	if (arch == NULL)
 		return NULL;
 
-	name = arch_syscall_resolve_num(arch, num);
-	if (name == NULL)
-		return NULL;
-
-	return strdup(name);
+	/* NOTE: the syscall names are all static, either in the generated
+	 *       syscall table or string literals in the arch code */
+	return arch_syscall_resolve_num(arch, num);
 }
 
 /* NOTE - function header comment in include/seccomp.h */
@@ -420,6 +486,55 @@ API int seccomp_syscall_resolve_name(const char *name)
 	return seccomp_syscall_resolve_name_arch(SCMP_ARCH_NATIVE, name);
 }
 
+/* NOTE - function header comment in include/seccomp.h */
+API int seccomp_syscall_resolve_names(const uint32_t *arch_tokens,
+				      unsigned int arch_cnt,
+				      const char **names, unsigned int name_cnt,
+				      int *syscalls)
+{
+	unsigned int iter_a, iter_n;
+	uint32_t arch_token;
+	const struct arch_def *arch;
+	int *sys_iter;
+	int row;
+
+	if (arch_cnt == 0 || name_cnt == 0)
+		return 0;
+	if (arch_tokens == NULL || names == NULL || syscalls == NULL)
+		return -EINVAL;
+
+	/* check all of the arches first so we never return partial results */
+	for (iter_a = 0; iter_a < arch_cnt; iter_a++) {
+		arch_token = arch_tokens[iter_a];
+		if (arch_token != 0 && arch_valid(arch_token))
+			return -EINVAL;
+	}
+
+	/* the syscall table row is the same for every arch */
+	sys_iter = syscalls;
+	for (iter_n = 0; iter_n < name_cnt; iter_n++) {
+		if (names[iter_n] == NULL) {
+			for (iter_a = 0; iter_a < arch_cnt; iter_a++)
+				*sys_iter++ = __NR_SCMP_ERROR;
+			continue;
+		}
+
+		row = arch_syscall_row(names[iter_n]);
+		for (iter_a = 0; iter_a < arch_cnt; iter_a++) {
+			arch_token = arch_tokens[iter_a];
+			if (arch_token == 0)
+				arch = arch_def_native;
+			else
+				arch = arch_def_lookup(arch_token);
+			*sys_iter++ = arch_syscall_resolve_name_row(arch,
+								   names[iter_n],
+								   row);
+		}
+	}
+
+	return 0;
+}
+
 /* NOTE - function header comment in include/seccomp.h */
 API int seccomp_syscall_priority(scmp_filter_ctx ctx,
 				 int syscall, uint8_t priority)
@@ -432,6 +547,15 @@ API int seccomp_syscall_priority(scmp_filter_ctx ctx,
 	return db_col_syscall_priority(col, syscall, priority);
 }
 
+/* NOTE - function header comment in include/seccomp.h */
+API int seccomp_profile_load(scmp_filter_ctx ctx, int fd)
+{
+	if (_ctx_valid(ctx) || fd < 0)
+		return -EINVAL;
+
+	return db_col_syscall_profile((struct db_filter_col *)ctx, fd);
+}
+
 /* NOTE - function header comment in include/seccomp.h */
 API int seccomp_rule_add_array(scmp_filter_ctx ctx,
 			       uint32_t action, int syscall,
@@ -534,6 +658,46 @@ API int seccomp_rule_add_exact(scmp_filter_ctx ctx,
 	return rc;
 }
 
+/* NOTE - function header comment in include/seccomp.h */
+API int seccomp_rule_add_bulk(scmp_filter_ctx ctx,
+			      const struct scmp_rule *rules, size_t rule_cnt,
+			      uint32_t flags)
+{
+	int rc;
+	size_t iter;
+	const struct scmp_rule *rule;
+	struct db_filter_col *col = (struct db_filter_col *)ctx;
+
+	if (db_col_valid(col))
+		return -EINVAL;
+	if (rule_cnt > 0 && rules == NULL)
+		return -EINVAL;
+	if (flags & ~SCMP_RULE_EXACT)
+		return -EINVAL;
+	if ((flags & SCMP_RULE_EXACT) && col->filter_cnt > 1)
+		return -EOPNOTSUPP;
+
+	/* check all of the rules before changing anything */
+	for (iter = 0; iter < rule_cnt; iter++) {
+		rule = &rules[iter];
+		if (rule->arg_cnt > ARG_COUNT_MAX)
+			return -EINVAL;
+		if (rule->arg_cnt > 0 && rule->arg_array == NULL)
+			return -EINVAL;
+		if (_syscall_valid(col, rule->syscall))
+			return -EINVAL;
+
+		rc = db_col_action_valid(col, rule->action);
+		if (rc < 0)
+			return rc;
+		if (rule->action == col->attr.act_default)
+			return -EPERM;
+	}
+
+	return db_col_rule_add_bulk(col, (flags & SCMP_RULE_EXACT) != 0,
+				    rules, rule_cnt);
+}
+
 /* NOTE - function header comment in include/seccomp.h */
 API int seccomp_notify_alloc(struct seccomp_notif **req,
 			     struct seccomp_notif_resp **resp)
@@ -581,6 +745,12 @@ API int seccomp_notify_fd(const scmp_filter_ctx ctx)
 	return col->notify_fd;
 }
 
+/* NOTE - function header comment in include/seccomp.h */
+API int seccomp_cache_set(unsigned int size, const char *path)
+{
+	return cache_set(size, path);
+}
+
 /* NOTE - function header comment in include/seccomp.h */
 API int seccomp_export_pfc(const scmp_filter_ctx ctx, int fd)
 {
@@ -609,3 +779,56 @@ API int seccomp_export_bpf(const scmp_filter_ctx ctx, int fd)
 
 	return 0;
 }
+
+/* NOTE - function header comment in include/seccomp.h */
+API int seccomp_export_bpf_mem(const scmp_filter_ctx ctx, void *buf,
+			       size_t *len)
+{
+	int rc = 0;
+	size_t size;
+	struct bpf_program *program;
+
+	if (_ctx_valid(ctx) || len == NULL)
+		return -EINVAL;
+
+	program = gen_bpf_generate((struct db_filter_col *)ctx);
+	if (program == NULL)
+		return -ENOMEM;
+	size = BPF_PGM_SIZE(program);
+	if (buf != NULL) {
+		if (size > *len)
+			rc = -ERANGE;
+		else
+			memcpy(buf, program->blks, size);
+	}
+	*len = size;
+	gen_bpf_release(program);
+
+	return rc;
+}
+
+/* NOTE - function header comment in include/seccomp.h */
+API int seccomp_export_ctx(const scmp_filter_ctx ctx, void *buf, size_t *len)
+{
+	if (_ctx_valid(ctx) || len == NULL)
+		return -EINVAL;
+
+	return db_col_export((struct db_filter_col *)ctx, buf, len);
+}
+
+/* NOTE - function header comment in include/seccomp.h */
+API int seccomp_import_ctx(const void *buf, size_t len, scmp_filter_ctx *ctx)
+{
+	int rc;
+	struct db_filter_col *col;
+
+	if (buf == NULL || ctx == NULL)
+		return -EINVAL;
+
+	rc = db_col_import(buf, len, &col);
+	if (rc < 0)
+		return rc;
+	*ctx = col;
+
+	return 0;
+}
@@ -25,14 +25,16 @@
 
 #include "arch.h"
 #include "arch-aarch64.h"
+#include "arch-syscall-tbl.h"
 
 const struct arch_def arch_def_aarch64 = {
 	.token = SCMP_ARCH_AARCH64,
 	.token_bpf = AUDIT_ARCH_AARCH64,
 	.size = ARCH_SIZE_64,
 	.endian = ARCH_ENDIAN_LITTLE,
-	.syscall_resolve_name = aarch64_syscall_resolve_name,
-	.syscall_resolve_num = aarch64_syscall_resolve_num,
+	.syscalls = &arch_syscall_col_aarch64,
+	.syscall_resolve_name = NULL,
+	.syscall_resolve_num = NULL,
 	.syscall_rewrite = NULL,
 	.rule_add = NULL,
 };
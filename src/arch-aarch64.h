@@ -29,9 +29,4 @@
 
 extern const struct arch_def arch_def_aarch64;
 
-int aarch64_syscall_resolve_name(const char *name);
-const char *aarch64_syscall_resolve_num(int num);
-
-const struct arch_syscall_def *aarch64_syscall_iterate(unsigned int spot);
-
 #endif
@@ -25,14 +25,16 @@
 
 #include "arch.h"
 #include "arch-arm.h"
+#include "arch-syscall-tbl.h"
 
 const struct arch_def arch_def_arm = {
 	.token = SCMP_ARCH_ARM,
 	.token_bpf = AUDIT_ARCH_ARM,
 	.size = ARCH_SIZE_32,
 	.endian = ARCH_ENDIAN_LITTLE,
-	.syscall_resolve_name = arm_syscall_resolve_name,
-	.syscall_resolve_num = arm_syscall_resolve_num,
+	.syscalls = &arch_syscall_col_arm,
+	.syscall_resolve_name = NULL,
+	.syscall_resolve_num = NULL,
 	.syscall_rewrite = NULL,
 	.rule_add = NULL,
 };
@@ -26,8 +26,6 @@
  * along with this library; if not, see <http://www.gnu.org/licenses>.
  */
 
-#include <string.h>
-
 #include <seccomp.h>
 
 #include "arch.h"
@@ -36,6 +34,9 @@
 /* O32 ABI */
 #define __SCMP_NR_BASE		4000
 
+/* NOTE: this table is not built into the library, arch-syscall-mktbl turns
+ *       it into the generated syscall table at build time */
+
 /* NOTE: based on Linux v5.4-rc4 */
 const struct arch_syscall_def mips_syscall_table[] = { \
 	{ "_llseek", (__SCMP_NR_BASE + 140) },
@@ -509,63 +510,3 @@ const struct arch_syscall_def mips_syscall_table[] = { \
 	{ "writev", (__SCMP_NR_BASE + 146) },
 	{ NULL, __NR_SCMP_ERROR },
 };
-
-/**
- * Resolve a syscall name to a number
- * @param name the syscall name
- *
- * Resolve the given syscall name to the syscall number using the syscall table.
- * Returns the syscall number on success, including negative pseudo syscall
- * numbers; returns __NR_SCMP_ERROR on failure.
- *
- */
-int mips_syscall_resolve_name(const char *name)
-{
-	unsigned int iter;
-	const struct arch_syscall_def *table = mips_syscall_table;
-
-	/* XXX - plenty of room for future improvement here */
-	for (iter = 0; table[iter].name != NULL; iter++) {
-		if (strcmp(name, table[iter].name) == 0)
-			return table[iter].num;
-	}
-
-	return __NR_SCMP_ERROR;
-}
-
-/**
- * Resolve a syscall number to a name
- * @param num the syscall number
- *
- * Resolve the given syscall number to the syscall name using the syscall table.
- * Returns a pointer to the syscall name string on success, including pseudo
- * syscall names; returns NULL on failure.
- *
- */
-const char *mips_syscall_resolve_num(int num)
-{
-	unsigned int iter;
-	const struct arch_syscall_def *table = mips_syscall_table;
-
-	/* XXX - plenty of room for future improvement here */
-	for (iter = 0; table[iter].num != __NR_SCMP_ERROR; iter++) {
-		if (num == table[iter].num)
-			return table[iter].name;
-	}
-
-	return NULL;
-}
-
-/**
- * Iterate through the syscall table and return the syscall mapping
- * @param spot the offset into the syscall table
- *
- * Return the syscall mapping at position @spot or NULL on failure.  This
- * function should only ever be used internally by libseccomp.
- *
- */
-const struct arch_syscall_def *mips_syscall_iterate(unsigned int spot)
-{
-	/* XXX - no safety checks here */
-	return &mips_syscall_table[spot];
-}
@@ -26,14 +26,16 @@
 
 #include "arch.h"
 #include "arch-mips.h"
+#include "arch-syscall-tbl.h"
 
 const struct arch_def arch_def_mips = {
 	.token = SCMP_ARCH_MIPS,
 	.token_bpf = AUDIT_ARCH_MIPS,
 	.size = ARCH_SIZE_32,
 	.endian = ARCH_ENDIAN_BIG,
-	.syscall_resolve_name = mips_syscall_resolve_name,
-	.syscall_resolve_num = mips_syscall_resolve_num,
+	.syscalls = &arch_syscall_col_mips,
+	.syscall_resolve_name = NULL,
+	.syscall_resolve_num = NULL,
 	.syscall_rewrite = NULL,
 	.rule_add = NULL,
 };
@@ -43,8 +45,9 @@ const struct arch_def arch_def_mipsel = {
 	.token_bpf = AUDIT_ARCH_MIPSEL,
 	.size = ARCH_SIZE_32,
 	.endian = ARCH_ENDIAN_LITTLE,
-	.syscall_resolve_name = mips_syscall_resolve_name,
-	.syscall_resolve_num = mips_syscall_resolve_num,
+	.syscalls = &arch_syscall_col_mips,
+	.syscall_resolve_name = NULL,
+	.syscall_resolve_num = NULL,
 	.syscall_rewrite = NULL,
 	.rule_add = NULL,
 };
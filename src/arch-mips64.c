@@ -24,14 +24,16 @@
 
 #include "arch.h"
 #include "arch-mips64.h"
+#include "arch-syscall-tbl.h"
 
 const struct arch_def arch_def_mips64 = {
 	.token = SCMP_ARCH_MIPS64,
 	.token_bpf = AUDIT_ARCH_MIPS64,
 	.size = ARCH_SIZE_64,
 	.endian = ARCH_ENDIAN_BIG,
-	.syscall_resolve_name = mips64_syscall_resolve_name,
-	.syscall_resolve_num = mips64_syscall_resolve_num,
+	.syscalls = &arch_syscall_col_mips64,
+	.syscall_resolve_name = NULL,
+	.syscall_resolve_num = NULL,
 	.syscall_rewrite = NULL,
 	.rule_add = NULL,
 };
@@ -41,8 +43,9 @@ const struct arch_def arch_def_mipsel64 = {
 	.token_bpf = AUDIT_ARCH_MIPSEL64,
 	.size = ARCH_SIZE_64,
 	.endian = ARCH_ENDIAN_LITTLE,
-	.syscall_resolve_name = mips64_syscall_resolve_name,
-	.syscall_resolve_num = mips64_syscall_resolve_num,
+	.syscalls = &arch_syscall_col_mips64,
+	.syscall_resolve_name = NULL,
+	.syscall_resolve_num = NULL,
 	.syscall_rewrite = NULL,
 	.rule_add = NULL,
 };
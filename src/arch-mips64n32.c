@@ -26,14 +26,16 @@
 
 #include "arch.h"
 #include "arch-mips64n32.h"
+#include "arch-syscall-tbl.h"
 
 const struct arch_def arch_def_mips64n32 = {
 	.token = SCMP_ARCH_MIPS64N32,
 	.token_bpf = AUDIT_ARCH_MIPS64N32,
 	.size = ARCH_SIZE_32,
 	.endian = ARCH_ENDIAN_BIG,
-	.syscall_resolve_name = mips64n32_syscall_resolve_name,
-	.syscall_resolve_num = mips64n32_syscall_resolve_num,
+	.syscalls = &arch_syscall_col_mips64n32,
+	.syscall_resolve_name = NULL,
+	.syscall_resolve_num = NULL,
 	.syscall_rewrite = NULL,
 	.rule_add = NULL,
 };
@@ -43,8 +45,9 @@ const struct arch_def arch_def_mipsel64n32 = {
 	.token_bpf = AUDIT_ARCH_MIPSEL64N32,
 	.size = ARCH_SIZE_32,
 	.endian = ARCH_ENDIAN_LITTLE,
-	.syscall_resolve_name = mips64n32_syscall_resolve_name,
-	.syscall_resolve_num = mips64n32_syscall_resolve_num,
+	.syscalls = &arch_syscall_col_mips64n32,
+	.syscall_resolve_name = NULL,
+	.syscall_resolve_num = NULL,
 	.syscall_rewrite = NULL,
 	.rule_add = NULL,
 };
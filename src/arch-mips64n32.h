@@ -31,9 +31,4 @@
 extern const struct arch_def arch_def_mips64n32;
 extern const struct arch_def arch_def_mipsel64n32;
 
-int mips64n32_syscall_resolve_name(const char *name);
-const char *mips64n32_syscall_resolve_num(int num);
-
-const struct arch_syscall_def *mips64n32_syscall_iterate(unsigned int spot);
-
 #endif
@@ -30,9 +30,4 @@
 extern const struct arch_def arch_def_parisc;
 extern const struct arch_def arch_def_parisc64;
 
-int parisc_syscall_resolve_name(const char *name);
-const char *parisc_syscall_resolve_num(int num);
-
-const struct arch_syscall_def *parisc_syscall_iterate(unsigned int spot);
-
 #endif
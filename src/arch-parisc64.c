@@ -9,14 +9,16 @@
 
 #include "arch.h"
 #include "arch-parisc.h"
+#include "arch-syscall-tbl.h"
 
 const struct arch_def arch_def_parisc64 = {
 	.token = SCMP_ARCH_PARISC64,
 	.token_bpf = AUDIT_ARCH_PARISC64,
 	.size = ARCH_SIZE_64,
 	.endian = ARCH_ENDIAN_BIG,
-	.syscall_resolve_name = parisc_syscall_resolve_name,
-	.syscall_resolve_num = parisc_syscall_resolve_num,
+	.syscalls = &arch_syscall_col_parisc,
+	.syscall_resolve_name = NULL,
+	.syscall_resolve_num = NULL,
 	.syscall_rewrite = NULL,
 	.rule_add = NULL,
 };
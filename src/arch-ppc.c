@@ -24,14 +24,16 @@
 
 #include "arch.h"
 #include "arch-ppc.h"
+#include "arch-syscall-tbl.h"
 
 const struct arch_def arch_def_ppc = {
 	.token = SCMP_ARCH_PPC,
 	.token_bpf = AUDIT_ARCH_PPC,
 	.size = ARCH_SIZE_32,
 	.endian = ARCH_ENDIAN_BIG,
-	.syscall_resolve_name = ppc_syscall_resolve_name,
-	.syscall_resolve_num = ppc_syscall_resolve_num,
+	.syscalls = &arch_syscall_col_ppc,
+	.syscall_resolve_name = NULL,
+	.syscall_resolve_num = NULL,
 	.syscall_rewrite = NULL,
 	.rule_add = NULL,
 };
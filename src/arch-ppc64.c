@@ -24,14 +24,16 @@
 
 #include "arch.h"
 #include "arch-ppc64.h"
+#include "arch-syscall-tbl.h"
 
 const struct arch_def arch_def_ppc64 = {
 	.token = SCMP_ARCH_PPC64,
 	.token_bpf = AUDIT_ARCH_PPC64,
 	.size = ARCH_SIZE_64,
 	.endian = ARCH_ENDIAN_BIG,
-	.syscall_resolve_name = ppc64_syscall_resolve_name,
-	.syscall_resolve_num = ppc64_syscall_resolve_num,
+	.syscalls = &arch_syscall_col_ppc64,
+	.syscall_resolve_name = NULL,
+	.syscall_resolve_num = NULL,
 	.syscall_rewrite = NULL,
 	.rule_add = NULL,
 };
@@ -41,8 +43,9 @@ const struct arch_def arch_def_ppc64le = {
 	.token_bpf = AUDIT_ARCH_PPC64LE,
 	.size = ARCH_SIZE_64,
 	.endian = ARCH_ENDIAN_LITTLE,
-	.syscall_resolve_name = ppc64_syscall_resolve_name,
-	.syscall_resolve_num = ppc64_syscall_resolve_num,
+	.syscalls = &arch_syscall_col_ppc64,
+	.syscall_resolve_name = NULL,
+	.syscall_resolve_num = NULL,
 	.syscall_rewrite = NULL,
 	.rule_add = NULL,
 };
@@ -10,6 +10,7 @@
 
 #include "arch.h"
 #include "arch-s390.h"
+#include "arch-syscall-tbl.h"
 
 /* s390 syscall numbers */
 #define __s390_NR_socketcall		102
@@ -20,8 +21,9 @@ const struct arch_def arch_def_s390 = {
 	.token_bpf = AUDIT_ARCH_S390,
 	.size = ARCH_SIZE_32,
 	.endian = ARCH_ENDIAN_BIG,
-	.syscall_resolve_name = s390_syscall_resolve_name,
-	.syscall_resolve_num = s390_syscall_resolve_num,
+	.syscalls = &arch_syscall_col_s390,
+	.syscall_resolve_name = s390_syscall_resolve_name_munge,
+	.syscall_resolve_num = s390_syscall_resolve_num_munge,
 	.syscall_rewrite = s390_syscall_rewrite,
 	.rule_add = s390_rule_add,
 };
@@ -236,6 +238,106 @@ static int _s390_syscall_mux(int syscall)
 	return __NR_SCMP_ERROR;
 }
 
+/**
+ * Resolve a syscall name to a number
+ * @param name the syscall name
+ *
+ * Resolve the given syscall name to the syscall number using the syscall table,
+ * the multiplexed socket syscalls resolve to their pseudo syscall
+ * numbers.  Returns the syscall number on success, including negative pseudo
+ * syscall numbers; returns __NR_SCMP_ERROR on failure.
+ *
+ */
+int s390_syscall_resolve_name_munge(const char *name)
+{
+	int row;
+	int sys, sys_mux;
+
+	row = arch_syscall_row(name);
+	if (row < 0)
+		return __NR_SCMP_ERROR;
+	sys = arch_syscall_col_num(&arch_syscall_col_s390, row);
+	if (sys < 0)
+		return sys;
+
+	/* NOTE: only the socket syscalls, 357 through 373, are resolved to
+	 *       their pseudo syscall numbers, the ipc syscalls are not */
+	switch (sys) {
+	case 357:
+		return __PNR_recvmmsg;
+	case 358:
+		return __PNR_sendmmsg;
+	}
+	if (sys < 359 || sys > 373)
+		return sys;
+	sys_mux = _s390_syscall_mux(sys);
+	if (sys_mux == __NR_SCMP_ERROR)
+		return sys;
+	return sys_mux;
+}
+
+/**
+ * Resolve a syscall number to a name
+ * @param num the syscall number
+ *
+ * Resolve the given syscall number to the syscall name using the syscall table,
+ * the pseudo syscall numbers of the multiplexed socket syscalls resolve
+ * to their names.  Returns a pointer to the syscall name string on success,
+ * including pseudo syscall names; returns NULL on failure.
+ *
+ */
+const char *s390_syscall_resolve_num_munge(int num)
+{
+	int row;
+
+	if (num == __PNR_accept)
+		return "accept";
+	else if (num == __PNR_accept4)
+		return "accept4";
+	else if (num == __PNR_bind)
+		return "bind";
+	else if (num == __PNR_connect)
+		return "connect";
+	else if (num == __PNR_getpeername)
+		return "getpeername";
+	else if (num == __PNR_getsockname)
+		return "getsockname";
+	else if (num == __PNR_getsockopt)
+		return "getsockopt";
+	else if (num == __PNR_listen)
+		return "listen";
+	else if (num == __PNR_recv)
+		return "recv";
+	else if (num == __PNR_recvfrom)
+		return "recvfrom";
+	else if (num == __PNR_recvmsg)
+		return "recvmsg";
+	else if (num == __PNR_recvmmsg)
+		return "recvmmsg";
+	else if (num == __PNR_send)
+		return "send";
+	else if (num == __PNR_sendmsg)
+		return "sendmsg";
+	else if (num == __PNR_sendmmsg)
+		return "sendmmsg";
+	else if (num == __PNR_sendto)
+		return "sendto";
+	else if (num == __PNR_setsockopt)
+		return "setsockopt";
+	else if (num == __PNR_shutdown)
+		return "shutdown";
+	else if (num == __PNR_socket)
+		return "socket";
+	else if (num == __PNR_socketpair)
+		return "socketpair";
+
+	row = arch_syscall_col_row(&arch_syscall_col_s390, num);
+	if (row < 0)
+		return NULL;
+
+	return arch_syscall_row_name(row);
+}
+
 /**
  * Rewrite a syscall value to match the architecture
  * @param syscall the syscall number
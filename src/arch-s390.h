@@ -17,10 +17,8 @@
 extern const struct arch_def arch_def_s390;
 #define s390_arg_offset(x)		(offsetof(struct seccomp_data, args[x]))
 
-int s390_syscall_resolve_name(const char *name);
-const char *s390_syscall_resolve_num(int num);
-
-const struct arch_syscall_def *s390_syscall_iterate(unsigned int spot);
+int s390_syscall_resolve_name_munge(const char *name);
+const char *s390_syscall_resolve_num_munge(int num);
 
 int s390_syscall_rewrite(int *syscall);
 
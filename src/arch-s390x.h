@@ -20,10 +20,8 @@ extern const struct arch_def arch_def_s390x;
 #define s390x_arg_offset_lo(x)		(s390x_arg_offset(x) + 4)
 #define s390x_arg_offset_hi(x)		(s390x_arg_offset(x))
 
-int s390x_syscall_resolve_name(const char *name);
-const char *s390x_syscall_resolve_num(int num);
-
-const struct arch_syscall_def *s390x_syscall_iterate(unsigned int spot);
+int s390x_syscall_resolve_name_munge(const char *name);
+const char *s390x_syscall_resolve_num_munge(int num);
 
 int s390x_syscall_rewrite(int *syscall);
 
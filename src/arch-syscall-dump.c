@@ -30,19 +30,7 @@
 #include <seccomp.h>
 
 #include "arch.h"
-#include "arch-x86.h"
-#include "arch-x86_64.h"
-#include "arch-x32.h"
-#include "arch-arm.h"
-#include "arch-mips.h"
-#include "arch-mips64.h"
-#include "arch-mips64n32.h"
-#include "arch-aarch64.h"
-#include "arch-parisc.h"
-#include "arch-ppc.h"
-#include "arch-ppc64.h"
-#include "arch-s390.h"
-#include "arch-s390x.h"
+#include "arch-syscall-tbl.h"
 
 /**
  * Print the usage information to stderr and exit
@@ -65,8 +53,7 @@ int main(int argc, char *argv[])
 	int opt;
 	const struct arch_def *arch = arch_def_native;
 	int offset = 0;
-	int iter;
-	const struct arch_syscall_def *sys;
+	unsigned int row;
 
 	/* parse the command line */
 	while ((opt = getopt(argc, argv, "a:o:h")) > 0) {
@@ -86,70 +73,15 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	iter = 0;
-	do {
-		switch (arch->token) {
-		case SCMP_ARCH_X86:
-			sys = x86_syscall_iterate(iter);
-			break;
-		case SCMP_ARCH_X86_64:
-			sys = x86_64_syscall_iterate(iter);
-			break;
-		case SCMP_ARCH_X32:
-			sys = x32_syscall_iterate(iter);
-			break;
-		case SCMP_ARCH_ARM:
-			sys = arm_syscall_iterate(iter);
-			break;
-		case SCMP_ARCH_AARCH64:
-			sys = aarch64_syscall_iterate(iter);
-			break;
-		case SCMP_ARCH_MIPS:
-		case SCMP_ARCH_MIPSEL:
-			sys = mips_syscall_iterate(iter);
-			break;
-		case SCMP_ARCH_MIPS64:
-		case SCMP_ARCH_MIPSEL64:
-			sys = mips64_syscall_iterate(iter);
-			break;
-		case SCMP_ARCH_MIPS64N32:
-		case SCMP_ARCH_MIPSEL64N32:
-			sys = mips64n32_syscall_iterate(iter);
-			break;
-		case SCMP_ARCH_PARISC:
-		case SCMP_ARCH_PARISC64:
-			sys = parisc_syscall_iterate(iter);
-			break;
-		case SCMP_ARCH_PPC:
-			sys = ppc_syscall_iterate(iter);
-			break;
-		case SCMP_ARCH_PPC64:
-		case SCMP_ARCH_PPC64LE:
-			sys = ppc64_syscall_iterate(iter);
-			break;
-		case SCMP_ARCH_S390:
-			sys = s390_syscall_iterate(iter);
-			break;
-		case SCMP_ARCH_S390X:
-			sys = s390x_syscall_iterate(iter);
-			break;
-		default:
-			/* invalid arch */
-			exit_usage(argv[0]);
-		}
-		if (sys->name != NULL) {
-			int sys_num = sys->num;
-
-			if (offset > 0 && sys_num > 0)
-				sys_num -= offset;
+	for (row = 0; row < arch_syscall_names.row_cnt; row++) {
+		int sys_num = arch_syscall_col_num(arch->syscalls, row);
 
-			/* output the results */
-			printf("%s\t%d\n", sys->name, sys_num);
+		if (offset > 0 && sys_num > 0)
+			sys_num -= offset;
 
-			/* next */
-			iter++;
-		}
-	} while (sys->name != NULL);
+		/* output the results */
+		printf("%s\t%d\n", arch_syscall_row_name(row), sys_num);
+	}
 
 	return 0;
 }
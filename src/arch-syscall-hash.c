@@ -0,0 +1,76 @@
+/**
+ * Enhanced Seccomp Syscall Name Hash
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+/*
+ * NOTE: these functions are shared by the library and the build time table
+ * generator, arch-syscall-mktbl, which may run on a different machine than
+ * the library so the results must not depend on the byte order or the word
+ * size of the system.
+ */
+
+#include <inttypes.h>
+
+#include "arch-syscall-hash.h"
+
+/**
+ * Hash a syscall name
+ * @param name the syscall name
+ * @param seed the hash seed
+ *
+ * Return the 32-bit FNV-1a hash of @name, starting from an offset basis
+ * perturbed by @seed.
+ *
+ */
+uint32_t arch_syscall_hash_name(const char *name, uint32_t seed)
+{
+	uint32_t hval = 2166136261u ^ seed;
+	const unsigned char *iter;
+
+	for (iter = (const unsigned char *)name; *iter != '\0'; iter++) {
+		hval ^= *iter;
+		hval *= 16777619u;
+	}
+
+	return hval;
+}
+
+/**
+ * Compute the slot of a syscall name
+ * @param hval the hash of the syscall name
+ * @param disp the displacement of the name's bucket
+ * @param row_cnt the number of slots
+ *
+ * Mix the bucket displacement into the name hash and return the resulting
+ * slot, which is always less than @row_cnt.
+ *
+ */
+unsigned int arch_syscall_hash_slot(uint32_t hval, uint16_t disp,
+				    unsigned int row_cnt)
+{
+	hval ^= (uint32_t)disp * 0x9e3779b9u;
+	hval ^= hval >> 16;
+	hval *= 0x85ebca6bu;
+	hval ^= hval >> 13;
+	hval *= 0xc2b2ae35u;
+	hval ^= hval >> 16;
+
+	return hval % row_cnt;
+}
@@ -0,0 +1,45 @@
+/**
+ * Enhanced Seccomp Syscall Name Hash
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+#ifndef _ARCH_SYSCALL_HASH_H
+#define _ARCH_SYSCALL_HASH_H
+
+#include <inttypes.h>
+
+/* minimal perfect hash of the syscall names, see arch-syscall-mktbl.c */
+struct arch_syscall_hash {
+	uint32_t seed;
+	unsigned int bkt_cnt;
+	unsigned int row_cnt;
+	/* per-bucket displacements, indexed by the name hash */
+	const uint16_t *disp;
+	/* syscall table rows, indexed by the slot */
+	const uint16_t *row;
+};
+
+/* generated at build time from the syscall tables */
+extern const struct arch_syscall_hash arch_syscall_hash_tbl;
+
+uint32_t arch_syscall_hash_name(const char *name, uint32_t seed);
+unsigned int arch_syscall_hash_slot(uint32_t hval, uint16_t disp,
+				    unsigned int row_cnt);
+
+#endif
@@ -0,0 +1,639 @@
+/**
+ * Enhanced Seccomp Syscall Table Generator
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+/*
+ * NOTE: this program runs on the build machine, it reads the per-arch syscall
+ * tables from stdin and writes the combined syscall table to stdout.  Each
+ * table starts with an "@<arch>" line followed by one "<name> <number>" line
+ * per syscall, in table order.  The tables are run through the preprocessor
+ * of the target first, see Makefile.am, so the syscall numbers are simple
+ * integer expressions such as "(4000 + 3)" or "-10026".
+ *
+ * All of the per-arch tables must list the same syscall names in the same
+ * order, so the combined table has one row per syscall name and one column of
+ * syscall numbers per arch, see arch-syscall-tbl.h.  The names are stored
+ * once, in a string pool.
+ *
+ * A name is mapped to its row with a minimal perfect hash built using the
+ * "hash, displace and compress" scheme: the names are spread over buckets by
+ * their hash, then starting with the largest bucket a displacement is
+ * searched for each bucket which moves all of its names to free slots.
+ *
+ * A syscall number is mapped to its row with a per-arch dense array of rows
+ * covering the regular syscall numbers, plus a small sorted array of the
+ * syscalls which do not fit in the dense array, such as the pseudo syscalls.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch-syscall-hash.h"
+#include "arch-syscall-tbl.h"
+
+#define NAME_LEN_MAX		64
+#define LINE_LEN_MAX		256
+#define ROW_CNT_MAX		UINT16_MAX
+#define ARCH_CNT_MAX		32
+#define DENSE_CNT_MAX		2048
+#define SEED_CNT_MAX		256
+#define BKT_SIZE_MAX		16
+
+struct name {
+	char str[NAME_LEN_MAX];
+	uint32_t hval;
+};
+
+struct num_ent {
+	long long num;
+	unsigned int row;
+};
+
+struct arch {
+	char name[NAME_LEN_MAX];
+	long long *nums;
+	unsigned int row_cnt;
+};
+
+static struct name *names = NULL;
+static unsigned int name_cnt = 0;
+static unsigned int name_alloc = 0;
+
+static struct arch archs[ARCH_CNT_MAX];
+static unsigned int arch_cnt = 0;
+
+static unsigned int bkt_cnt;
+static unsigned int *bkt_order = NULL;
+static unsigned int *bkt_size = NULL;
+static uint16_t *disp = NULL;
+static uint16_t *row = NULL;
+static unsigned char *slot_used = NULL;
+
+static int num_eval(const char **str, long long *val);
+
+/**
+ * Evaluate a syscall number expression term
+ * @param str the term, updated to point past the evaluated term
+ * @param val the term value
+ *
+ * Evaluate the integer constant, negated term or parenthesized expression at
+ * @str.  Returns zero on success, negative values on failure.
+ *
+ */
+static int num_eval_term(const char **str, long long *val)
+{
+	int rc;
+	char *end;
+	const char *iter = *str;
+
+	while (*iter == ' ')
+		iter++;
+	if (*iter == '(') {
+		iter++;
+		rc = num_eval(&iter, val);
+		if (rc < 0)
+			return rc;
+		if (*iter != ')')
+			return -EINVAL;
+		iter++;
+	} else if (*iter == '-') {
+		iter++;
+		rc = num_eval_term(&iter, val);
+		if (rc < 0)
+			return rc;
+		*val = -*val;
+	} else {
+		errno = 0;
+		*val = strtoll(iter, &end, 0);
+		if (errno != 0 || end == iter)
+			return -EINVAL;
+		iter = end;
+	}
+	while (*iter == ' ')
+		iter++;
+
+	*str = iter;
+	return 0;
+}
+
+/**
+ * Evaluate a syscall number expression
+ * @param str the expression, updated to point past the evaluated expression
+ * @param val the expression value
+ *
+ * Evaluate the integer expression at @str, which may only contain integer
+ * constants, parentheses and the unary minus, addition and subtraction
+ * operators.  Returns zero on success, negative values on failure.
+ *
+ */
+static int num_eval(const char **str, long long *val)
+{
+	int rc;
+	long long term;
+	const char *iter = *str;
+	char op;
+
+	rc = num_eval_term(&iter, val);
+	if (rc < 0)
+		return rc;
+	while (*iter == '+' || *iter == '-') {
+		op = *iter++;
+		rc = num_eval_term(&iter, &term);
+		if (rc < 0)
+			return rc;
+		*val = (op == '+' ? *val + term : *val - term);
+		/* keep the numbers well within the range of an int */
+		if (*val > INT32_MAX || *val < -INT32_MAX)
+			return -ERANGE;
+	}
+
+	*str = iter;
+	return 0;
+}
+
+/**
+ * Add a syscall to the current syscall table
+ * @param name the syscall name
+ * @param num_str the syscall number expression
+ *
+ * Add the syscall to the last syscall table read from stdin, the first table
+ * defines the syscall names.  Returns zero on success, negative values on
+ * failure.
+ *
+ */
+static int syscall_add(const char *name, const char *num_str)
+{
+	int rc;
+	struct arch *arch = &archs[arch_cnt - 1];
+	struct name *n_tmp;
+	long long *num_tmp;
+	long long num;
+
+	if (strlen(name) >= NAME_LEN_MAX)
+		return -EINVAL;
+	rc = num_eval(&num_str, &num);
+	if (rc < 0)
+		return rc;
+	if (*num_str != '\0' || num > INT32_MAX || num < -INT32_MAX)
+		return -EINVAL;
+
+	if (arch_cnt == 1) {
+		if (name_cnt == ROW_CNT_MAX)
+			return -E2BIG;
+		if (name_cnt == name_alloc) {
+			name_alloc = (name_alloc ? name_alloc * 2 : 512);
+			n_tmp = realloc(names, name_alloc * sizeof(*names));
+			if (n_tmp == NULL)
+				return -ENOMEM;
+			names = n_tmp;
+			num_tmp = realloc(arch->nums,
+					  name_alloc * sizeof(*num_tmp));
+			if (num_tmp == NULL)
+				return -ENOMEM;
+			arch->nums = num_tmp;
+		}
+		strcpy(names[name_cnt++].str, name);
+	} else if (arch->row_cnt >= name_cnt ||
+		   strcmp(names[arch->row_cnt].str, name) != 0) {
+		/* the tables must list the same names in the same order */
+		fprintf(stderr, "%s: unexpected syscall %s, expected %s\n",
+			arch->name, name,
+			(arch->row_cnt < name_cnt ?
+			 names[arch->row_cnt].str : "nothing"));
+		return -EINVAL;
+	}
+
+	arch->nums[arch->row_cnt++] = num;
+	return 0;
+}
+
+/**
+ * Read the syscall tables from stdin
+ *
+ * Returns zero on success, negative values on failure.
+ *
+ */
+static int tables_read(void)
+{
+	int rc;
+	char buf[LINE_LEN_MAX];
+	char *num_str;
+	size_t len;
+
+	while (fgets(buf, sizeof(buf), stdin) != NULL) {
+		len = strcspn(buf, "\n");
+		if (buf[len] != '\n' || len == 0)
+			return -EINVAL;
+		buf[len] = '\0';
+
+		if (buf[0] == '@') {
+			if (arch_cnt > 0 && archs[arch_cnt - 1].row_cnt != name_cnt)
+				return -EINVAL;
+			if (arch_cnt == ARCH_CNT_MAX || len >= NAME_LEN_MAX)
+				return -EINVAL;
+			if (arch_cnt > 0) {
+				archs[arch_cnt].nums = calloc(name_cnt,
+						sizeof(*archs[arch_cnt].nums));
+				if (archs[arch_cnt].nums == NULL)
+					return -ENOMEM;
+			}
+			strcpy(archs[arch_cnt++].name, &buf[1]);
+			continue;
+		}
+
+		num_str = strchr(buf, ' ');
+		if (arch_cnt == 0 || num_str == NULL)
+			return -EINVAL;
+		*num_str++ = '\0';
+		rc = syscall_add(buf, num_str);
+		if (rc < 0)
+			return rc;
+	}
+	if (ferror(stdin) || name_cnt == 0 ||
+	    archs[arch_cnt - 1].row_cnt != name_cnt)
+		return -EINVAL;
+
+	return 0;
+}
+
+/**
+ * Compare two buckets by size, largest first
+ * @param a the first bucket
+ * @param b the second bucket
+ *
+ */
+static int bkt_cmp(const void *a, const void *b)
+{
+	unsigned int bkt_a = *(const unsigned int *)a;
+	unsigned int bkt_b = *(const unsigned int *)b;
+
+	if (bkt_size[bkt_a] != bkt_size[bkt_b])
+		return (bkt_size[bkt_a] > bkt_size[bkt_b] ? -1 : 1);
+	return (bkt_a < bkt_b ? -1 : (bkt_a > bkt_b));
+}
+
+/**
+ * Attempt to build the hash with the given seed
+ * @param seed the name hash seed
+ *
+ * Returns zero on success, negative values if there is no perfect hash for
+ * the given seed.
+ *
+ */
+static int hash_build(uint32_t seed)
+{
+	unsigned int iter, b_iter, n_iter, bkt;
+	unsigned int members[BKT_SIZE_MAX];
+	unsigned int slots[BKT_SIZE_MAX];
+	unsigned int m_cnt;
+	unsigned int d;
+
+	memset(bkt_size, 0, bkt_cnt * sizeof(*bkt_size));
+	memset(disp, 0, bkt_cnt * sizeof(*disp));
+	memset(slot_used, 0, name_cnt);
+	for (iter = 0; iter < name_cnt; iter++) {
+		names[iter].hval = arch_syscall_hash_name(names[iter].str,
+							  seed);
+		bkt_size[names[iter].hval % bkt_cnt]++;
+	}
+	for (iter = 0; iter < bkt_cnt; iter++) {
+		/* keep the search bounded, a seed this bad is never used */
+		if (bkt_size[iter] > BKT_SIZE_MAX)
+			return -EAGAIN;
+		bkt_order[iter] = iter;
+	}
+	qsort(bkt_order, bkt_cnt, sizeof(*bkt_order), bkt_cmp);
+
+	for (b_iter = 0; b_iter < bkt_cnt; b_iter++) {
+		bkt = bkt_order[b_iter];
+		if (bkt_size[bkt] == 0)
+			break;
+
+		m_cnt = 0;
+		for (iter = 0; iter < name_cnt; iter++)
+			if (names[iter].hval % bkt_cnt == bkt)
+				members[m_cnt++] = iter;
+
+		for (d = 0; d <= UINT16_MAX; d++) {
+			for (n_iter = 0; n_iter < m_cnt; n_iter++) {
+				slots[n_iter] = arch_syscall_hash_slot(
+						names[members[n_iter]].hval,
+						d, name_cnt);
+				if (slot_used[slots[n_iter]])
+					break;
+				for (iter = 0; iter < n_iter; iter++)
+					if (slots[iter] == slots[n_iter])
+						break;
+				if (iter < n_iter)
+					break;
+			}
+			if (n_iter == m_cnt)
+				break;
+		}
+		if (d > UINT16_MAX)
+			return -EAGAIN;
+
+		disp[bkt] = d;
+		for (n_iter = 0; n_iter < m_cnt; n_iter++) {
+			slot_used[slots[n_iter]] = 1;
+			row[slots[n_iter]] = members[n_iter];
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Verify the hash and write it to stdout
+ * @param seed the name hash seed
+ *
+ * Returns zero on success, negative values on failure.
+ *
+ */
+static int hash_write(uint32_t seed)
+{
+	unsigned int iter;
+	uint32_t hval;
+
+	/* double check the hash using the same lookup as the library */
+	for (iter = 0; iter < name_cnt; iter++) {
+		hval = arch_syscall_hash_name(names[iter].str, seed);
+		if (row[arch_syscall_hash_slot(hval, disp[hval % bkt_cnt],
+					       name_cnt)] != iter)
+			return -EFAULT;
+	}
+
+	printf("static const uint16_t _disp[%u] = {", bkt_cnt);
+	for (iter = 0; iter < bkt_cnt; iter++)
+		printf("%s%u,", (iter % 12 ? " " : "\n\t"), disp[iter]);
+	printf("\n};\n\n");
+
+	printf("static const uint16_t _row[%u] = {", name_cnt);
+	for (iter = 0; iter < name_cnt; iter++)
+		printf("%s%u,", (iter % 12 ? " " : "\n\t"), row[iter]);
+	printf("\n};\n\n");
+
+	printf("const struct arch_syscall_hash arch_syscall_hash_tbl = {\n");
+	printf("\t.seed = %" PRIu32 "u,\n", seed);
+	printf("\t.bkt_cnt = %u,\n", bkt_cnt);
+	printf("\t.row_cnt = %u,\n", name_cnt);
+	printf("\t.disp = _disp,\n");
+	printf("\t.row = _row,\n");
+	printf("};\n");
+
+	return 0;
+}
+
+/**
+ * Compare two syscall number index entries by number, then by row
+ * @param a the first entry
+ * @param b the second entry
+ *
+ */
+static int num_ent_cmp(const void *a, const void *b)
+{
+	const struct num_ent *ent_a = a;
+	const struct num_ent *ent_b = b;
+
+	if (ent_a->num != ent_b->num)
+		return (ent_a->num < ent_b->num ? -1 : 1);
+	return (ent_a->row < ent_b->row ? -1 : (ent_a->row > ent_b->row));
+}
+
+/**
+ * Write the syscall names to stdout
+ *
+ * Returns zero on success, negative values on failure.
+ *
+ */
+static int names_write(void)
+{
+	unsigned int iter;
+	unsigned long offset = 0;
+
+	printf("\nstatic const char _pool[] =");
+	for (iter = 0; iter < name_cnt; iter++)
+		printf("\n\t\"%s\\0\"", names[iter].str);
+	printf(";\n");
+
+	printf("\nstatic const uint16_t _offset[%u] = {", name_cnt);
+	for (iter = 0; iter < name_cnt; iter++) {
+		if (offset > UINT16_MAX)
+			return -E2BIG;
+		printf("%s%lu,", (iter % 12 ? " " : "\n\t"), offset);
+		offset += strlen(names[iter].str) + 1;
+	}
+	printf("\n};\n");
+
+	printf("\nconst struct arch_syscall_names arch_syscall_names = {\n");
+	printf("\t.row_cnt = %u,\n", name_cnt);
+	printf("\t.offset = _offset,\n");
+	printf("\t.pool = _pool,\n");
+	printf("};\n");
+
+	return 0;
+}
+
+/**
+ * Write the syscall number column of an arch to stdout
+ * @param arch the arch
+ *
+ * Write the arch's syscall numbers by row, and the index to lookup the rows
+ * by syscall number.  Returns zero on success, negative values on failure.
+ *
+ */
+static int col_write(const struct arch *arch)
+{
+	struct num_ent *ents;
+	uint16_t *dense = NULL;
+	unsigned int iter, cnt;
+	unsigned int first, last, dense_cnt, ext_cnt;
+	long long base, num;
+
+	ents = calloc(arch->row_cnt, sizeof(*ents));
+	if (ents == NULL)
+		return -ENOMEM;
+
+	/* syscalls can share a number, the first row wins as it would in a
+	 * linear search of the syscall table */
+	for (iter = 0; iter < arch->row_cnt; iter++) {
+		ents[iter].num = arch->nums[iter];
+		ents[iter].row = iter;
+	}
+	qsort(ents, arch->row_cnt, sizeof(*ents), num_ent_cmp);
+	for (cnt = 0, iter = 0; iter < arch->row_cnt; iter++)
+		if (cnt == 0 || ents[cnt - 1].num != ents[iter].num)
+			ents[cnt++] = ents[iter];
+
+	/* the dense array starts at the lowest regular syscall number, the
+	 * pseudo syscalls and any outliers are left to the sparse array */
+	for (first = 0; first < cnt && ents[first].num < 0; first++);
+	base = (first < cnt ? ents[first].num : 0);
+	dense_cnt = 0;
+	for (last = first;
+	     last < cnt && ents[last].num - base < DENSE_CNT_MAX; last++)
+		dense_cnt = ents[last].num - base + 1;
+
+	/* pseudo syscall numbers are stored as is, regular syscall numbers
+	 * relative to the lowest one, anything else goes in the ext array */
+	ext_cnt = 0;
+	printf("\nstatic const int16_t _%s_nums[%u] = {",
+	       arch->name, arch->row_cnt);
+	for (iter = 0; iter < arch->row_cnt; iter++) {
+		num = arch->nums[iter];
+		if (num >= 0)
+			num -= base;
+		if (num <= ARCH_SYSCALL_NUM_EXT || num > INT16_MAX) {
+			num = ARCH_SYSCALL_NUM_EXT;
+			ext_cnt++;
+		}
+		printf("%s%lld,", (iter % 12 ? " " : "\n\t"), num);
+	}
+	printf("\n};\n");
+
+	if (ext_cnt > 0) {
+		printf("\nstatic const struct arch_syscall_num_ent "
+		       "_%s_ext[%u] = {\n", arch->name, ext_cnt);
+		for (iter = 0; iter < arch->row_cnt; iter++) {
+			num = arch->nums[iter];
+			if (num >= 0)
+				num -= base;
+			if (num <= ARCH_SYSCALL_NUM_EXT || num > INT16_MAX)
+				printf("\t{ %lld, %u },\n",
+				       arch->nums[iter], iter);
+		}
+		printf("};\n");
+	}
+
+	if (dense_cnt > 0) {
+		dense = calloc(dense_cnt, sizeof(*dense));
+		if (dense == NULL) {
+			free(ents);
+			return -ENOMEM;
+		}
+		for (iter = first; iter < last; iter++)
+			dense[ents[iter].num - base] = ents[iter].row + 1;
+
+		printf("\nstatic const uint16_t _%s_dense[%u] = {",
+		       arch->name, dense_cnt);
+		for (iter = 0; iter < dense_cnt; iter++)
+			printf("%s%u,", (iter % 12 ? " " : "\n\t"), dense[iter]);
+		printf("\n};\n");
+	}
+
+	if (cnt - (last - first) > 0) {
+		printf("\nstatic const struct arch_syscall_num_ent "
+		       "_%s_sparse[%u] = {\n", arch->name, cnt - (last - first));
+		for (iter = 0; iter < cnt; iter++) {
+			if (iter == first)
+				iter = last;
+			if (iter == cnt)
+				break;
+			printf("\t{ %lld, %u },\n", ents[iter].num, ents[iter].row);
+		}
+		printf("};\n");
+	}
+
+	printf("\nconst struct arch_syscall_col arch_syscall_col_%s = {\n",
+	       arch->name);
+	printf("\t.base = %lldu,\n", base);
+	printf("\t.nums = _%s_nums,\n", arch->name);
+	printf("\t.ext_cnt = %u,\n", ext_cnt);
+	if (ext_cnt > 0)
+		printf("\t.ext = _%s_ext,\n", arch->name);
+	printf("\t.dense_cnt = %u,\n", dense_cnt);
+	if (dense_cnt > 0)
+		printf("\t.dense = _%s_dense,\n", arch->name);
+	printf("\t.sparse_cnt = %u,\n", cnt - (last - first));
+	if (cnt - (last - first) > 0)
+		printf("\t.sparse = _%s_sparse,\n", arch->name);
+	printf("};\n");
+
+	free(dense);
+	free(ents);
+	return 0;
+}
+
+/**
+ * main
+ */
+int main(int argc, char *argv[])
+{
+	int rc;
+	unsigned int iter;
+	uint32_t seed;
+
+	rc = tables_read();
+	if (rc < 0) {
+		fprintf(stderr, "%s: invalid syscall tables\n", argv[0]);
+		goto out;
+	}
+
+	/* an average of two names per bucket keeps the search short */
+	bkt_cnt = (name_cnt + 1) / 2;
+	bkt_order = calloc(bkt_cnt, sizeof(*bkt_order));
+	bkt_size = calloc(bkt_cnt, sizeof(*bkt_size));
+	disp = calloc(bkt_cnt, sizeof(*disp));
+	row = calloc(name_cnt, sizeof(*row));
+	slot_used = calloc(name_cnt, sizeof(*slot_used));
+	if (bkt_order == NULL || bkt_size == NULL || disp == NULL ||
+	    row == NULL || slot_used == NULL) {
+		rc = -ENOMEM;
+		fprintf(stderr, "%s: out of memory\n", argv[0]);
+		goto out;
+	}
+
+	rc = -EAGAIN;
+	for (seed = 0; seed < SEED_CNT_MAX && rc < 0; seed++)
+		rc = hash_build(seed);
+	if (rc < 0) {
+		fprintf(stderr, "%s: unable to build the syscall hash\n",
+			argv[0]);
+		goto out;
+	}
+
+	printf("/* generated by arch-syscall-mktbl, do not edit */\n\n");
+	printf("#include \"arch-syscall-hash.h\"\n");
+	printf("#include \"arch-syscall-tbl.h\"\n\n");
+	rc = hash_write(seed - 1);
+	if (rc == 0)
+		rc = names_write();
+	for (iter = 0; iter < arch_cnt && rc == 0; iter++)
+		rc = col_write(&archs[iter]);
+	if (rc == 0 && (fflush(stdout) != 0 || ferror(stdout)))
+		rc = -EIO;
+	if (rc < 0)
+		fprintf(stderr, "%s: unable to write the syscall tables\n",
+			argv[0]);
+
+out:
+	for (iter = 0; iter < arch_cnt; iter++)
+		free(archs[iter].nums);
+	free(names);
+	free(bkt_order);
+	free(bkt_size);
+	free(disp);
+	free(row);
+	free(slot_used);
+	return (rc < 0 ? 1 : 0);
+}
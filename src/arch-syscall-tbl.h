@@ -0,0 +1,85 @@
+/**
+ * Enhanced Seccomp Syscall Table
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+#ifndef _ARCH_SYSCALL_TBL_H
+#define _ARCH_SYSCALL_TBL_H
+
+#include <inttypes.h>
+
+/*
+ * The syscall table has one row per syscall name, shared by every arch, and
+ * one column of syscall numbers per arch.  It is generated at build time from
+ * the arch-*-syscalls.c files, see arch-syscall-mktbl.c.
+ */
+
+/* column value of the syscalls whose numbers are in the column's ext array */
+#define ARCH_SYSCALL_NUM_EXT	INT16_MIN
+
+struct arch_syscall_num_ent {
+	int num;
+	uint16_t row;
+};
+
+/* syscall names, by row */
+struct arch_syscall_names {
+	unsigned int row_cnt;
+	/* offsets of the names in the string pool */
+	const uint16_t *offset;
+	const char *pool;
+};
+
+/* syscall numbers of an arch */
+struct arch_syscall_col {
+	/* the syscall numbers by row: negative values are pseudo syscall
+	 * numbers, other values are relative to base */
+	unsigned int base;
+	const int16_t *nums;
+	/* the syscall numbers which do not fit in a column value, sorted by
+	 * row */
+	unsigned int ext_cnt;
+	const struct arch_syscall_num_ent *ext;
+
+	/* rows plus one, zero if unused, of the syscalls numbered from base to
+	 * base + dense_cnt - 1 */
+	unsigned int dense_cnt;
+	const uint16_t *dense;
+	/* rows of the remaining syscalls, sorted by number */
+	unsigned int sparse_cnt;
+	const struct arch_syscall_num_ent *sparse;
+};
+
+extern const struct arch_syscall_names arch_syscall_names;
+
+extern const struct arch_syscall_col arch_syscall_col_x86;
+extern const struct arch_syscall_col arch_syscall_col_x86_64;
+extern const struct arch_syscall_col arch_syscall_col_x32;
+extern const struct arch_syscall_col arch_syscall_col_arm;
+extern const struct arch_syscall_col arch_syscall_col_aarch64;
+extern const struct arch_syscall_col arch_syscall_col_mips;
+extern const struct arch_syscall_col arch_syscall_col_mips64;
+extern const struct arch_syscall_col arch_syscall_col_mips64n32;
+extern const struct arch_syscall_col arch_syscall_col_parisc;
+extern const struct arch_syscall_col arch_syscall_col_ppc;
+extern const struct arch_syscall_col arch_syscall_col_ppc64;
+extern const struct arch_syscall_col arch_syscall_col_s390;
+extern const struct arch_syscall_col arch_syscall_col_s390x;
+
+#endif
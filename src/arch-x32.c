@@ -25,6 +25,7 @@
 
 #include "arch.h"
 #include "arch-x32.h"
+#include "arch-syscall-tbl.h"
 
 const struct arch_def arch_def_x32 = {
 	.token = SCMP_ARCH_X32,
@@ -32,8 +33,9 @@ const struct arch_def arch_def_x32 = {
 	.token_bpf = AUDIT_ARCH_X86_64,
 	.size = ARCH_SIZE_32,
 	.endian = ARCH_ENDIAN_LITTLE,
-	.syscall_resolve_name = x32_syscall_resolve_name,
-	.syscall_resolve_num = x32_syscall_resolve_num,
+	.syscalls = &arch_syscall_col_x32,
+	.syscall_resolve_name = NULL,
+	.syscall_resolve_num = NULL,
 	.syscall_rewrite = NULL,
 	.rule_add = NULL,
 };
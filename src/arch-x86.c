@@ -26,6 +26,7 @@
 
 #include "arch.h"
 #include "arch-x86.h"
+#include "arch-syscall-tbl.h"
 
 /* x86 syscall numbers */
 #define __x86_NR_socketcall		102
@@ -36,8 +37,9 @@ const struct arch_def arch_def_x86 = {
 	.token_bpf = AUDIT_ARCH_I386,
 	.size = ARCH_SIZE_32,
 	.endian = ARCH_ENDIAN_LITTLE,
-	.syscall_resolve_name = x86_syscall_resolve_name,
-	.syscall_resolve_num = x86_syscall_resolve_num,
+	.syscalls = &arch_syscall_col_x86,
+	.syscall_resolve_name = x86_syscall_resolve_name_munge,
+	.syscall_resolve_num = x86_syscall_resolve_num_munge,
 	.syscall_rewrite = x86_syscall_rewrite,
 	.rule_add = x86_rule_add,
 };
@@ -251,6 +253,121 @@ static int _x86_syscall_mux(int syscall)
 	return __NR_SCMP_ERROR;
 }
 
+/**
+ * Resolve a syscall name to a number
+ * @param name the syscall name
+ *
+ * Resolve the given syscall name to the syscall number using the syscall table,
+ * the multiplexed socket and ipc syscalls resolve to their pseudo syscall
+ * numbers.  Returns the syscall number on success, including negative pseudo
+ * syscall numbers; returns __NR_SCMP_ERROR on failure.
+ *
+ */
+int x86_syscall_resolve_name_munge(const char *name)
+{
+	int row;
+	int sys, sys_mux;
+
+	row = arch_syscall_row(name);
+	if (row < 0)
+		return __NR_SCMP_ERROR;
+	sys = arch_syscall_col_num(&arch_syscall_col_x86, row);
+	if (sys < 0)
+		return sys;
+
+	sys_mux = _x86_syscall_mux(sys);
+	if (sys_mux == __NR_SCMP_ERROR)
+		return sys;
+	return sys_mux;
+}
+
+/**
+ * Resolve a syscall number to a name
+ * @param num the syscall number
+ *
+ * Resolve the given syscall number to the syscall name using the syscall table,
+ * the pseudo syscall numbers of the multiplexed socket and ipc syscalls resolve
+ * to their names.  Returns a pointer to the syscall name string on success,
+ * including pseudo syscall names; returns NULL on failure.
+ *
+ */
+const char *x86_syscall_resolve_num_munge(int num)
+{
+	int row;
+
+	if (num == __PNR_accept)
+		return "accept";
+	else if (num == __PNR_accept4)
+		return "accept4";
+	else if (num == __PNR_bind)
+		return "bind";
+	else if (num == __PNR_connect)
+		return "connect";
+	else if (num == __PNR_getpeername)
+		return "getpeername";
+	else if (num == __PNR_getsockname)
+		return "getsockname";
+	else if (num == __PNR_getsockopt)
+		return "getsockopt";
+	else if (num == __PNR_listen)
+		return "listen";
+	else if (num == __PNR_recv)
+		return "recv";
+	else if (num == __PNR_recvfrom)
+		return "recvfrom";
+	else if (num == __PNR_recvmsg)
+		return "recvmsg";
+	else if (num == __PNR_recvmmsg)
+		return "recvmmsg";
+	else if (num == __PNR_send)
+		return "send";
+	else if (num == __PNR_sendmsg)
+		return "sendmsg";
+	else if (num == __PNR_sendmmsg)
+		return "sendmmsg";
+	else if (num == __PNR_sendto)
+		return "sendto";
+	else if (num == __PNR_setsockopt)
+		return "setsockopt";
+	else if (num == __PNR_shutdown)
+		return "shutdown";
+	else if (num == __PNR_socket)
+		return "socket";
+	else if (num == __PNR_socketpair)
+		return "socketpair";
+
+	if (num == __PNR_semop)
+		return "semop";
+	else if (num == __PNR_semget)
+		return "semget";
+	else if (num == __PNR_semctl)
+		return "semctl";
+	else if (num == __PNR_semtimedop)
+		return "semtimedop";
+	else if (num == __PNR_msgsnd)
+		return "msgsnd";
+	else if (num == __PNR_msgrcv)
+		return "msgrcv";
+	else if (num == __PNR_msgget)
+		return "msgget";
+	else if (num == __PNR_msgctl)
+		return "msgctl";
+	else if (num == __PNR_shmat)
+		return "shmat";
+	else if (num == __PNR_shmdt)
+		return "shmdt";
+	else if (num == __PNR_shmget)
+		return "shmget";
+	else if (num == __PNR_shmctl)
+		return "shmctl";
+
+	row = arch_syscall_col_row(&arch_syscall_col_x86, num);
+	if (row < 0)
+		return NULL;
+
+	return arch_syscall_row_name(row);
+}
+
 /**
  * Rewrite a syscall value to match the architecture
  * @param syscall the syscall number
@@ -43,6 +43,8 @@
 #include "arch-ppc64.h"
 #include "arch-s390.h"
 #include "arch-s390x.h"
+#include "arch-syscall-hash.h"
+#include "arch-syscall-tbl.h"
 #include "db.h"
 #include "system.h"
 
@@ -279,6 +281,115 @@ int arch_arg_offset(const struct arch_def *arch, unsigned int arg)
 	return arch_arg_offset_lo(arch, arg);
 }
 
+/**
+ * Lookup a syscall table row by name
+ * @param name the syscall name
+ *
+ * Lookup the given syscall name in the syscall table using the generated
+ * syscall name hash, which costs a single hash and string compare.  Returns
+ * the syscall table row on success, negative values on failure.
+ *
+ */
+int arch_syscall_row(const char *name)
+{
+	const struct arch_syscall_hash *hash = &arch_syscall_hash_tbl;
+	uint32_t hval;
+	unsigned int slot, row;
+
+	hval = arch_syscall_hash_name(name, hash->seed);
+	slot = arch_syscall_hash_slot(hval, hash->disp[hval % hash->bkt_cnt],
+				      hash->row_cnt);
+	row = hash->row[slot];
+	if (strcmp(name, arch_syscall_row_name(row)) != 0)
+		return -1;
+
+	return row;
+}
+
+/**
+ * Return the syscall name of a syscall table row
+ * @param row the syscall table row
+ *
+ * Returns a pointer to the syscall name of the given syscall table row, the
+ * name is static and must not be freed.
+ *
+ */
+const char *arch_syscall_row_name(unsigned int row)
+{
+	return &arch_syscall_names.pool[arch_syscall_names.offset[row]];
+}
+
+/**
+ * Return the syscall number of a syscall table row
+ * @param col the syscall table column of the architecture
+ * @param row the syscall table row
+ *
+ * Returns the syscall number of the given syscall table row in the given
+ * column, which may be a negative pseudo syscall number.
+ *
+ */
+int arch_syscall_col_num(const struct arch_syscall_col *col, unsigned int row)
+{
+	int val = col->nums[row];
+	unsigned int lo, hi, mid;
+
+	if (val >= 0)
+		return col->base + val;
+	else if (val != ARCH_SYSCALL_NUM_EXT)
+		return val;
+
+	/* the few syscall numbers which do not fit in the column */
+	lo = 0;
+	hi = col->ext_cnt;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (col->ext[mid].row == row)
+			return col->ext[mid].num;
+		else if (col->ext[mid].row < row)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* not reached with a valid syscall table */
+	return __NR_SCMP_ERROR;
+}
+
+/**
+ * Lookup a syscall table row by number
+ * @param col the syscall table column of the architecture
+ * @param num the syscall number
+ *
+ * Lookup the given syscall number in the given syscall table column.  Regular
+ * syscall numbers are found with a single array access, pseudo syscall numbers
+ * with a binary search of the few remaining syscalls.  If multiple syscalls
+ * share a number the first row is returned.  Returns the syscall table row on
+ * success, negative values on failure.
+ *
+ */
+int arch_syscall_col_row(const struct arch_syscall_col *col, int num)
+{
+	unsigned int offset = (unsigned int)num - col->base;
+	unsigned int lo, hi, mid;
+
+	if (offset < col->dense_cnt)
+		return (int)col->dense[offset] - 1;
+
+	lo = 0;
+	hi = col->sparse_cnt;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (col->sparse[mid].num == num)
+			return col->sparse[mid].row;
+		else if (col->sparse[mid].num < num)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return -1;
+}
+
 /**
  * Resolve a syscall name to a number
  * @param arch the architecture definition
@@ -291,10 +402,41 @@ int arch_arg_offset(const struct arch_def *arch, unsigned int arg)
  */
 int arch_syscall_resolve_name(const struct arch_def *arch, const char *name)
 {
+	int row;
+
 	if (arch->syscall_resolve_name)
 		return (*arch->syscall_resolve_name)(name);
 
-	return __NR_SCMP_ERROR;
+	row = arch_syscall_row(name);
+	if (row < 0)
+		return __NR_SCMP_ERROR;
+
+	return arch_syscall_col_num(arch->syscalls, row);
+}
+
+/**
+ * Resolve a syscall name to a number using its syscall table row
+ * @param arch the architecture definition
+ * @param name the syscall name
+ * @param row the syscall table row of @name, from arch_syscall_row()
+ *
+ * Resolve the given syscall name to the syscall number based on the given
+ * architecture, the same as arch_syscall_resolve_name(), but reusing the
+ * syscall table row which is shared by every architecture.  Returns the
+ * syscall number on success, including negative pseudo syscall numbers;
+ * returns __NR_SCMP_ERROR on failure.
+ *
+ */
+int arch_syscall_resolve_name_row(const struct arch_def *arch,
+				  const char *name, int row)
+{
+	if (arch->syscall_resolve_name)
+		return (*arch->syscall_resolve_name)(name);
+
+	if (row < 0)
+		return __NR_SCMP_ERROR;
+
+	return arch_syscall_col_num(arch->syscalls, row);
 }
 
 /**
@@ -309,10 +451,16 @@ int arch_syscall_resolve_name(const struct arch_def *arch, const char *name)
  */
 const char *arch_syscall_resolve_num(const struct arch_def *arch, int num)
 {
+	int row;
+
 	if (arch->syscall_resolve_num)
 		return (*arch->syscall_resolve_num)(num);
 
-	return NULL;
+	row = arch_syscall_col_row(arch->syscalls, num);
+	if (row < 0)
+		return NULL;
+
+	return arch_syscall_row_name(row);
 }
 
 /**
@@ -327,6 +475,7 @@ const char *arch_syscall_resolve_num(const struct arch_def *arch, int num)
  */
 int arch_syscall_translate(const struct arch_def *arch, int *syscall)
 {
+	int row;
 	int sc_num;
 	const char *sc_name;
 
@@ -335,6 +484,18 @@ int arch_syscall_translate(const struct arch_def *arch, int *syscall)
 		return 0;
 
 	if (arch->token != arch_def_native->token) {
+		/* without any arch specific munging the syscall table row is
+		 * enough to go from one column to the other */
+		if (arch_def_native->syscall_resolve_num == NULL &&
+		    arch->syscall_resolve_name == NULL) {
+			row = arch_syscall_col_row(arch_def_native->syscalls,
+						   *syscall);
+			if (row < 0)
+				return -EFAULT;
+			*syscall = arch_syscall_col_num(arch->syscalls, row);
+			return 0;
+		}
+
 		sc_name = arch_syscall_resolve_num(arch_def_native, *syscall);
 		if (sc_name == NULL)
 			return -EFAULT;
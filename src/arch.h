@@ -33,6 +33,7 @@
 struct db_filter;
 struct db_api_arg;
 struct db_api_rule_list;
+struct arch_syscall_col;
 
 struct arch_def {
 	/* arch definition */
@@ -49,6 +50,9 @@ struct arch_def {
 		ARCH_ENDIAN_BIG,
 	} endian;
 
+	/* syscall numbers, by syscall table row */
+	const struct arch_syscall_col *syscalls;
+
 	/* arch specific functions */
 	int (*syscall_resolve_name)(const char *name);
 	const char *(*syscall_resolve_num)(int num);
@@ -80,7 +84,14 @@ int arch_arg_offset_lo(const struct arch_def *arch, unsigned int arg);
 int arch_arg_offset_hi(const struct arch_def *arch, unsigned int arg);
 int arch_arg_offset(const struct arch_def *arch, unsigned int arg);
 
+int arch_syscall_row(const char *name);
+const char *arch_syscall_row_name(unsigned int row);
+int arch_syscall_col_num(const struct arch_syscall_col *col, unsigned int row);
+int arch_syscall_col_row(const struct arch_syscall_col *col, int num);
+
 int arch_syscall_resolve_name(const struct arch_def *arch, const char *name);
+int arch_syscall_resolve_name_row(const struct arch_def *arch,
+				  const char *name, int row);
 const char *arch_syscall_resolve_num(const struct arch_def *arch, int num);
 
 int arch_syscall_translate(const struct arch_def *arch, int *syscall);
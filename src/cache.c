@@ -0,0 +1,636 @@
+/**
+ * Seccomp BPF Filter Cache
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+/*
+ * The cache maps the canonical key of a filter collection, see db_col_key(),
+ * to the BPF program generated from it.  The programs are kept in memory in a
+ * process wide least recently used list and, optionally, in a directory where
+ * they can be shared between processes.  The key identifies everything that
+ * goes into the BPF program, so a change to a filter collection results in a
+ * different key and the stale program is simply never found again.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "db.h"
+#include "gen_bpf.h"
+#include "hash.h"
+#include "helper.h"
+
+/* magic value at the start of the cache files */
+#define _CACHE_MAGIC			"SCMPBPF1"
+
+struct cache_entry {
+	/* canonical key of the filter collection */
+	uint32_t hash;
+	uint8_t *key;
+	size_t key_len;
+
+	/* the generated program and its statistics */
+	struct bpf_program prgm;
+	uint64_t peephole;
+	uint64_t trampolines;
+
+	struct cache_entry *prev, *next;
+};
+
+/* cache file header, followed by the key and then the program */
+struct cache_file_hdr {
+	char magic[8];
+	uint32_t key_len;
+	uint32_t blk_cnt;
+	uint64_t peephole;
+	uint64_t trampolines;
+};
+
+static pthread_mutex_t _cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* cached programs, most recently used first */
+static struct cache_entry *_cache_head = NULL;
+static struct cache_entry *_cache_tail = NULL;
+static unsigned int _cache_cnt = 0;
+
+/* configuration */
+static unsigned int _cache_size = 0;
+static char *_cache_path = NULL;
+
+/**
+ * Free a cache entry
+ * @param entry the cache entry
+ *
+ * This function frees the cache entry, which must not be in the cache list.
+ *
+ */
+static void _entry_free(struct cache_entry *entry)
+{
+	if (entry == NULL)
+		return;
+
+	if (entry->key != NULL)
+		free(entry->key);
+	if (entry->prgm.blks != NULL)
+		free(entry->prgm.blks);
+	free(entry);
+}
+
+/**
+ * Create a new cache entry
+ * @param hash the hash of the key
+ * @param key the canonical key
+ * @param key_len the length of the key
+ * @param blks the BPF instructions
+ * @param blk_cnt the number of BPF instructions
+ *
+ * This function creates a new cache entry with copies of the key and the BPF
+ * instructions.  Returns a pointer to the entry on success, NULL on failure.
+ *
+ */
+static struct cache_entry *_entry_new(uint32_t hash,
+				      const uint8_t *key, size_t key_len,
+				      const bpf_instr_raw *blks,
+				      unsigned int blk_cnt)
+{
+	struct cache_entry *entry;
+
+	entry = zmalloc(sizeof(*entry));
+	if (entry == NULL)
+		return NULL;
+	entry->hash = hash;
+	entry->key_len = key_len;
+	entry->key = malloc(key_len);
+	entry->prgm.blk_cnt = blk_cnt;
+	entry->prgm.blks = malloc(BPF_PGM_SIZE(&entry->prgm));
+	if (entry->key == NULL || entry->prgm.blks == NULL) {
+		_entry_free(entry);
+		return NULL;
+	}
+	memcpy(entry->key, key, key_len);
+	memcpy(entry->prgm.blks, blks, BPF_PGM_SIZE(&entry->prgm));
+
+	return entry;
+}
+
+/**
+ * Remove an entry from the cache list
+ * @param entry the cache entry
+ *
+ * The caller must hold the cache lock.
+ *
+ */
+static void _list_del(struct cache_entry *entry)
+{
+	if (entry->prev != NULL)
+		entry->prev->next = entry->next;
+	else
+		_cache_head = entry->next;
+	if (entry->next != NULL)
+		entry->next->prev = entry->prev;
+	else
+		_cache_tail = entry->prev;
+	entry->prev = NULL;
+	entry->next = NULL;
+	_cache_cnt--;
+}
+
+/**
+ * Add an entry to the front of the cache list
+ * @param entry the cache entry
+ *
+ * The caller must hold the cache lock.
+ *
+ */
+static void _list_add(struct cache_entry *entry)
+{
+	entry->prev = NULL;
+	entry->next = _cache_head;
+	if (_cache_head != NULL)
+		_cache_head->prev = entry;
+	else
+		_cache_tail = entry;
+	_cache_head = entry;
+	_cache_cnt++;
+}
+
+/**
+ * Find an entry in the cache list
+ * @param hash the hash of the key
+ * @param key the canonical key
+ * @param key_len the length of the key
+ *
+ * Search the cache list for the given key, moving a matching entry to the
+ * front of the list.  The caller must hold the cache lock.  Returns a pointer
+ * to the entry if found, NULL otherwise.
+ *
+ */
+static struct cache_entry *_list_find(uint32_t hash,
+				      const uint8_t *key, size_t key_len)
+{
+	struct cache_entry *iter;
+
+	for (iter = _cache_head; iter != NULL; iter = iter->next) {
+		if (iter->hash != hash || iter->key_len != key_len ||
+		    memcmp(iter->key, key, key_len) != 0)
+			continue;
+
+		if (iter != _cache_head) {
+			_list_del(iter);
+			_list_add(iter);
+		}
+		return iter;
+	}
+
+	return NULL;
+}
+
+/**
+ * Add an entry to the cache list
+ * @param entry the cache entry
+ *
+ * Add the entry to the front of the cache list, unless the list already holds
+ * the same key, and drop the least recently used entries which no longer fit
+ * in the cache.  The caller must hold the cache lock.  The entry is owned by
+ * the cache once this function returns.
+ *
+ */
+static void _list_insert(struct cache_entry *entry)
+{
+	struct cache_entry *iter;
+
+	if (_cache_size == 0 ||
+	    _list_find(entry->hash, entry->key, entry->key_len) != NULL) {
+		_entry_free(entry);
+		return;
+	}
+
+	_list_add(entry);
+	while (_cache_cnt > _cache_size) {
+		iter = _cache_tail;
+		_list_del(iter);
+		_entry_free(iter);
+	}
+}
+
+/**
+ * Read from a file descriptor until the buffer is full
+ * @param fd the file descriptor
+ * @param buf the buffer
+ * @param len the length of the buffer
+ *
+ * Returns zero on success, negative values on failure.
+ *
+ */
+static int _read_full(int fd, void *buf, size_t len)
+{
+	ssize_t rc;
+	uint8_t *pos = buf;
+
+	while (len > 0) {
+		rc = read(fd, pos, len);
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc < 0)
+			return -errno;
+		if (rc == 0)
+			return -EIO;
+		pos += rc;
+		len -= rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Write a buffer to a file descriptor
+ * @param fd the file descriptor
+ * @param buf the buffer
+ * @param len the length of the buffer
+ *
+ * Returns zero on success, negative values on failure.
+ *
+ */
+static int _write_full(int fd, const void *buf, size_t len)
+{
+	ssize_t rc;
+	const uint8_t *pos = buf;
+
+	while (len > 0) {
+		rc = write(fd, pos, len);
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc < 0)
+			return -errno;
+		pos += rc;
+		len -= rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Generate the name of a cache file
+ * @param path the cache directory
+ * @param hash the hash of the key
+ * @param key_len the length of the key
+ *
+ * Returns a pointer to the file name on success, NULL on failure.  The caller
+ * is responsible for freeing the file name.
+ *
+ */
+static char *_file_name(const char *path, uint32_t hash, size_t key_len)
+{
+	int len;
+	char *name;
+
+	len = snprintf(NULL, 0, "%s/%08" PRIx32 "-%zx.bpf", path, hash, key_len);
+	if (len < 0)
+		return NULL;
+	name = malloc(len + 1);
+	if (name == NULL)
+		return NULL;
+	snprintf(name, len + 1, "%s/%08" PRIx32 "-%zx.bpf", path, hash, key_len);
+
+	return name;
+}
+
+/**
+ * Read a program from the cache directory
+ * @param path the cache directory
+ * @param hash the hash of the key
+ * @param key the canonical key
+ * @param key_len the length of the key
+ *
+ * Look for the program generated from the given key in the cache directory.
+ * Returns a new cache entry if the program was found, NULL otherwise.
+ *
+ */
+static struct cache_entry *_file_read(const char *path, uint32_t hash,
+				      const uint8_t *key, size_t key_len)
+{
+	int fd;
+	char *name;
+	uint8_t *data = NULL;
+	struct stat st;
+	struct cache_file_hdr hdr;
+	struct cache_entry *entry = NULL;
+
+	name = _file_name(path, hash, key_len);
+	if (name == NULL)
+		return NULL;
+	fd = open(name, O_RDONLY | O_CLOEXEC);
+	free(name);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+		goto read_return;
+	if (_read_full(fd, &hdr, sizeof(hdr)) < 0)
+		goto read_return;
+	if (memcmp(hdr.magic, _CACHE_MAGIC, sizeof(hdr.magic)) != 0 ||
+	    hdr.key_len != key_len || hdr.blk_cnt == 0 ||
+	    hdr.blk_cnt > UINT16_MAX ||
+	    (uint64_t)st.st_size != (sizeof(hdr) + key_len +
+				     hdr.blk_cnt * sizeof(bpf_instr_raw)))
+		goto read_return;
+
+	data = malloc(st.st_size - sizeof(hdr));
+	if (data == NULL)
+		goto read_return;
+	if (_read_full(fd, data, st.st_size - sizeof(hdr)) < 0)
+		goto read_return;
+	if (memcmp(data, key, key_len) != 0)
+		goto read_return;
+
+	entry = _entry_new(hash, key, key_len,
+			   (bpf_instr_raw *)(data + key_len), hdr.blk_cnt);
+	if (entry != NULL) {
+		entry->peephole = hdr.peephole;
+		entry->trampolines = hdr.trampolines;
+	}
+
+read_return:
+	if (data != NULL)
+		free(data);
+	close(fd);
+	return entry;
+}
+
+/**
+ * Write a program to the cache directory
+ * @param path the cache directory
+ * @param entry the cache entry
+ *
+ * Write the program to the cache directory.  The file is written under a
+ * temporary name and then renamed, so other processes never see a partially
+ * written file.  Errors are ignored as the cache is only an optimization.
+ *
+ */
+static void _file_write(const char *path, const struct cache_entry *entry)
+{
+	int rc, fd;
+	char *name, *tmp;
+	struct cache_file_hdr hdr;
+
+	name = _file_name(path, entry->hash, entry->key_len);
+	if (name == NULL)
+		return;
+	tmp = malloc(strlen(name) + sizeof(".XXXXXX"));
+	if (tmp == NULL) {
+		free(name);
+		return;
+	}
+	strcpy(tmp, name);
+	strcat(tmp, ".XXXXXX");
+
+	fd = mkstemp(tmp);
+	if (fd < 0)
+		goto write_return;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, _CACHE_MAGIC, sizeof(hdr.magic));
+	hdr.key_len = entry->key_len;
+	hdr.blk_cnt = entry->prgm.blk_cnt;
+	hdr.peephole = entry->peephole;
+	hdr.trampolines = entry->trampolines;
+	rc = _write_full(fd, &hdr, sizeof(hdr));
+	if (rc == 0)
+		rc = _write_full(fd, entry->key, entry->key_len);
+	if (rc == 0)
+		rc = _write_full(fd, entry->prgm.blks,
+				 BPF_PGM_SIZE(&entry->prgm));
+	if (close(fd) < 0 && rc == 0)
+		rc = -errno;
+	if (rc == 0 && rename(tmp, name) == 0)
+		goto write_return;
+	unlink(tmp);
+
+write_return:
+	free(tmp);
+	free(name);
+}
+
+/**
+ * Copy a cached program
+ * @param entry the cache entry
+ *
+ * Returns a new copy of the cached program on success, NULL on failure.  The
+ * copy can be freed with gen_bpf_release().
+ *
+ */
+static struct bpf_program *_program_dup(const struct cache_entry *entry)
+{
+	struct bpf_program *prgm;
+
+	prgm = zmalloc(sizeof(*prgm));
+	if (prgm == NULL)
+		return NULL;
+	prgm->blk_cnt = entry->prgm.blk_cnt;
+	prgm->blks = malloc(BPF_PGM_SIZE(prgm));
+	if (prgm->blks == NULL) {
+		free(prgm);
+		return NULL;
+	}
+	memcpy(prgm->blks, entry->prgm.blks, BPF_PGM_SIZE(prgm));
+
+	return prgm;
+}
+
+/**
+ * Check if the filter cache is enabled
+ *
+ * Returns true if either the in-memory cache or the cache directory is in
+ * use, false otherwise.
+ *
+ */
+static bool _cache_enabled(void)
+{
+	bool enabled;
+
+	pthread_mutex_lock(&_cache_lock);
+	enabled = (_cache_size > 0 || _cache_path != NULL);
+	pthread_mutex_unlock(&_cache_lock);
+
+	return enabled;
+}
+
+/**
+ * Configure the filter cache
+ * @param size the number of programs to keep in memory
+ * @param path the cache directory, or NULL
+ *
+ * This function sets the number of programs kept in the in-memory cache and
+ * the directory used to share programs between processes.  Programs which no
+ * longer fit in memory are dropped, starting with the least recently used.
+ * The cache is disabled if @size is zero and @path is NULL.  Returns zero on
+ * success, negative values on failure.
+ *
+ */
+int cache_set(unsigned int size, const char *path)
+{
+	char *path_new = NULL;
+	struct stat st;
+	struct cache_entry *iter;
+
+	if (path != NULL) {
+		if (stat(path, &st) < 0)
+			return -errno;
+		if (!S_ISDIR(st.st_mode))
+			return -ENOTDIR;
+		path_new = strdup(path);
+		if (path_new == NULL)
+			return -ENOMEM;
+	}
+
+	pthread_mutex_lock(&_cache_lock);
+	if (_cache_path != NULL)
+		free(_cache_path);
+	_cache_path = path_new;
+	_cache_size = size;
+	while (_cache_cnt > _cache_size) {
+		iter = _cache_tail;
+		_list_del(iter);
+		_entry_free(iter);
+	}
+	pthread_mutex_unlock(&_cache_lock);
+
+	return 0;
+}
+
+/**
+ * Find the program generated from a filter collection
+ * @param col the seccomp filter collection
+ * @param prgm the BPF program
+ *
+ * This function looks for the program generated from the given filter
+ * collection, first in memory and then in the cache directory.  If found, a
+ * copy of the program is returned via @prgm and the collection's statistics
+ * are updated as if the program had just been generated.  Returns one if the
+ * program was found, zero if it was not found or the cache is disabled, and
+ * negative values on failure.
+ *
+ */
+int cache_lookup(struct db_filter_col *col, struct bpf_program **prgm)
+{
+	int rc;
+	uint32_t hash_val;
+	const uint8_t *key;
+	size_t key_len;
+	char *path = NULL;
+	struct cache_entry *entry;
+	struct bpf_program *copy = NULL;
+
+	if (!_cache_enabled())
+		return 0;
+
+	rc = db_col_key(col, &key, &key_len);
+	if (rc < 0)
+		return rc;
+	hash_val = hash(key, key_len);
+
+	pthread_mutex_lock(&_cache_lock);
+	entry = _list_find(hash_val, key, key_len);
+	if (entry != NULL) {
+		copy = _program_dup(entry);
+		if (copy != NULL) {
+			col->stats.peephole = entry->peephole;
+			col->stats.trampolines = entry->trampolines;
+		}
+	} else if (_cache_path != NULL)
+		path = strdup(_cache_path);
+	pthread_mutex_unlock(&_cache_lock);
+	if (entry != NULL && copy == NULL)
+		return -ENOMEM;
+
+	if (copy == NULL && path != NULL) {
+		entry = _file_read(path, hash_val, key, key_len);
+		free(path);
+		if (entry != NULL) {
+			copy = _program_dup(entry);
+			if (copy != NULL) {
+				col->stats.peephole = entry->peephole;
+				col->stats.trampolines = entry->trampolines;
+			}
+			pthread_mutex_lock(&_cache_lock);
+			_list_insert(entry);
+			pthread_mutex_unlock(&_cache_lock);
+		}
+	}
+
+	if (copy == NULL) {
+		col->stats.cache_misses++;
+		return 0;
+	}
+	col->stats.cache_hits++;
+	*prgm = copy;
+	return 1;
+}
+
+/**
+ * Add a program to the filter cache
+ * @param col the seccomp filter collection
+ * @param prgm the BPF program generated from the filter collection
+ *
+ * This function adds the program to the in-memory cache and writes it to the
+ * cache directory.  Errors are ignored as the cache is only an optimization.
+ *
+ */
+void cache_store(struct db_filter_col *col, const struct bpf_program *prgm)
+{
+	const uint8_t *key;
+	size_t key_len;
+	char *path = NULL;
+	struct cache_entry *entry;
+
+	if (!_cache_enabled())
+		return;
+
+	if (db_col_key(col, &key, &key_len) < 0)
+		return;
+	entry = _entry_new(hash(key, key_len), key, key_len,
+			   prgm->blks, prgm->blk_cnt);
+	if (entry == NULL)
+		return;
+	entry->peephole = col->stats.peephole;
+	entry->trampolines = col->stats.trampolines;
+
+	pthread_mutex_lock(&_cache_lock);
+	if (_cache_path != NULL)
+		path = strdup(_cache_path);
+	pthread_mutex_unlock(&_cache_lock);
+
+	if (path != NULL) {
+		_file_write(path, entry);
+		free(path);
+	}
+
+	pthread_mutex_lock(&_cache_lock);
+	_list_insert(entry);
+	pthread_mutex_unlock(&_cache_lock);
+}
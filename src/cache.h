@@ -0,0 +1,32 @@
+/**
+ * Seccomp BPF Filter Cache
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include "db.h"
+#include "gen_bpf.h"
+
+int cache_set(unsigned int size, const char *path);
+
+int cache_lookup(struct db_filter_col *col, struct bpf_program **prgm);
+void cache_store(struct db_filter_col *col, const struct bpf_program *prgm);
+
+#endif
@@ -21,16 +21,19 @@
  */
 
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <unistd.h>
 
 #include <seccomp.h>
 
 #include "arch.h"
 #include "db.h"
+#include "gen_bpf.h"
 #include "system.h"
 #include "helper.h"
 
@@ -38,12 +41,73 @@
 #define _DB_STA_VALID			0xA1B2C3D4
 #define _DB_STA_FREED			0x1A2B3C4D
 
-/* the priority field is fairly simple - without any user hints, or in the case
- * of a hint "tie", we give higher priority to syscalls with less chain nodes
- * (filter is easier to evaluate) */
-#define _DB_PRI_MASK_CHAIN		0x0000FFFF
-#define _DB_PRI_MASK_USER		0x00FF0000
-#define _DB_PRI_USER(x)			(((x) << 16) & _DB_PRI_MASK_USER)
+/* minimum size of the syscall index */
+#define _DB_SYS_IDX_MIN			32
+
+/* syscall frequency profile entry */
+struct db_sys_freq {
+	int num;
+	uint64_t count;
+};
+
+/* buffer used to build the canonical key of a filter collection */
+struct db_key_buf {
+	uint8_t *data;
+	size_t len;
+	size_t alloc;
+	int rc;
+};
+
+/* binary format of a filter collection, see db_col_export(); the fields are in
+ * host byte order and every record is a multiple of eight bytes long so the
+ * records can be read in place */
+#define _DB_BLOB_MAGIC			0x504d4353
+#define _DB_BLOB_VERSION		1
+
+struct db_blob_hdr {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t len;
+	uint32_t act_default;
+	uint32_t attr_cnt;
+	uint32_t filter_cnt;
+	uint32_t reserved;
+	/* followed by attr_cnt db_blob_attr records and filter_cnt filters */
+};
+
+struct db_blob_attr {
+	uint32_t attr;
+	uint32_t value;
+};
+
+struct db_blob_filter {
+	uint32_t arch;
+	uint32_t rule_cnt;
+	uint32_t pri_cnt;
+	uint32_t reserved;
+	/* followed by rule_cnt db_blob_rule and pri_cnt db_blob_pri records */
+};
+
+struct db_blob_arg {
+	uint32_t arg;
+	uint32_t op;
+	uint64_t mask;
+	uint64_t datum;
+};
+
+struct db_blob_rule {
+	uint32_t action;
+	int32_t syscall;
+	uint32_t strict;
+	/* bitmask of the valid entries in args */
+	uint32_t arg_valid;
+	struct db_blob_arg args[ARG_COUNT_MAX];
+};
+
+struct db_blob_pri {
+	int32_t syscall;
+	uint32_t priority;
+};
 
 /* prove information about the sub-tree check results */
 struct db_iter_state {
@@ -64,6 +128,8 @@ struct db_iter_state {
 };
 
 static unsigned int _db_node_put(struct db_arg_chain_tree **node);
+static int _db_col_rule_add(struct db_filter *filter,
+			    struct db_api_rule_list *rule);
 
 /**
  * Define the syscall argument priority for nodes on the same level of the tree
@@ -814,6 +880,308 @@ static int _db_tree_add(struct db_arg_chain_tree **existing,
 	return 0;
 }
 
+/**
+ * Reset the copy pointers left by a tree copy
+ * @param node tree node
+ * @param release release the copied nodes
+ *
+ * Walk the levels copied by _db_level_copy() starting with the level on which
+ * @node resides, clearing the copy pointers and optionally freeing the copied
+ * nodes.
+ *
+ */
+static void _db_level_copy_reset(struct db_arg_chain_tree *node, bool release)
+{
+	struct db_arg_chain_tree *n;
+
+	if (node == NULL)
+		return;
+
+	while (node->lvl_prv)
+		node = node->lvl_prv;
+
+	for (n = node; n != NULL; n = n->lvl_nxt) {
+		if (n->cpy == NULL)
+			continue;
+		if (release)
+			free(n->cpy);
+		n->cpy = NULL;
+		_db_level_copy_reset(n->nxt_t, release);
+		_db_level_copy_reset(n->nxt_f, release);
+	}
+}
+
+/**
+ * Copy a level of a syscall filter argument chain tree
+ * @param node tree node
+ *
+ * Copy the entire level on which @node resides, and all of the levels beneath
+ * it, taking care to preserve any nodes shared within the tree; the copy of
+ * each node is recorded in the original node's copy pointer.  The copied nodes
+ * keep the original reference counts as every reference to a node comes from
+ * within the tree, or from the tree's owner.  Returns a pointer to the copy of
+ * @node on success, NULL on failure.
+ *
+ */
+static struct db_arg_chain_tree *_db_level_copy(struct db_arg_chain_tree *node)
+{
+	struct db_arg_chain_tree *start, *n, *c_new, *c_prev = NULL;
+
+	if (node->cpy != NULL)
+		return node->cpy;
+
+	start = node;
+	while (start->lvl_prv)
+		start = start->lvl_prv;
+
+	/* copy the level */
+	for (n = start; n != NULL; n = n->lvl_nxt) {
+		c_new = malloc(sizeof(*c_new));
+		if (c_new == NULL)
+			return NULL;
+		memcpy(c_new, n, sizeof(*c_new));
+		c_new->lvl_prv = c_prev;
+		c_new->lvl_nxt = NULL;
+		c_new->nxt_t = NULL;
+		c_new->nxt_f = NULL;
+		c_new->cpy = NULL;
+		if (c_prev != NULL)
+			c_prev->lvl_nxt = c_new;
+		n->cpy = c_new;
+		c_prev = c_new;
+	}
+
+	/* copy the levels beneath */
+	for (n = start; n != NULL; n = n->lvl_nxt) {
+		if (n->nxt_t != NULL) {
+			n->cpy->nxt_t = _db_level_copy(n->nxt_t);
+			if (n->cpy->nxt_t == NULL)
+				return NULL;
+		}
+		if (n->nxt_f != NULL) {
+			n->cpy->nxt_f = _db_level_copy(n->nxt_f);
+			if (n->cpy->nxt_f == NULL)
+				return NULL;
+		}
+	}
+
+	return node->cpy;
+}
+
+/**
+ * Copy a syscall filter argument chain tree
+ * @param tree the argument chain tree
+ *
+ * This function creates an exact copy of the given tree.  Returns a pointer to
+ * the new tree on success, NULL on failure.
+ *
+ */
+static struct db_arg_chain_tree *_db_tree_copy(struct db_arg_chain_tree *tree)
+{
+	struct db_arg_chain_tree *copy;
+
+	if (tree == NULL)
+		return NULL;
+
+	copy = _db_level_copy(tree);
+	_db_level_copy_reset(tree, copy == NULL);
+
+	return copy;
+}
+
+/**
+ * Collect the nodes of a syscall filter argument chain tree
+ * @param node tree node
+ * @param list the list of collected nodes
+ *
+ * Add every node on the level on which @node resides, and all of the levels
+ * beneath it, to the given list; the list is linked through the nodes' copy
+ * pointers and the nodes' reference counts are cleared to mark them as
+ * collected.
+ *
+ */
+static void _db_level_collect(struct db_arg_chain_tree *node,
+			      struct db_arg_chain_tree **list)
+{
+	struct db_arg_chain_tree *n;
+
+	if (node == NULL || node->refcnt == 0)
+		return;
+
+	while (node->lvl_prv)
+		node = node->lvl_prv;
+
+	for (n = node; n != NULL; n = n->lvl_nxt) {
+		n->refcnt = 0;
+		n->cpy = *list;
+		*list = n;
+	}
+	for (n = node; n != NULL; n = n->lvl_nxt) {
+		_db_level_collect(n->nxt_t, list);
+		_db_level_collect(n->nxt_f, list);
+	}
+}
+
+/**
+ * Free a copy of a syscall filter argument chain tree
+ * @param tree the argument chain tree
+ *
+ * This function frees an entire tree created by _db_tree_copy() without the
+ * reference counting done by _db_tree_put(), which is only safe because
+ * nothing outside of the tree refers to its nodes.
+ *
+ */
+static void _db_tree_free(struct db_arg_chain_tree *tree)
+{
+	struct db_arg_chain_tree *list = NULL, *n_next;
+
+	_db_level_collect(tree, &list);
+	while (list != NULL) {
+		n_next = list->cpy;
+		free(list);
+		list = n_next;
+	}
+}
+
+/**
+ * Free a list of saved syscall entries
+ * @param snap the list of saved syscall entries
+ *
+ * This function frees the given list along with the saved state of each
+ * syscall entry, the syscall entries themselves are left untouched.
+ *
+ */
+static void _db_sys_snap_free(struct db_sys_snap *snap)
+{
+	struct db_sys_snap *s_next;
+
+	while (snap != NULL) {
+		s_next = snap->next;
+		if (snap->orig != NULL) {
+			_db_tree_free(snap->orig->chains);
+			free(snap->orig);
+		}
+		free(snap);
+		snap = s_next;
+	}
+}
+
+/**
+ * Find a syscall entry in the seccomp filter DB
+ * @param db the seccomp filter DB
+ * @param syscall the syscall number
+ * @param pos the position of the entry in the syscall index
+ *
+ * Search the syscall index for the given syscall, setting @pos to the position
+ * of the entry or, if the entry does not exist, to the position where it would
+ * be inserted.  The syscall numbers are compared as unsigned values, just like
+ * the sorted syscall list, so the negative pseudo syscalls sort last.  Returns
+ * a pointer to the entry if found, NULL otherwise.
+ *
+ */
+static struct db_sys_list *_db_sys_find(const struct db_filter *db,
+					int syscall, unsigned int *pos)
+{
+	unsigned int num = syscall;
+	unsigned int lo = 0, hi = db->sys_cnt, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (db->sys_idx[mid]->num < num)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	*pos = lo;
+	if (lo < db->sys_cnt && db->sys_idx[lo]->num == num)
+		return db->sys_idx[lo];
+	return NULL;
+}
+
+/**
+ * Reserve space for a new syscall entry in the seccomp filter DB
+ * @param db the seccomp filter DB
+ *
+ * Make sure the syscall index has room for at least one more entry so that
+ * inserting a new entry can not fail.  Returns zero on success, negative
+ * values on failure.
+ *
+ */
+static int _db_sys_reserve(struct db_filter *db)
+{
+	unsigned int alloc;
+	struct db_sys_list **idx;
+
+	if (db->sys_cnt < db->sys_alloc)
+		return 0;
+
+	alloc = (db->sys_alloc > 0 ? db->sys_alloc * 2 : _DB_SYS_IDX_MIN);
+	idx = realloc(db->sys_idx, sizeof(*idx) * alloc);
+	if (idx == NULL)
+		return -ENOMEM;
+	db->sys_idx = idx;
+	db->sys_alloc = alloc;
+
+	return 0;
+}
+
+/**
+ * Insert a syscall entry into the seccomp filter DB
+ * @param db the seccomp filter DB
+ * @param sys the syscall entry
+ * @param pos the position from _db_sys_find()
+ *
+ * Add the syscall entry to both the sorted syscall list and the syscall index,
+ * the caller must reserve space in the index with _db_sys_reserve() first.
+ *
+ */
+static void _db_sys_insert(struct db_filter *db,
+			   struct db_sys_list *sys, unsigned int pos)
+{
+	struct db_sys_list *s_prev = (pos > 0 ? db->sys_idx[pos - 1] : NULL);
+
+	if (s_prev != NULL) {
+		sys->next = s_prev->next;
+		s_prev->next = sys;
+	} else {
+		sys->next = db->syscalls;
+		db->syscalls = sys;
+	}
+
+	memmove(&db->sys_idx[pos + 1], &db->sys_idx[pos],
+		sizeof(*db->sys_idx) * (db->sys_cnt - pos));
+	db->sys_idx[pos] = sys;
+	db->sys_cnt++;
+}
+
+/**
+ * Remove a syscall entry from the seccomp filter DB
+ * @param db the seccomp filter DB
+ * @param sys the syscall entry
+ *
+ * Remove the syscall entry from both the sorted syscall list and the syscall
+ * index, the entry itself is not freed.
+ *
+ */
+static void _db_sys_remove(struct db_filter *db, struct db_sys_list *sys)
+{
+	unsigned int pos;
+
+	if (_db_sys_find(db, sys->num, &pos) != sys)
+		return;
+
+	if (pos > 0)
+		db->sys_idx[pos - 1]->next = sys->next;
+	else
+		db->syscalls = sys->next;
+	sys->next = NULL;
+
+	db->sys_cnt--;
+	memmove(&db->sys_idx[pos], &db->sys_idx[pos + 1],
+		sizeof(*db->sys_idx) * (db->sys_cnt - pos));
+}
+
 /**
  * Free and reset the seccomp filter DB
  * @param db the seccomp filter DB
@@ -830,6 +1198,10 @@ static void _db_reset(struct db_filter *db)
 	if (db == NULL)
 		return;
 
+	/* free any saved transaction state */
+	_db_sys_snap_free(db->snap);
+	db->snap = NULL;
+
 	/* free any filters */
 	if (db->syscalls != NULL) {
 		s_iter = db->syscalls;
@@ -841,6 +1213,10 @@ static void _db_reset(struct db_filter *db)
 		}
 		db->syscalls = NULL;
 	}
+	free(db->sys_idx);
+	db->sys_idx = NULL;
+	db->sys_cnt = 0;
+	db->sys_alloc = 0;
 
 	/* free any rules */
 	if (db->rules != NULL) {
@@ -894,9 +1270,84 @@ static void _db_release(struct db_filter *db)
 
 	/* free and reset the DB */
 	_db_reset(db);
+	gen_bpf_cache_release(db->chain_cache);
 	free(db);
 }
 
+/**
+ * Save a syscall entry before it is changed
+ * @param db the seccomp filter DB
+ * @param sys the syscall entry
+ *
+ * Save a copy of the syscall entry if it is about to be changed by the current
+ * transaction and hasn't been saved already, so that it can be restored if the
+ * transaction is aborted.  Returns zero on success, negative values on
+ * failure.
+ *
+ */
+static int _db_sys_snap_save(struct db_filter *db, struct db_sys_list *sys)
+{
+	struct db_sys_snap *snap;
+	struct db_sys_list *orig;
+
+	if (db->snap_id == 0 || sys->snap_id == db->snap_id)
+		return 0;
+
+	snap = zmalloc(sizeof(*snap));
+	if (snap == NULL)
+		return -ENOMEM;
+	orig = malloc(sizeof(*orig));
+	if (orig == NULL) {
+		free(snap);
+		return -ENOMEM;
+	}
+	memcpy(orig, sys, sizeof(*orig));
+	orig->next = NULL;
+	orig->chains = _db_tree_copy(sys->chains);
+	if (sys->chains != NULL && orig->chains == NULL) {
+		free(orig);
+		free(snap);
+		return -ENOMEM;
+	}
+
+	snap->sys = sys;
+	snap->orig = orig;
+	snap->snap_id = sys->snap_id;
+	snap->next = db->snap;
+	db->snap = snap;
+	sys->snap_id = db->snap_id;
+
+	return 0;
+}
+
+/**
+ * Record a syscall entry added by the current transaction
+ * @param db the seccomp filter DB
+ * @param sys the new syscall entry
+ *
+ * Record the syscall entry, which must be added to the DB immediately after
+ * this call, so that it can be removed if the transaction is aborted.  Returns
+ * zero on success, negative values on failure.
+ *
+ */
+static int _db_sys_snap_add(struct db_filter *db, struct db_sys_list *sys)
+{
+	struct db_sys_snap *snap;
+
+	if (db->snap_id == 0)
+		return 0;
+
+	snap = zmalloc(sizeof(*snap));
+	if (snap == NULL)
+		return -ENOMEM;
+	snap->sys = sys;
+	snap->next = db->snap;
+	db->snap = snap;
+	sys->snap_id = db->snap_id;
+
+	return 0;
+}
+
 /**
  * Destroy a seccomp filter snapshot
  * @param snap the seccomp filter snapshot
@@ -912,13 +1363,13 @@ static void _db_snap_release(struct db_filter_snap *snap)
 	if (snap == NULL)
 		return;
 
-	if (snap->filter_cnt > 0) {
-		for (iter = 0; iter < snap->filter_cnt; iter++) {
-			if (snap->filters[iter])
-				_db_release(snap->filters[iter]);
-		}
-		free(snap->filters);
+	if (snap->sys != NULL) {
+		for (iter = 0; iter < snap->filter_cnt; iter++)
+			_db_sys_snap_free(snap->sys[iter]);
+		free(snap->sys);
 	}
+	free(snap->rules);
+	free(snap->filters);
 	free(snap);
 }
 
@@ -939,19 +1390,17 @@ static int _db_syscall_priority(struct db_filter *db,
 				int syscall, uint8_t priority)
 {
 	unsigned int sys_pri = _DB_PRI_USER(priority);
-	struct db_sys_list *s_new, *s_iter, *s_prev = NULL;
+	unsigned int pos;
+	struct db_sys_list *s_new, *s_iter;
 
 	assert(db != NULL);
 
-	s_iter = db->syscalls;
-	while (s_iter != NULL && s_iter->num < syscall) {
-		s_prev = s_iter;
-		s_iter = s_iter->next;
-	}
-
 	/* matched an existing syscall entry */
-	if (s_iter != NULL && s_iter->num == syscall) {
+	s_iter = _db_sys_find(db, syscall, &pos);
+	if (s_iter != NULL) {
 		if (sys_pri > (s_iter->priority & _DB_PRI_MASK_USER)) {
+			if (_db_sys_snap_save(db, s_iter) < 0)
+				return -ENOMEM;
 			s_iter->priority &= (~_DB_PRI_MASK_USER);
 			s_iter->priority |= sys_pri;
 		}
@@ -965,15 +1414,11 @@ static int _db_syscall_priority(struct db_filter *db,
 	s_new->num = syscall;
 	s_new->priority = sys_pri;
 	s_new->valid = false;
-
-	/* add it before s_iter */
-	if (s_prev != NULL) {
-		s_new->next = s_prev->next;
-		s_prev->next = s_new;
-	} else {
-		s_new->next = db->syscalls;
-		db->syscalls = s_new;
+	if (_db_sys_reserve(db) < 0 || _db_sys_snap_add(db, s_new) < 0) {
+		free(s_new);
+		return -ENOMEM;
 	}
+	_db_sys_insert(db, s_new, pos);
 
 	return 0;
 }
@@ -991,7 +1436,7 @@ static int _db_syscall_priority(struct db_filter *db,
  */
 static struct db_api_rule_list *_db_rule_new(bool strict,
 					     uint32_t action, int syscall,
-					     struct db_api_arg *chain)
+					     const struct db_api_arg *chain)
 {
 	struct db_api_rule_list *rule;
 
@@ -1029,6 +1474,22 @@ struct db_api_rule_list *db_rule_dup(const struct db_api_rule_list *src)
 	return dest;
 }
 
+/**
+ * Discard the canonical key of a filter collection
+ * @param col the seccomp filter collection
+ *
+ * This function must be called whenever the filter collection changes in a way
+ * that could change the generated filter.
+ *
+ */
+static void _db_col_key_reset(struct db_filter_col *col)
+{
+	if (col->key != NULL)
+		free(col->key);
+	col->key = NULL;
+	col->key_len = 0;
+}
+
 /**
  * Free and reset the seccomp filter collection
  * @param col the seccomp filter collection
@@ -1057,6 +1518,7 @@ int db_col_reset(struct db_filter_col *col, uint32_t def_action)
 		free(col->filters);
 	col->filters = NULL;
 	col->notify_fd = -1;
+	_db_col_key_reset(col);
 
 	/* set the endianess to undefined */
 	col->endian = 0;
@@ -1069,6 +1531,13 @@ int db_col_reset(struct db_filter_col *col, uint32_t def_action)
 	col->attr.api_tskip = 0;
 	col->attr.log_enable = 0;
 	col->attr.spec_allow = 0;
+	col->attr.optimize = 1;
+	col->attr.peephole = 1;
+	col->attr.split_enable = 0;
+	col->attr.parallel = 0;
+
+	/* reset the statistics */
+	memset(&col->stats, 0, sizeof(col->stats));
 
 	/* set the state */
 	col->state = _DB_STA_VALID;
@@ -1090,10 +1559,7 @@ int db_col_reset(struct db_filter_col *col, uint32_t def_action)
 	while (col->snapshots) {
 		snap = col->snapshots;
 		col->snapshots = snap->next;
-		for (iter = 0; iter < snap->filter_cnt; iter++)
-			_db_release(snap->filters[iter]);
-		free(snap->filters);
-		free(snap);
+		_db_snap_release(snap);
 	}
 
 	return 0;
@@ -1159,6 +1625,7 @@ void db_col_release(struct db_filter_col *col)
 	if (col->filters)
 		free(col->filters);
 	col->filters = NULL;
+	_db_col_key_reset(col);
 
 	/* free the collection */
 	free(col);
@@ -1246,6 +1713,8 @@ int db_col_merge(struct db_filter_col *col_dst, struct db_filter_col *col_src)
 		col_dst->filter_cnt++;
 	}
 
+	_db_col_key_reset(col_dst);
+
 	/* free the source */
 	col_src->filter_cnt = 0;
 	db_col_release(col_src);
@@ -1311,6 +1780,18 @@ int db_col_attr_get(const struct db_filter_col *col,
 	case SCMP_FLTATR_CTL_SSB:
 		*value = col->attr.spec_allow;
 		break;
+	case SCMP_FLTATR_CTL_OPTIMIZE:
+		*value = col->attr.optimize;
+		break;
+	case SCMP_FLTATR_CTL_PEEPHOLE:
+		*value = col->attr.peephole;
+		break;
+	case SCMP_FLTATR_CTL_SPLIT:
+		*value = col->attr.split_enable;
+		break;
+	case SCMP_FLTATR_CTL_PARALLEL:
+		*value = col->attr.parallel;
+		break;
 	default:
 		rc = -EEXIST;
 		break;
@@ -1386,52 +1867,613 @@ int db_col_attr_set(struct db_filter_col *col,
 			rc = -EOPNOTSUPP;
 		}
 		break;
+	case SCMP_FLTATR_CTL_OPTIMIZE:
+		switch (value) {
+		case 1:
+		case 2:
+			col->attr.optimize = value;
+			break;
+		default:
+			rc = -EINVAL;
+			break;
+		}
+		break;
+	case SCMP_FLTATR_CTL_PEEPHOLE:
+		col->attr.peephole = (value ? 1 : 0);
+		break;
+	case SCMP_FLTATR_CTL_SPLIT:
+		col->attr.split_enable = (value ? 1 : 0);
+		break;
+	case SCMP_FLTATR_CTL_PARALLEL:
+		col->attr.parallel = (value ? 1 : 0);
+		break;
 	default:
 		rc = -EEXIST;
 		break;
 	}
 
+	if (rc == 0)
+		_db_col_key_reset(col);
 	return rc;
 }
 
 /**
- * Add a new architecture filter to a filter collection
- * @param col the seccomp filter collection
- * @param arch the architecture
+ * Add data to a canonical key
+ * @param key the key buffer
+ * @param data the data
+ * @param len the length of the data
  *
- * This function adds a new architecture filter DB to an existing seccomp
- * filter collection assuming there isn't a filter DB already present with the
- * same architecture.  Returns zero on success, negative values on failure.
+ * This is a helper function for db_col_key(), it appends the data to the key
+ * and grows the key buffer as needed.  Once an append fails all further
+ * appends are ignored and the error is kept in the key buffer.
  *
  */
-int db_col_db_new(struct db_filter_col *col, const struct arch_def *arch)
+static void _db_key_put(struct db_key_buf *key, const void *data, size_t len)
 {
-	int rc;
-	struct db_filter *db;
+	size_t alloc;
+	uint8_t *data_new;
 
-	db = _db_init(arch);
-	if (db == NULL)
-		return -ENOMEM;
-	rc = db_col_db_add(col, db);
-	if (rc < 0)
-		_db_release(db);
+	if (key->rc < 0)
+		return;
 
-	return rc;
+	if (key->len + len > key->alloc) {
+		alloc = (key->alloc > 0 ? key->alloc : 256);
+		while (key->len + len > alloc)
+			alloc *= 2;
+		data_new = realloc(key->data, alloc);
+		if (data_new == NULL) {
+			key->rc = -ENOMEM;
+			return;
+		}
+		key->data = data_new;
+		key->alloc = alloc;
+	}
+	memcpy(key->data + key->len, data, len);
+	key->len += len;
 }
 
 /**
- * Add a new filter DB to a filter collection
+ * Get the canonical key of a filter collection
  * @param col the seccomp filter collection
- * @param db the seccomp filter DB
+ * @param key the canonical key
+ * @param key_len the length of the canonical key
  *
- * This function adds an existing seccomp filter DB to an existing seccomp
- * filter collection assuming there isn't a filter DB already present with the
- * same architecture.  Returns zero on success, negative values on failure.
+ * This function describes everything in the filter collection that affects
+ * the generated BPF filter as a flat sequence of bytes: the library version,
+ * the attributes used by the BPF generator, the architectures and, for each
+ * architecture, the syscall priorities and the rules in the order they were
+ * added.  Two collections with the same key generate the same BPF filter.  The
+ * key is built on first use and kept, owned by the collection, until the
+ * collection is changed.  Returns zero on success, negative values on failure.
  *
  */
-int db_col_db_add(struct db_filter_col *col, struct db_filter *db)
+int db_col_key(struct db_filter_col *col,
+	       const uint8_t **key, size_t *key_len)
 {
-	struct db_filter **dbs;
+	unsigned int iter, a_iter;
+	uint32_t val32[4];
+	uint64_t val64[2];
+	struct db_key_buf buf;
+	struct db_filter *db;
+	struct db_sys_list *s_iter;
+	struct db_api_rule_list *r_iter;
+	const struct db_api_arg *arg;
+
+	if (col->key != NULL)
+		goto key_return;
+
+	memset(&buf, 0, sizeof(buf));
+
+	val32[0] = SCMP_VER_MAJOR;
+	val32[1] = SCMP_VER_MINOR;
+	val32[2] = SCMP_VER_MICRO;
+	val32[3] = col->endian;
+	_db_key_put(&buf, val32, sizeof(val32));
+	val32[0] = col->attr.act_default;
+	val32[1] = col->attr.act_badarch;
+	val32[2] = col->attr.optimize;
+	val32[3] = col->attr.peephole;
+	_db_key_put(&buf, val32, sizeof(val32));
+
+	for (iter = 0; iter < col->filter_cnt; iter++) {
+		db = col->filters[iter];
+
+		val32[0] = db->arch->token;
+		val32[1] = db->sys_cnt;
+		val32[2] = 0;
+		val32[3] = 0;
+		_db_key_put(&buf, val32, sizeof(val32));
+		db_list_foreach(s_iter, db->syscalls) {
+			val32[0] = s_iter->num;
+			val32[1] = s_iter->priority;
+			val32[2] = s_iter->valid;
+			_db_key_put(&buf, val32, sizeof(val32));
+		}
+
+		r_iter = db->rules;
+		while (r_iter != NULL) {
+			val32[0] = r_iter->action;
+			val32[1] = r_iter->syscall;
+			val32[2] = r_iter->strict;
+			val32[3] = 0;
+			for (a_iter = 0; a_iter < ARG_COUNT_MAX; a_iter++)
+				if (r_iter->args[a_iter].valid)
+					val32[3] |= 1 << a_iter;
+			_db_key_put(&buf, val32, sizeof(val32));
+			for (a_iter = 0; a_iter < ARG_COUNT_MAX; a_iter++) {
+				arg = &r_iter->args[a_iter];
+				if (!arg->valid)
+					continue;
+				val32[0] = arg->arg;
+				val32[1] = arg->op;
+				_db_key_put(&buf, val32, sizeof(val32[0]) * 2);
+				val64[0] = arg->mask;
+				val64[1] = arg->datum;
+				_db_key_put(&buf, val64, sizeof(val64));
+			}
+
+			r_iter = r_iter->next;
+			if (r_iter == db->rules)
+				r_iter = NULL;
+		}
+	}
+
+	/* mark the end of the filters */
+	val32[0] = 0;
+	_db_key_put(&buf, val32, sizeof(val32[0]));
+
+	if (buf.rc < 0) {
+		if (buf.data != NULL)
+			free(buf.data);
+		return buf.rc;
+	}
+	col->key = buf.data;
+	col->key_len = buf.len;
+
+key_return:
+	*key = col->key;
+	*key_len = col->key_len;
+	return 0;
+}
+
+/**
+ * Count the rules and syscall priorities of a filter DB
+ * @param db the seccomp filter DB
+ * @param rule_cnt the number of rules
+ * @param pri_cnt the number of syscalls with a priority
+ *
+ * This is a helper function for db_col_export().
+ *
+ */
+static void _db_blob_count(const struct db_filter *db,
+			   uint32_t *rule_cnt, uint32_t *pri_cnt)
+{
+	struct db_sys_list *s_iter;
+	struct db_api_rule_list *r_iter;
+
+	*rule_cnt = 0;
+	*pri_cnt = 0;
+	db_list_foreach(s_iter, db->syscalls) {
+		if (s_iter->priority & _DB_PRI_MASK_USER)
+			(*pri_cnt)++;
+	}
+	r_iter = db->rules;
+	while (r_iter != NULL) {
+		(*rule_cnt)++;
+		r_iter = r_iter->next;
+		if (r_iter == db->rules)
+			r_iter = NULL;
+	}
+}
+
+/**
+ * Export a filter collection in a binary format
+ * @param col the seccomp filter collection
+ * @param buf the destination buffer, or NULL
+ * @param len the size of the destination buffer
+ *
+ * This function writes the attributes, the architectures and, for each
+ * architecture, the rules in the order they were added and the syscall
+ * priorities of the filter collection to the given buffer; db_col_import() can
+ * rebuild the collection from the buffer.  On return @len is set to the size
+ * of the exported collection, if @buf is NULL only the size is returned.
+ * Returns zero on success, -ERANGE if the buffer is too small, negative values
+ * on other failures.
+ *
+ */
+int db_col_export(const struct db_filter_col *col, void *buf, size_t *len)
+{
+	int rc;
+	unsigned int iter, a_iter;
+	uint32_t attr, value;
+	uint32_t rule_cnt, pri_cnt;
+	size_t size;
+	uint8_t *pos;
+	struct db_blob_hdr hdr;
+	struct db_blob_attr b_attr;
+	struct db_blob_filter b_filter;
+	struct db_blob_rule b_rule;
+	struct db_blob_pri b_pri;
+	const struct db_filter *db;
+	const struct db_sys_list *s_iter;
+	const struct db_api_rule_list *r_iter;
+	const struct db_api_arg *arg;
+
+	/* size the blob before writing anything */
+	size = sizeof(hdr);
+	size += sizeof(b_attr) * (_SCMP_FLTATR_MAX - SCMP_FLTATR_ACT_BADARCH);
+	for (iter = 0; iter < col->filter_cnt; iter++) {
+		_db_blob_count(col->filters[iter], &rule_cnt, &pri_cnt);
+		size += sizeof(b_filter);
+		size += sizeof(b_rule) * rule_cnt;
+		size += sizeof(b_pri) * pri_cnt;
+	}
+	if (buf == NULL) {
+		*len = size;
+		return 0;
+	}
+	if (size > *len) {
+		*len = size;
+		return -ERANGE;
+	}
+	*len = size;
+	pos = buf;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = _DB_BLOB_MAGIC;
+	hdr.version = _DB_BLOB_VERSION;
+	hdr.len = size;
+	hdr.act_default = col->attr.act_default;
+	hdr.attr_cnt = _SCMP_FLTATR_MAX - SCMP_FLTATR_ACT_BADARCH;
+	hdr.filter_cnt = col->filter_cnt;
+	memcpy(pos, &hdr, sizeof(hdr));
+	pos += sizeof(hdr);
+
+	for (attr = SCMP_FLTATR_ACT_BADARCH; attr < _SCMP_FLTATR_MAX; attr++) {
+		rc = db_col_attr_get(col, attr, &value);
+		if (rc < 0)
+			return rc;
+		b_attr.attr = attr;
+		b_attr.value = value;
+		memcpy(pos, &b_attr, sizeof(b_attr));
+		pos += sizeof(b_attr);
+	}
+
+	for (iter = 0; iter < col->filter_cnt; iter++) {
+		db = col->filters[iter];
+
+		memset(&b_filter, 0, sizeof(b_filter));
+		b_filter.arch = db->arch->token;
+		_db_blob_count(db, &b_filter.rule_cnt, &b_filter.pri_cnt);
+		memcpy(pos, &b_filter, sizeof(b_filter));
+		pos += sizeof(b_filter);
+
+		r_iter = db->rules;
+		while (r_iter != NULL) {
+			memset(&b_rule, 0, sizeof(b_rule));
+			b_rule.action = r_iter->action;
+			b_rule.syscall = r_iter->syscall;
+			b_rule.strict = r_iter->strict;
+			for (a_iter = 0; a_iter < ARG_COUNT_MAX; a_iter++) {
+				arg = &r_iter->args[a_iter];
+				if (!arg->valid)
+					continue;
+				b_rule.arg_valid |= 1 << a_iter;
+				b_rule.args[a_iter].arg = arg->arg;
+				b_rule.args[a_iter].op = arg->op;
+				b_rule.args[a_iter].mask = arg->mask;
+				b_rule.args[a_iter].datum = arg->datum;
+			}
+			memcpy(pos, &b_rule, sizeof(b_rule));
+			pos += sizeof(b_rule);
+
+			r_iter = r_iter->next;
+			if (r_iter == db->rules)
+				r_iter = NULL;
+		}
+
+		db_list_foreach(s_iter, db->syscalls) {
+			if (!(s_iter->priority & _DB_PRI_MASK_USER))
+				continue;
+			b_pri.syscall = s_iter->num;
+			b_pri.priority = (s_iter->priority &
+					  _DB_PRI_MASK_USER) >> 16;
+			memcpy(pos, &b_pri, sizeof(b_pri));
+			pos += sizeof(b_pri);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Check the layout of an exported filter collection
+ * @param buf the exported filter collection
+ * @param len the size of the exported filter collection
+ *
+ * This is a helper function for db_col_import(), it checks that the header and
+ * the record counts describe a blob of exactly @len bytes so the records can be
+ * read in place.  Returns zero on success, negative values on failure.
+ *
+ */
+static int _db_blob_check(const uint8_t *buf, size_t len)
+{
+	unsigned int iter;
+	uint64_t off;
+	const struct db_blob_hdr *hdr;
+	const struct db_blob_filter *b_filter;
+
+	if (len < sizeof(*hdr) || ((uintptr_t)buf % sizeof(uint64_t)) != 0)
+		return -EINVAL;
+	hdr = (const struct db_blob_hdr *)buf;
+	if (hdr->magic != _DB_BLOB_MAGIC || hdr->version != _DB_BLOB_VERSION ||
+	    hdr->len != len)
+		return -EINVAL;
+
+	off = sizeof(*hdr);
+	off += (uint64_t)hdr->attr_cnt * sizeof(struct db_blob_attr);
+	for (iter = 0; iter < hdr->filter_cnt; iter++) {
+		if (off + sizeof(*b_filter) > len)
+			return -EINVAL;
+		b_filter = (const struct db_blob_filter *)(buf + off);
+		off += sizeof(*b_filter);
+		off += (uint64_t)b_filter->rule_cnt *
+		       sizeof(struct db_blob_rule);
+		off += (uint64_t)b_filter->pri_cnt *
+		       sizeof(struct db_blob_pri);
+	}
+	if (off != len)
+		return -EINVAL;
+
+	return 0;
+}
+
+/**
+ * Rebuild the filter DB of an exported filter collection
+ * @param col the seccomp filter collection
+ * @param b_filter the exported filter DB
+ *
+ * This is a helper function for db_col_import(), it creates a filter DB from
+ * the exported rules and syscall priorities and adds it to the filter
+ * collection.  Returns zero on success, negative values on failure.
+ *
+ */
+static int _db_blob_filter_import(struct db_filter_col *col,
+				  const struct db_blob_filter *b_filter)
+{
+	int rc = 0;
+	unsigned int iter, a_iter;
+	const struct arch_def *arch;
+	const struct db_blob_rule *b_rule;
+	const struct db_blob_pri *b_pri;
+	struct db_api_arg chain[ARG_COUNT_MAX];
+	struct db_api_rule_list *rule;
+	struct db_filter *db;
+
+	arch = arch_def_lookup(b_filter->arch);
+	if (arch == NULL)
+		return -EINVAL;
+	db = _db_init(arch);
+	if (db == NULL)
+		return -ENOMEM;
+
+	b_rule = (const struct db_blob_rule *)(b_filter + 1);
+	for (iter = 0; iter < b_filter->rule_cnt; iter++, b_rule++) {
+		rc = db_col_action_valid(col, b_rule->action);
+		if (rc < 0)
+			goto import_failure;
+		if (b_rule->arg_valid >= (1 << ARG_COUNT_MAX)) {
+			rc = -EINVAL;
+			goto import_failure;
+		}
+
+		memset(chain, 0, sizeof(chain));
+		for (a_iter = 0; a_iter < ARG_COUNT_MAX; a_iter++) {
+			if (!(b_rule->arg_valid & (1 << a_iter)))
+				continue;
+			if (b_rule->args[a_iter].arg != a_iter ||
+			    b_rule->args[a_iter].op <= _SCMP_CMP_MIN ||
+			    b_rule->args[a_iter].op >= _SCMP_CMP_MAX) {
+				rc = -EINVAL;
+				goto import_failure;
+			}
+			chain[a_iter].valid = true;
+			chain[a_iter].arg = a_iter;
+			chain[a_iter].op = b_rule->args[a_iter].op;
+			chain[a_iter].mask = b_rule->args[a_iter].mask;
+			chain[a_iter].datum = b_rule->args[a_iter].datum;
+		}
+
+		rule = _db_rule_new(b_rule->strict != 0, b_rule->action,
+				    b_rule->syscall, chain);
+		if (rule == NULL) {
+			rc = -ENOMEM;
+			goto import_failure;
+		}
+		rc = _db_col_rule_add(db, rule);
+		if (rc < 0) {
+			free(rule);
+			goto import_failure;
+		}
+		if (b_rule->action == SCMP_ACT_NOTIFY)
+			col->notify_used = true;
+	}
+
+	b_pri = (const struct db_blob_pri *)b_rule;
+	for (iter = 0; iter < b_filter->pri_cnt; iter++, b_pri++) {
+		if (b_pri->priority > UINT8_MAX) {
+			rc = -EINVAL;
+			goto import_failure;
+		}
+		rc = _db_syscall_priority(db, b_pri->syscall, b_pri->priority);
+		if (rc < 0)
+			goto import_failure;
+	}
+
+	rc = db_col_db_add(col, db);
+	if (rc < 0)
+		goto import_failure;
+
+	return 0;
+
+import_failure:
+	_db_release(db);
+	return rc;
+}
+
+/**
+ * Import a filter collection from a binary format
+ * @param buf the exported filter collection
+ * @param len the size of the exported filter collection
+ * @param col the new seccomp filter collection
+ *
+ * This function creates a new filter collection from the output of
+ * db_col_export().  The buffer must be aligned to eight bytes, the records are
+ * read in place.  Returns zero on success, negative values on failure.
+ *
+ */
+int db_col_import(const void *buf, size_t len, struct db_filter_col **col)
+{
+	int rc;
+	unsigned int iter;
+	uint32_t value;
+	const uint8_t *pos = buf;
+	const struct db_blob_hdr *hdr;
+	const struct db_blob_attr *b_attr;
+	const struct db_blob_filter *b_filter;
+	struct db_filter_col *col_new;
+
+	rc = _db_blob_check(buf, len);
+	if (rc < 0)
+		return rc;
+	hdr = (const struct db_blob_hdr *)pos;
+	pos += sizeof(*hdr);
+
+	if (db_col_action_valid(NULL, hdr->act_default) < 0)
+		return -EINVAL;
+	col_new = db_col_init(hdr->act_default);
+	if (col_new == NULL)
+		return -ENOMEM;
+	/* start without any architectures */
+	rc = db_col_db_remove(col_new, arch_def_native->token);
+	if (rc < 0)
+		goto import_failure;
+
+	/* the attributes must be in place before the rules are checked */
+	b_attr = (const struct db_blob_attr *)pos;
+	for (iter = 0; iter < hdr->attr_cnt; iter++, b_attr++) {
+		if (b_attr->attr == SCMP_FLTATR_ACT_DEFAULT) {
+			rc = -EINVAL;
+			goto import_failure;
+		}
+		rc = db_col_attr_get(col_new, b_attr->attr, &value);
+		if (rc < 0)
+			goto import_failure;
+		/* only set what differs, some attributes depend on the
+		 * kernel even when they are disabled */
+		if (value == b_attr->value)
+			continue;
+		rc = db_col_attr_set(col_new, b_attr->attr, b_attr->value);
+		if (rc < 0)
+			goto import_failure;
+	}
+	pos = (const uint8_t *)b_attr;
+
+	for (iter = 0; iter < hdr->filter_cnt; iter++) {
+		b_filter = (const struct db_blob_filter *)pos;
+		rc = _db_blob_filter_import(col_new, b_filter);
+		if (rc < 0)
+			goto import_failure;
+		pos += sizeof(*b_filter);
+		pos += b_filter->rule_cnt * sizeof(struct db_blob_rule);
+		pos += b_filter->pri_cnt * sizeof(struct db_blob_pri);
+	}
+
+	*col = col_new;
+	return 0;
+
+import_failure:
+	db_col_release(col_new);
+	return rc;
+}
+
+/**
+ * Get a filter statistic
+ * @param col the seccomp filter collection
+ * @param stat the filter statistic
+ * @param value the filter statistic value
+ *
+ * Get the requested filter statistic and provide it via @value.  Returns zero
+ * on success, negative values on failure.
+ *
+ */
+int db_col_stat_get(const struct db_filter_col *col,
+		    enum scmp_filter_stat stat, uint64_t *value)
+{
+	int rc = 0;
+
+	switch (stat) {
+	case SCMP_FLTSTAT_PEEPHOLE:
+		*value = col->stats.peephole;
+		break;
+	case SCMP_FLTSTAT_TRAMPOLINES:
+		*value = col->stats.trampolines;
+		break;
+	case SCMP_FLTSTAT_FILTERS:
+		*value = col->stats.filters;
+		break;
+	case SCMP_FLTSTAT_CACHE_HITS:
+		*value = col->stats.cache_hits;
+		break;
+	case SCMP_FLTSTAT_CACHE_MISSES:
+		*value = col->stats.cache_misses;
+		break;
+	default:
+		rc = -EEXIST;
+		break;
+	}
+
+	return rc;
+}
+
+/**
+ * Add a new architecture filter to a filter collection
+ * @param col the seccomp filter collection
+ * @param arch the architecture
+ *
+ * This function adds a new architecture filter DB to an existing seccomp
+ * filter collection assuming there isn't a filter DB already present with the
+ * same architecture.  Returns zero on success, negative values on failure.
+ *
+ */
+int db_col_db_new(struct db_filter_col *col, const struct arch_def *arch)
+{
+	int rc;
+	struct db_filter *db;
+
+	db = _db_init(arch);
+	if (db == NULL)
+		return -ENOMEM;
+	rc = db_col_db_add(col, db);
+	if (rc < 0)
+		_db_release(db);
+
+	return rc;
+}
+
+/**
+ * Add a new filter DB to a filter collection
+ * @param col the seccomp filter collection
+ * @param db the seccomp filter DB
+ *
+ * This function adds an existing seccomp filter DB to an existing seccomp
+ * filter collection assuming there isn't a filter DB already present with the
+ * same architecture.  Returns zero on success, negative values on failure.
+ *
+ */
+int db_col_db_add(struct db_filter_col *col, struct db_filter *db)
+{
+	struct db_filter **dbs;
 
 	if (col->endian != 0 && col->endian != db->arch->endian)
 		return -EDOM;
@@ -1448,6 +2490,7 @@ int db_col_db_add(struct db_filter_col *col, struct db_filter *db)
 	col->filters[col->filter_cnt - 1] = db;
 	if (col->endian == 0)
 		col->endian = db->arch->endian;
+	_db_col_key_reset(col);
 
 	return 0;
 }
@@ -1479,6 +2522,7 @@ int db_col_db_remove(struct db_filter_col *col, uint32_t arch_token)
 		}
 	}
 	col->filters[--col->filter_cnt] = NULL;
+	_db_col_key_reset(col);
 
 	if (col->filter_cnt > 0) {
 		/* NOTE: if we can't do the realloc it isn't fatal, we just
@@ -2017,7 +3061,8 @@ gen_32_failure:
 int db_rule_add(struct db_filter *db, const struct db_api_rule_list *rule)
 {
 	int rc = -ENOMEM;
-	struct db_sys_list *s_new, *s_iter, *s_prev = NULL;
+	unsigned int pos;
+	struct db_sys_list *s_new, *s_iter;
 	struct db_iter_state state;
 	bool rm_flag = false;
 
@@ -2036,22 +3081,26 @@ int db_rule_add(struct db_filter *db, const struct db_api_rule_list *rule)
 		return -ENOMEM;
 
 	/* find a matching syscall/chain or insert a new one */
-	s_iter = db->syscalls;
-	while (s_iter != NULL && s_iter->num < rule->syscall) {
-		s_prev = s_iter;
-		s_iter = s_iter->next;
-	}
+	s_iter = _db_sys_find(db, rule->syscall, &pos);
 	s_new->priority = _DB_PRI_MASK_CHAIN - s_new->node_cnt;
+
+	/* record the change so the transaction can roll it back if needed */
+	if (s_iter == NULL) {
+		rc = _db_sys_reserve(db);
+		if (rc == 0)
+			rc = _db_sys_snap_add(db, s_new);
+	} else
+		rc = _db_sys_snap_save(db, s_iter);
+	if (rc < 0) {
+		_db_tree_put(&s_new->chains);
+		free(s_new);
+		return rc;
+	}
+
 add_reset:
-	if (s_iter == NULL || s_iter->num != rule->syscall) {
-		/* new syscall, add before s_iter */
-		if (s_prev != NULL) {
-			s_new->next = s_prev->next;
-			s_prev->next = s_new;
-		} else {
-			s_new->next = db->syscalls;
-			db->syscalls = s_new;
-		}
+	if (s_iter == NULL) {
+		/* new syscall */
+		_db_sys_insert(db, s_new, pos);
 		return 0;
 	} else if (s_iter->chains == NULL) {
 		if (rm_flag || !s_iter->valid) {
@@ -2157,6 +3206,7 @@ int db_col_syscall_priority(struct db_filter_col *col,
 	int sc_tmp;
 	struct db_filter *filter;
 
+	_db_col_key_reset(col);
 	for (iter = 0; iter < col->filter_cnt; iter++) {
 		filter = col->filters[iter];
 		sc_tmp = syscall;
@@ -2190,6 +3240,176 @@ priority_failure:
 	return rc;
 }
 
+/**
+ * Compare two syscall frequency profile entries
+ * @param a the first entry
+ * @param b the second entry
+ *
+ * This is a qsort() helper which sorts the profile entries by decreasing
+ * frequency, ties are broken by the syscall number.
+ *
+ */
+static int _db_sys_freq_cmp(const void *a, const void *b)
+{
+	const struct db_sys_freq *f_a = a;
+	const struct db_sys_freq *f_b = b;
+
+	if (f_a->count > f_b->count)
+		return -1;
+	if (f_a->count < f_b->count)
+		return 1;
+	return (f_a->num > f_b->num) - (f_a->num < f_b->num);
+}
+
+/**
+ * Parse a syscall frequency profile
+ * @param buf the profile text
+ * @param freq the profile entries
+ * @param freq_cnt the number of profile entries
+ *
+ * Parse the NUL terminated profile text, e.g. the output of
+ * "scmp_app_inspector -f".  Each line starting with a syscall count is an
+ * entry and must be followed by a syscall name or number, any arguments in
+ * parentheses are ignored.  All other lines, such as the report header, blank
+ * lines and comments, are skipped as are syscalls which are unknown on the
+ * native architecture.  The caller is responsible for freeing @freq.  Returns
+ * zero on success, negative values on failure.
+ *
+ */
+static int _db_sys_profile_parse(char *buf,
+				 struct db_sys_freq **freq,
+				 unsigned int *freq_cnt)
+{
+	unsigned int cnt = 0, alloc = 0;
+	int num;
+	uint64_t count;
+	char *line, *line_nxt, *name, *end;
+	struct db_sys_freq *f_new;
+
+	*freq = NULL;
+	*freq_cnt = 0;
+	for (line = buf; line != NULL; line = line_nxt) {
+		line_nxt = strchr(line, '\n');
+		if (line_nxt != NULL)
+			*line_nxt++ = '\0';
+
+		/* only lines starting with a syscall count are entries, this
+		 * skips the report header, blank lines and comments */
+		while (isspace((unsigned char)*line))
+			line++;
+		if (!isdigit((unsigned char)*line))
+			continue;
+
+		/* syscall count */
+		count = strtoull(line, &end, 10);
+		if (!isspace((unsigned char)*end))
+			goto parse_failure;
+
+		/* syscall name or number */
+		name = end;
+		while (isspace((unsigned char)*name))
+			name++;
+		for (end = name;
+		     *end != '\0' && *end != '(' &&
+		     !isspace((unsigned char)*end); end++);
+		*end = '\0';
+		if (*name == '\0')
+			goto parse_failure;
+		num = strtol(name, &end, 10);
+		if (*end != '\0')
+			num = arch_syscall_resolve_name(arch_def_native, name);
+		if (num == __NR_SCMP_ERROR || count == 0)
+			continue;
+
+		if (cnt == alloc) {
+			alloc += 64;
+			f_new = realloc(*freq, sizeof(**freq) * alloc);
+			if (f_new == NULL) {
+				free(*freq);
+				*freq = NULL;
+				return -ENOMEM;
+			}
+			*freq = f_new;
+		}
+		(*freq)[cnt].num = num;
+		(*freq)[cnt].count = count;
+		cnt++;
+	}
+
+	*freq_cnt = cnt;
+	return 0;
+
+parse_failure:
+	free(*freq);
+	*freq = NULL;
+	return -EINVAL;
+}
+
+/**
+ * Set the syscall priorities from a frequency profile
+ * @param col the filter collection
+ * @param fd the file descriptor of the profile
+ *
+ * This function reads a syscall frequency profile from the given file
+ * descriptor and sets the priority of each syscall in the profile such that
+ * the most frequently used syscalls are given the highest priority.  Existing
+ * syscall priorities are only ever raised, see db_col_syscall_priority().
+ * Returns zero on success, negative values on failure.
+ *
+ */
+int db_col_syscall_profile(struct db_filter_col *col, int fd)
+{
+	int rc;
+	ssize_t len;
+	size_t buf_len = 0, buf_alloc = 0;
+	unsigned int iter, freq_cnt;
+	uint8_t priority = 255;
+	char *buf = NULL, *buf_new;
+	struct db_sys_freq *freq;
+
+	/* read the profile */
+	do {
+		if (buf_len + 1 >= buf_alloc) {
+			buf_alloc += 4096;
+			buf_new = realloc(buf, buf_alloc);
+			if (buf_new == NULL) {
+				rc = -ENOMEM;
+				goto profile_return;
+			}
+			buf = buf_new;
+		}
+		len = read(fd, buf + buf_len, buf_alloc - buf_len - 1);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0) {
+			rc = -errno;
+			goto profile_return;
+		}
+		buf_len += len;
+	} while (len > 0);
+	buf[buf_len] = '\0';
+
+	rc = _db_sys_profile_parse(buf, &freq, &freq_cnt);
+	if (rc < 0)
+		goto profile_return;
+
+	/* rank the syscalls by frequency, equal counts share a priority */
+	qsort(freq, freq_cnt, sizeof(*freq), _db_sys_freq_cmp);
+	for (iter = 0; iter < freq_cnt; iter++) {
+		if (iter > 0 && freq[iter].count < freq[iter - 1].count &&
+		    priority > 1)
+			priority--;
+		rc = db_col_syscall_priority(col, freq[iter].num, priority);
+		if (rc < 0)
+			break;
+	}
+	free(freq);
+
+profile_return:
+	free(buf);
+	return rc;
+}
+
 /**
  * Add a new rule to a single filter
  * @param filter the filter
@@ -2229,80 +3449,80 @@ static int _db_col_rule_add(struct db_filter *filter,
 }
 
 /**
- * Add a new rule to the current filter
- * @param col the filter collection
- * @param strict the strict flag
- * @param action the filter action
- * @param syscall the syscall number
+ * Build the argument chain for a new rule
  * @param arg_cnt the number of argument filters in the argument filter chain
  * @param arg_array the argument filter chain, (uint, enum scmp_compare, ulong)
+ * @param chain the argument chain, ARG_COUNT_MAX entries
  *
- * This function adds a new argument/comparison/value to the seccomp filter for
- * a syscall; multiple arguments can be specified and they will be chained
- * together (essentially AND'd together) in the filter.  When the strict flag
- * is true the function will fail if the exact rule can not be added to the
- * filter, if the strict flag is false the function will not fail if the
- * function needs to adjust the rule due to architecture specifics.  Returns
+ * This is a helper function for db_col_rule_add() and similar functions, it
+ * converts the caller's argument comparisons into the argument chain used by
+ * the rest of the filter db.  The chain must be zeroed by the caller.  Returns
  * zero on success, negative values on failure.
  *
  */
-int db_col_rule_add(struct db_filter_col *col,
-		    bool strict, uint32_t action, int syscall,
-		    unsigned int arg_cnt, const struct scmp_arg_cmp *arg_array)
+static int _db_rule_chain(unsigned int arg_cnt,
+			  const struct scmp_arg_cmp *arg_array,
+			  struct db_api_arg *chain)
 {
-	int rc = 0, rc_tmp;
 	unsigned int iter;
 	unsigned int arg_num;
-	size_t chain_size;
-	struct db_api_arg *chain = NULL;
 	struct scmp_arg_cmp arg_data;
-	struct db_api_rule_list *rule;
-	struct db_filter *db;
 
-	/* collect the arguments for the filter rule */
-	chain_size = sizeof(*chain) * ARG_COUNT_MAX;
-	chain = zmalloc(chain_size);
-	if (chain == NULL)
-		return -ENOMEM;
 	for (iter = 0; iter < arg_cnt; iter++) {
 		arg_data = arg_array[iter];
 		arg_num = arg_data.arg;
-		if (arg_num < ARG_COUNT_MAX && chain[arg_num].valid == 0) {
-			chain[arg_num].valid = 1;
-			chain[arg_num].arg = arg_num;
-			chain[arg_num].op = arg_data.op;
-			/* TODO: we should check datum/mask size against the
-			 *	 arch definition, e.g. 64 bit datum on x86 */
-			switch (chain[arg_num].op) {
-			case SCMP_CMP_NE:
-			case SCMP_CMP_LT:
-			case SCMP_CMP_LE:
-			case SCMP_CMP_EQ:
-			case SCMP_CMP_GE:
-			case SCMP_CMP_GT:
-				chain[arg_num].mask = DATUM_MAX;
-				chain[arg_num].datum = arg_data.datum_a;
-				break;
-			case SCMP_CMP_MASKED_EQ:
-				chain[arg_num].mask = arg_data.datum_a;
-				chain[arg_num].datum = arg_data.datum_b;
-				break;
-			default:
-				rc = -EINVAL;
-				goto add_return;
-			}
-		} else {
-			rc = -EINVAL;
-			goto add_return;
+		if (arg_num >= ARG_COUNT_MAX || chain[arg_num].valid != 0)
+			return -EINVAL;
+
+		chain[arg_num].valid = 1;
+		chain[arg_num].arg = arg_num;
+		chain[arg_num].op = arg_data.op;
+		/* TODO: we should check datum/mask size against the
+		 *	 arch definition, e.g. 64 bit datum on x86 */
+		switch (chain[arg_num].op) {
+		case SCMP_CMP_NE:
+		case SCMP_CMP_LT:
+		case SCMP_CMP_LE:
+		case SCMP_CMP_EQ:
+		case SCMP_CMP_GE:
+		case SCMP_CMP_GT:
+			chain[arg_num].mask = DATUM_MAX;
+			chain[arg_num].datum = arg_data.datum_a;
+			break;
+		case SCMP_CMP_MASKED_EQ:
+			chain[arg_num].mask = arg_data.datum_a;
+			chain[arg_num].datum = arg_data.datum_b;
+			break;
+		default:
+			return -EINVAL;
 		}
 	}
 
-	/* create a checkpoint */
-	rc = db_col_transaction_start(col);
-	if (rc != 0)
-		goto add_return;
+	return 0;
+}
+
+/**
+ * Add a new rule to every filter in the collection
+ * @param col the filter collection
+ * @param strict the strict flag
+ * @param action the filter action
+ * @param syscall the syscall number
+ * @param chain the argument chain
+ *
+ * This is a helper function for db_col_rule_add() and similar functions, the
+ * caller is responsible for the transaction around it.  Returns zero on
+ * success, negative values on failure.
+ *
+ */
+static int _db_col_rule_apply(struct db_filter_col *col,
+			      bool strict, uint32_t action, int syscall,
+			      const struct db_api_arg *chain)
+{
+	int rc = 0, rc_tmp;
+	unsigned int iter;
+	struct db_api_rule_list *rule;
+	struct db_filter *db;
 
-	/* add the rule to the different filters in the collection */
 	for (iter = 0; iter < col->filter_cnt; iter++) {
 		db = col->filters[iter];
 
@@ -2310,7 +3530,7 @@ int db_col_rule_add(struct db_filter_col *col,
 		rule = _db_rule_new(strict, action, syscall, chain);
 		if (rule == NULL) {
 			rc_tmp = -ENOMEM;
-			goto add_arch_fail;
+			goto apply_arch_fail;
 		}
 
 		/* add the rule */
@@ -2318,23 +3538,127 @@ int db_col_rule_add(struct db_filter_col *col,
 		if (rc_tmp != 0)
 			free(rule);
 
-add_arch_fail:
+apply_arch_fail:
 		if (rc_tmp != 0 && rc == 0)
 			rc = rc_tmp;
 	}
 
+	return rc;
+}
+
+/**
+ * Add a new rule to the current filter
+ * @param col the filter collection
+ * @param strict the strict flag
+ * @param action the filter action
+ * @param syscall the syscall number
+ * @param arg_cnt the number of argument filters in the argument filter chain
+ * @param arg_array the argument filter chain, (uint, enum scmp_compare, ulong)
+ *
+ * This function adds a new argument/comparison/value to the seccomp filter for
+ * a syscall; multiple arguments can be specified and they will be chained
+ * together (essentially AND'd together) in the filter.  When the strict flag
+ * is true the function will fail if the exact rule can not be added to the
+ * filter, if the strict flag is false the function will not fail if the
+ * function needs to adjust the rule due to architecture specifics.  Returns
+ * zero on success, negative values on failure.
+ *
+ */
+int db_col_rule_add(struct db_filter_col *col,
+		    bool strict, uint32_t action, int syscall,
+		    unsigned int arg_cnt, const struct scmp_arg_cmp *arg_array)
+{
+	int rc;
+	struct db_api_arg chain[ARG_COUNT_MAX];
+
+	/* collect the arguments for the filter rule */
+	memset(chain, 0, sizeof(chain));
+	rc = _db_rule_chain(arg_cnt, arg_array, chain);
+	if (rc != 0)
+		return rc;
+
+	/* create a checkpoint */
+	rc = db_col_transaction_start(col);
+	if (rc != 0)
+		return rc;
+
+	/* add the rule to the different filters in the collection */
+	rc = _db_col_rule_apply(col, strict, action, syscall, chain);
+
 	/* commit the transaction or abort */
 	if (rc == 0)
 		db_col_transaction_commit(col);
 	else
 		db_col_transaction_abort(col);
 
-add_return:
 	/* update the misc state */
 	if (rc == 0 && action == SCMP_ACT_NOTIFY)
 		col->notify_used = true;
-	if (chain != NULL)
-		free(chain);
+	return rc;
+}
+
+/**
+ * Add a set of new rules to the current filter
+ * @param col the filter collection
+ * @param strict the strict flag
+ * @param rules the rules
+ * @param rule_cnt the number of rules
+ *
+ * This function adds all of the given rules to the seccomp filter, in order,
+ * as a single transaction; either every rule is added or the filter is left
+ * unchanged.  The argument chains of all the rules are checked before any of
+ * the filters are changed.  The strict flag has the same meaning as in
+ * db_col_rule_add().  Returns zero on success, negative values on failure.
+ *
+ */
+int db_col_rule_add_bulk(struct db_filter_col *col, bool strict,
+			 const struct scmp_rule *rules, size_t rule_cnt)
+{
+	int rc = 0;
+	size_t iter;
+	bool notify = false;
+	struct db_api_arg *chains;
+
+	if (rule_cnt == 0)
+		return 0;
+	if (rule_cnt > SIZE_MAX / (sizeof(*chains) * ARG_COUNT_MAX))
+		return -EINVAL;
+
+	/* collect the arguments for all of the rules */
+	chains = zmalloc(sizeof(*chains) * ARG_COUNT_MAX * rule_cnt);
+	if (chains == NULL)
+		return -ENOMEM;
+	for (iter = 0; iter < rule_cnt; iter++) {
+		rc = _db_rule_chain(rules[iter].arg_cnt, rules[iter].arg_array,
+				    &chains[iter * ARG_COUNT_MAX]);
+		if (rc != 0)
+			goto bulk_return;
+		if (rules[iter].action == SCMP_ACT_NOTIFY)
+			notify = true;
+	}
+
+	/* create a single checkpoint for all of the rules */
+	rc = db_col_transaction_start(col);
+	if (rc != 0)
+		goto bulk_return;
+
+	for (iter = 0; iter < rule_cnt && rc == 0; iter++)
+		rc = _db_col_rule_apply(col, strict,
+					rules[iter].action, rules[iter].syscall,
+					&chains[iter * ARG_COUNT_MAX]);
+
+	/* commit the transaction or abort */
+	if (rc == 0)
+		db_col_transaction_commit(col);
+	else
+		db_col_transaction_abort(col);
+
+	/* update the misc state */
+	if (rc == 0 && notify)
+		col->notify_used = true;
+
+bulk_return:
+	free(chains);
 	return rc;
 }
 
@@ -2343,73 +3667,43 @@ add_return:
  * @param col the filter collection
  *
  * This function starts a new seccomp filter transaction for the given filter
- * collection.  Returns zero on success, negative values on failure.
+ * collection.  Rather than copying the filters, the transaction records the
+ * end of each filter's rule list and saves each syscall entry just before it
+ * is first changed, so the cost of a transaction depends only on what it
+ * changes.  The set of filters in the collection must not change while the
+ * transaction is open.  Returns zero on success, negative values on failure.
  *
  */
 int db_col_transaction_start(struct db_filter_col *col)
 {
-	int rc;
 	unsigned int iter;
 	struct db_filter_snap *snap;
-	struct db_filter *filter_o, *filter_s;
-	struct db_api_rule_list *rule_o, *rule_s = NULL;
-
-	/* check to see if a shadow snapshot exists */
-	if (col->snapshots && col->snapshots->shadow) {
-		/* we have a shadow!  this will be easy */
-
-		/* NOTE: we don't bother to do any verification of the shadow
-		 *       because we start a new transaction every time we add
-		 *       a new rule to the filter(s); if this ever changes we
-		 *       will need to add a mechanism to verify that the shadow
-		 *       transaction is current/correct */
-
-		col->snapshots->shadow = false;
-		return 0;
-	}
+	struct db_filter *filter;
 
 	/* allocate the snapshot */
 	snap = zmalloc(sizeof(*snap));
 	if (snap == NULL)
 		return -ENOMEM;
-	snap->filters = zmalloc(sizeof(struct db_filter *) * col->filter_cnt);
-	if (snap->filters == NULL) {
-		free(snap);
-		return -ENOMEM;
+	if (col->filter_cnt > 0) {
+		snap->filters = malloc(sizeof(*snap->filters) * col->filter_cnt);
+		snap->rules = malloc(sizeof(*snap->rules) * col->filter_cnt);
+		snap->sys = malloc(sizeof(*snap->sys) * col->filter_cnt);
+		if (snap->filters == NULL || snap->rules == NULL ||
+		    snap->sys == NULL) {
+			_db_snap_release(snap);
+			return -ENOMEM;
+		}
 	}
 	snap->filter_cnt = col->filter_cnt;
-	for (iter = 0; iter < snap->filter_cnt; iter++)
-		snap->filters[iter] = NULL;
-	snap->next = NULL;
 
-	/* create a snapshot of the current filter state */
+	/* mark the current state of each filter */
 	for (iter = 0; iter < col->filter_cnt; iter++) {
-		/* allocate a new filter */
-		filter_o = col->filters[iter];
-		filter_s = _db_init(filter_o->arch);
-		if (filter_s == NULL)
-			goto trans_start_failure;
-		snap->filters[iter] = filter_s;
-
-		/* create a filter snapshot from existing rules */
-		rule_o = filter_o->rules;
-		if (rule_o == NULL)
-			continue;
-		do {
-			/* duplicate the rule */
-			rule_s = db_rule_dup(rule_o);
-			if (rule_s == NULL)
-				goto trans_start_failure;
-
-			/* add the rule */
-			rc = _db_col_rule_add(filter_s, rule_s);
-			if (rc != 0)
-				goto trans_start_failure;
-			rule_s = NULL;
-
-			/* next rule */
-			rule_o = rule_o->next;
-		} while (rule_o != filter_o->rules);
+		filter = col->filters[iter];
+		snap->filters[iter] = filter;
+		snap->rules[iter] = (filter->rules ? filter->rules->prev : NULL);
+		snap->sys[iter] = filter->snap;
+		filter->snap = NULL;
+		filter->snap_id++;
 	}
 
 	/* add the snapshot to the list */
@@ -2417,12 +3711,6 @@ int db_col_transaction_start(struct db_filter_col *col)
 	col->snapshots = snap;
 
 	return 0;
-
-trans_start_failure:
-	if (rule_s != NULL)
-		free(rule_s);
-	_db_snap_release(snap);
-	return -ENOMEM;
 }
 
 /**
@@ -2434,141 +3722,114 @@ trans_start_failure:
  */
 void db_col_transaction_abort(struct db_filter_col *col)
 {
-	int iter;
-	unsigned int filter_cnt;
-	struct db_filter **filters;
+	unsigned int iter;
 	struct db_filter_snap *snap;
+	struct db_filter *filter;
+	struct db_sys_snap *s_iter;
+	struct db_sys_list *sys, *s_next;
+	struct db_api_rule_list *r_last, *r_iter, *r_next;
 
 	if (col->snapshots == NULL)
 		return;
 
-	/* replace the current filter with the last snapshot */
 	snap = col->snapshots;
 	col->snapshots = snap->next;
-	filter_cnt = col->filter_cnt;
-	filters = col->filters;
-	col->filter_cnt = snap->filter_cnt;
-	col->filters = snap->filters;
-	free(snap);
+	for (iter = 0; iter < snap->filter_cnt; iter++) {
+		filter = snap->filters[iter];
+
+		/* undo the syscall changes, newest first */
+		while (filter->snap != NULL) {
+			s_iter = filter->snap;
+			filter->snap = s_iter->next;
+			sys = s_iter->sys;
+			if (s_iter->orig == NULL) {
+				/* added by the transaction, remove it */
+				_db_sys_remove(filter, sys);
+				_db_tree_put(&sys->chains);
+				free(sys);
+			} else {
+				/* changed by the transaction, restore it */
+				s_next = sys->next;
+				_db_tree_put(&sys->chains);
+				memcpy(sys, s_iter->orig, sizeof(*sys));
+				sys->next = s_next;
+				sys->snap_id = s_iter->snap_id;
+				free(s_iter->orig);
+			}
+			free(s_iter);
+		}
+
+		/* drop the rules added by the transaction */
+		r_last = snap->rules[iter];
+		if (filter->rules != NULL &&
+		    (r_last == NULL || r_last->next != filter->rules)) {
+			r_iter = (r_last ? r_last->next : filter->rules);
+			filter->rules->prev->next = NULL;
+			if (r_last != NULL) {
+				r_last->next = filter->rules;
+				filter->rules->prev = r_last;
+			} else
+				filter->rules = NULL;
+			while (r_iter != NULL) {
+				r_next = r_iter->next;
+				free(r_iter);
+				r_iter = r_next;
+			}
+		}
 
-	/* free the filter we swapped out */
-	for (iter = 0; iter < filter_cnt; iter++)
-		_db_release(filters[iter]);
-	free(filters);
+		/* return to the enclosing transaction */
+		filter->snap = snap->sys[iter];
+		snap->sys[iter] = NULL;
+		filter->snap_id--;
+	}
+	_db_snap_release(snap);
 }
 
 /**
  * Commit the top most seccomp filter transaction
  * @param col the filter collection
  *
- * This function commits the most recent seccomp filter transaction and
- * attempts to create a shadow transaction that is a duplicate of the current
- * filter to speed up future transactions.
+ * This function commits the most recent seccomp filter transaction, handing
+ * any saved syscall entries to the enclosing transaction if it hasn't already
+ * saved them.
  *
  */
 void db_col_transaction_commit(struct db_filter_col *col)
 {
-	int rc;
 	unsigned int iter;
 	struct db_filter_snap *snap;
-	struct db_filter *filter_o, *filter_s;
-	struct db_api_rule_list *rule_o, *rule_s;
+	struct db_filter *filter;
+	struct db_sys_snap *s_iter, *s_head, **s_tail;
 
 	snap = col->snapshots;
 	if (snap == NULL)
 		return;
 
-	/* check for a shadow set by a higher transaction commit */
-	if (snap->shadow) {
-		/* leave the shadow intact, but drop the next snapshot */
-		if (snap->next) {
-			snap->next = snap->next->next;
-			_db_snap_release(snap->next);
-		}
-		return;
-	}
-
-	/* adjust the number of filters if needed */
-	if (col->filter_cnt > snap->filter_cnt) {
-		unsigned int tmp_i;
-		struct db_filter **tmp_f;
-
-		/* add filters */
-		tmp_f = realloc(snap->filters,
-				sizeof(struct db_filter *) * col->filter_cnt);
-		if (tmp_f == NULL)
-			goto shadow_err;
-		snap->filters = tmp_f;
-		do {
-			tmp_i = snap->filter_cnt;
-			snap->filters[tmp_i] =
-				_db_init(col->filters[tmp_i]->arch);
-			if (snap->filters[tmp_i] == NULL)
-				goto shadow_err;
-			snap->filter_cnt++;
-		} while (snap->filter_cnt < col->filter_cnt);
-	} else if (col->filter_cnt < snap->filter_cnt) {
-		/* remove filters */
-
-		/* NOTE: while we release the filters we no longer need, we
-		 *       don't bother to resize the filter array, we just
-		 *       adjust the filter counter, this *should* be harmless
-		 *       at the cost of a not reaping all the memory possible */
-
-		do {
-			_db_release(snap->filters[snap->filter_cnt--]);
-		} while (snap->filter_cnt > col->filter_cnt);
-	}
-
-	/* loop through each filter and update the rules on the snapshot */
-	for (iter = 0; iter < col->filter_cnt; iter++) {
-		filter_o = col->filters[iter];
-		filter_s = snap->filters[iter];
-
-		/* skip ahead to the new rule(s) */
-		rule_o = filter_o->rules;
-		rule_s = filter_s->rules;
-		if (rule_o == NULL)
-			/* nothing to shadow */
-			continue;
-		if (rule_s != NULL) {
-			do {
-				rule_o = rule_o->next;
-				rule_s = rule_s->next;
-			} while (rule_s != filter_s->rules);
-
-			/* did we actually add any rules? */
-			if (rule_o == filter_o->rules)
-				/* no, we are done in this case */
-				continue;
-		}
-
-		/* update the old snapshot to make it a shadow */
-		do {
-			/* duplicate the rule */
-			rule_s = db_rule_dup(rule_o);
-			if (rule_s == NULL)
-				goto shadow_err;
-
-			/* add the rule */
-			rc = _db_col_rule_add(filter_s, rule_s);
-			if (rc != 0) {
-				free(rule_s);
-				goto shadow_err;
+	col->snapshots = snap->next;
+	_db_col_key_reset(col);
+	for (iter = 0; iter < snap->filter_cnt; iter++) {
+		filter = snap->filters[iter];
+		filter->snap_id--;
+
+		/* keep the changes the enclosing transaction doesn't know about,
+		 * preserving the order of the changes */
+		s_head = NULL;
+		s_tail = &s_head;
+		while (filter->snap != NULL) {
+			s_iter = filter->snap;
+			filter->snap = s_iter->next;
+			s_iter->sys->snap_id = filter->snap_id;
+			if (s_iter->snap_id == filter->snap_id) {
+				s_iter->next = NULL;
+				_db_sys_snap_free(s_iter);
+			} else {
+				*s_tail = s_iter;
+				s_tail = &s_iter->next;
 			}
-
-			/* next rule */
-			rule_o = rule_o->next;
-		} while (rule_o != filter_o->rules);
+		}
+		*s_tail = snap->sys[iter];
+		filter->snap = s_head;
+		snap->sys[iter] = NULL;
 	}
-
-	/* success, mark the snapshot as a shadow and return */
-	snap->shadow = true;
-	return;
-
-shadow_err:
-	/* we failed making a shadow, cleanup and return */
-	col->snapshots = snap->next;
 	_db_snap_release(snap);
-	return;
 }
@@ -79,9 +79,19 @@ struct db_arg_chain_tree {
 	struct db_arg_chain_tree *nxt_f;
 
 	unsigned int refcnt;
+
+	/* temporary use only by the transaction code */
+	struct db_arg_chain_tree *cpy;
 };
 #define ARG_MASK_MAX		((uint32_t)-1)
 
+/* the priority field is fairly simple - without any user hints, or in the case
+ * of a hint "tie", we give higher priority to syscalls with less chain nodes
+ * (filter is easier to evaluate) */
+#define _DB_PRI_MASK_CHAIN		0x0000FFFF
+#define _DB_PRI_MASK_USER		0x00FF0000
+#define _DB_PRI_USER(x)			(((x) << 16) & _DB_PRI_MASK_USER)
+
 struct db_sys_list {
 	/* native syscall number */
 	unsigned int num;
@@ -99,6 +109,13 @@ struct db_sys_list {
 	struct db_sys_list *next;
 	/* temporary use only by the BPF generator */
 	struct db_sys_list *pri_prv, *pri_nxt;
+	struct db_sys_list *rng_last;
+	bool rng_skip;
+	bool pri_hot;
+	unsigned int split_idx;
+
+	/* the transaction which last saved this entry */
+	unsigned int snap_id;
 
 	bool valid;
 };
@@ -118,6 +135,26 @@ struct db_filter_attr {
 	uint32_t log_enable;
 	/* SPEC_ALLOW related attributes */
 	uint32_t spec_allow;
+	/* BPF generator optimization level */
+	uint32_t optimize;
+	/* BPF peephole optimizations */
+	uint32_t peephole;
+	/* split oversized filters into a filter stack */
+	uint32_t split_enable;
+	/* generate the per-architecture filters in parallel */
+	uint32_t parallel;
+};
+
+struct db_filter_stats {
+	/* BPF instructions removed by the peephole optimizer */
+	uint64_t peephole;
+	/* BPF long jump trampolines added */
+	uint64_t trampolines;
+	/* seccomp filters loaded into the kernel */
+	uint64_t filters;
+	/* BPF programs found in, or missing from, the filter cache */
+	uint64_t cache_hits;
+	uint64_t cache_misses;
 };
 
 struct db_filter {
@@ -126,16 +163,42 @@ struct db_filter {
 
 	/* syscall filters, kept as a sorted single-linked list */
 	struct db_sys_list *syscalls;
+	/* index of the syscall filters, sorted like the list */
+	struct db_sys_list **sys_idx;
+	unsigned int sys_cnt;
+	unsigned int sys_alloc;
 
 	/* list of rules used to build the filters, kept in order */
 	struct db_api_rule_list *rules;
+
+	/* syscall entries changed by the current transaction */
+	struct db_sys_snap *snap;
+	unsigned int snap_id;
+
+	/* argument chain blocks of the last generated filter, see gen_bpf.c */
+	struct bpf_chain_cache *chain_cache;
+};
+
+struct db_sys_snap {
+	/* the changed syscall entry and its state before the change, the
+	 * state is NULL if the entry was added by the transaction */
+	struct db_sys_list *sys;
+	struct db_sys_list *orig;
+	/* the transaction which previously saved the entry */
+	unsigned int snap_id;
+
+	struct db_sys_snap *next;
 };
 
 struct db_filter_snap {
 	/* individual filters */
 	struct db_filter **filters;
 	unsigned int filter_cnt;
-	bool shadow;
+
+	/* the last rule in each filter when the transaction started */
+	struct db_api_rule_list **rules;
+	/* changes saved by the enclosing transaction */
+	struct db_sys_snap **sys;
 
 	struct db_filter_snap *next;
 };
@@ -147,6 +210,9 @@ struct db_filter_col {
 	/* attributes */
 	struct db_filter_attr attr;
 
+	/* statistics from the last BPF generation */
+	struct db_filter_stats stats;
+
 	/* individual filters */
 	int endian;
 	struct db_filter **filters;
@@ -155,6 +221,11 @@ struct db_filter_col {
 	/* transaction snapshots */
 	struct db_filter_snap *snapshots;
 
+	/* canonical key of the collection, NULL until requested and reset on
+	 * every change to the collection */
+	uint8_t *key;
+	size_t key_len;
+
 	/* notification fd that was returned from seccomp() */
 	int notify_fd;
 	bool notify_used;
@@ -191,6 +262,15 @@ int db_col_attr_get(const struct db_filter_col *col,
 int db_col_attr_set(struct db_filter_col *col,
 		    enum scmp_filter_attr attr, uint32_t value);
 
+int db_col_key(struct db_filter_col *col,
+	       const uint8_t **key, size_t *key_len);
+
+int db_col_export(const struct db_filter_col *col, void *buf, size_t *len);
+int db_col_import(const void *buf, size_t len, struct db_filter_col **col);
+
+int db_col_stat_get(const struct db_filter_col *col,
+		    enum scmp_filter_stat stat, uint64_t *value);
+
 int db_col_db_new(struct db_filter_col *col, const struct arch_def *arch);
 int db_col_db_add(struct db_filter_col *col, struct db_filter *db);
 int db_col_db_remove(struct db_filter_col *col, uint32_t arch_token);
@@ -198,9 +278,12 @@ int db_col_db_remove(struct db_filter_col *col, uint32_t arch_token);
 int db_col_rule_add(struct db_filter_col *col,
 		    bool strict, uint32_t action, int syscall,
 		    unsigned int arg_cnt, const struct scmp_arg_cmp *arg_array);
+int db_col_rule_add_bulk(struct db_filter_col *col, bool strict,
+			 const struct scmp_rule *rules, size_t rule_cnt);
 
 int db_col_syscall_priority(struct db_filter_col *col,
 			    int syscall, uint8_t priority);
+int db_col_syscall_profile(struct db_filter_col *col, int fd);
 
 int db_col_transaction_start(struct db_filter_col *col);
 void db_col_transaction_abort(struct db_filter_col *col);
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 #ifndef _BSD_SOURCE
 #define _BSD_SOURCE
@@ -35,6 +36,7 @@
 
 #include "arch.h"
 #include "arch-x32.h"
+#include "cache.h"
 #include "gen_bpf.h"
 #include "db.h"
 #include "hash.h"
@@ -45,6 +47,20 @@
 #define AINC_BLK			2
 #define AINC_PROG			64
 
+/* arena chunk size and allocation alignment */
+#define _BPF_ARENA_CHUNK		(64 * 1024)
+#define _BPF_ARENA_ALIGN		16
+#define _BPF_ARENA_RND(x) \
+	(((x) + _BPF_ARENA_ALIGN - 1) & ~((size_t)_BPF_ARENA_ALIGN - 1))
+
+/* binary tree leaf size, syscalls in a leaf are checked linearly */
+#define _BPF_BINTREE_LEAF		3
+/* number of high priority syscalls checked before the binary tree */
+#define _BPF_BINTREE_HOT		4
+
+/* maximum number of unfiltered syscalls allowed inside a syscall range */
+#define _BPF_RANGE_HOLES_MAX		8
+
 struct acc_state {
 	int32_t offset;
 	uint32_t mask;
@@ -124,15 +140,15 @@ struct bpf_blk {
 
 	/* status flags */
 	bool flag_hash;			/* added to the hash table */
-	bool flag_dup;			/* duplicate block and in use */
-	bool flag_unique;		/* ->blks is unique to this block */
 
 	/* original db_arg_chain_tree node */
 	const struct db_arg_chain_tree *node;
 
+	/* argument chain cache entry which last saved the block */
+	unsigned int chain_id;
+
 	/* used during block assembly */
 	uint64_t hash;
-	struct bpf_blk *hash_nxt;
 	struct bpf_blk *prev, *next;
 	struct bpf_blk *lvl_prv, *lvl_nxt;
 };
@@ -145,12 +161,90 @@ struct bpf_hash_bkt {
 	unsigned int found;
 };
 
-#define _BPF_HASH_BITS			8
-#define _BPF_HASH_SIZE			(1 << _BPF_HASH_BITS)
-#define _BPF_HASH_MASK			(_BPF_HASH_BITS - 1)
+struct bpf_arena {
+	/* next chunk in the arena */
+	struct bpf_arena *next;
+	/* size of the chunk's data and the amount in use */
+	size_t size;
+	size_t used;
+	/* offset of the most recent allocation */
+	size_t last;
+};
+#define _BPF_ARENA_HDR			_BPF_ARENA_RND(sizeof(struct bpf_arena))
+#define _BPF_ARENA_DATA(x)		((unsigned char *)(x) + _BPF_ARENA_HDR)
+
+#define _BPF_HASH_BITS_MIN		8
+#define _BPF_HASH_BITS_MAX		24
+#define _BPF_HASH_SIZE(x)		((unsigned int)1 << (x)->htbl_bits)
+#define _BPF_HASH_BKT(x,y)		((y) & (_BPF_HASH_SIZE(x) - 1))
+
+struct bpf_chain_blk {
+	/* block hash */
+	uint64_t hash;
+	/* accumulator state */
+	struct acc_state acc_start;
+	struct acc_state acc_end;
+	/* number of instructions */
+	unsigned int instr_cnt;
+};
+
+struct bpf_chain_ent {
+	/* next entry in the hash bucket */
+	struct bpf_chain_ent *next;
+
+	/* hash and length, in words, of the chain key */
+	uint32_t key_hash;
+	unsigned int key_len;
+	/* generation which last used the entry */
+	unsigned int gen;
+
+	/* the chain's blocks, in the order they were added to the hash table,
+	 * and the index of the first block of the chain */
+	unsigned int blk_cnt;
+	unsigned int head;
+	struct bpf_chain_blk *blks;
+	/* the instructions of all the blocks */
+	struct bpf_instr *instrs;
+	/* the chain key */
+	uint32_t *key;
+};
+
+#define _BPF_CHAIN_BITS_MIN		6
+#define _BPF_CHAIN_SIZE(x)		((unsigned int)1 << (x)->tbl_bits)
+#define _BPF_CHAIN_BKT(x,y)		((y) & (_BPF_CHAIN_SIZE(x) - 1))
+struct bpf_chain_cache {
+	/* chain hash table, sized as a power of two */
+	struct bpf_chain_ent **tbl;
+	unsigned int tbl_bits;
+	unsigned int ent_cnt;
+	/* current generation */
+	unsigned int gen;
+	/* id of the most recently saved entry */
+	unsigned int ent_id;
+
+	/* key of the chain being generated */
+	uint32_t *key;
+	unsigned int key_len;
+	unsigned int key_alloc;
+	uint32_t key_hash;
+
+	/* blocks added to the hash table by the chain being generated */
+	struct bpf_blk **rec;
+	unsigned int rec_cnt;
+	unsigned int rec_alloc;
+	bool rec_on;
+	bool rec_err;
+};
+
 struct bpf_state {
-	/* block hash table */
-	struct bpf_hash_bkt *htbl[_BPF_HASH_SIZE];
+	/* block hash table, sized as a power of two */
+	struct bpf_hash_bkt **htbl;
+	unsigned int htbl_bits;
+	/* number of entries in the block hash table */
+	unsigned int htbl_cnt;
+
+	/* memory for the instruction blocks and hash entries */
+	struct bpf_arena *arena;
 
 	/* filter attributes */
 	const struct db_filter_attr *attr;
@@ -158,12 +252,65 @@ struct bpf_state {
 	uint64_t bad_arch_hsh;
 	/* default action */
 	uint64_t def_hsh;
+	/* action of the argument chains which don't match */
+	uint32_t act_chain;
+	uint64_t chn_hsh;
 
 	/* target arch - NOTE: be careful, temporary use only! */
 	const struct arch_def *arch;
 
+	/* build the per-architecture filters in parallel */
+	bool parallel;
+	/* argument chain cache of the current architecture, or NULL */
+	struct bpf_chain_cache *chain_cache;
+
+	/* instructions removed by the peephole optimizer */
+	unsigned int peephole_cnt;
+	/* long jump trampolines added */
+	unsigned int tramp_cnt;
+
 	/* bpf program */
 	struct bpf_program *bpf;
+	unsigned int bpf_alloc;
+};
+
+struct bpf_arch_job {
+	/* the filter DBs of the architecture */
+	const struct db_filter *db;
+	const struct db_filter *db_secondary;
+	/* the argument chain cache of the architecture, or NULL */
+	struct bpf_chain_cache *cache;
+
+	/* the BPF state used by the worker thread */
+	struct bpf_state state;
+	pthread_t thread;
+	bool thread_valid;
+
+	/* the architecture's filter, NULL on failure */
+	struct bpf_blk *blk;
+};
+
+struct bpf_blk_pos {
+	/* block hash */
+	uint64_t hash;
+	/* position in the instruction block list */
+	unsigned int pos;
+};
+
+struct bpf_sys_order {
+	/* syscall entry in the filter db */
+	struct db_sys_list *sys;
+	/* position of the syscall in the filter db(s) */
+	unsigned int order;
+};
+
+struct bpf_split_sys {
+	/* syscall entry in the filter db */
+	struct db_sys_list *sys;
+	/* index of the filter db */
+	unsigned int filter;
+	/* true if the syscall must be handled by the first filter */
+	bool first;
 };
 
 /**
@@ -228,37 +375,144 @@ static uint32_t _htot32(const struct arch_def *arch, uint32_t val)
 }
 
 /**
- * Free the BPF instruction block
+ * Convert a 16-bit target integer into the host's endianess
+ * @param arch the architecture definition
+ * @param val the 16-bit integer
+ *
+ * Convert the endianess of the supplied value and return it to the caller.
+ *
+ */
+static uint16_t _ttoh16(const struct arch_def *arch, uint16_t val)
+{
+	if (arch->endian == ARCH_ENDIAN_LITTLE)
+		return le16toh(val);
+	else
+		return be16toh(val);
+}
+
+/**
+ * Convert a 32-bit target integer into the host's endianess
+ * @param arch the architecture definition
+ * @param val the 32-bit integer
+ *
+ * Convert the endianess of the supplied value and return it to the caller.
+ *
+ */
+static uint32_t _ttoh32(const struct arch_def *arch, uint32_t val)
+{
+	if (arch->endian == ARCH_ENDIAN_LITTLE)
+		return le32toh(val);
+	else
+		return be32toh(val);
+}
+
+/**
+ * Allocate memory from the BPF state arena
  * @param state the BPF state
- * @param blk the BPF instruction block
+ * @param size the size of the allocation
+ *
+ * Allocate zeroed memory which stays valid until the BPF state is released;
+ * there is no way to free individual allocations.  Allocations larger than a
+ * quarter of a chunk get a chunk of their own so the remainder of the current
+ * chunk is not wasted.  Returns a pointer to the memory on success, NULL on
+ * failure.
  *
- * Free the BPF instruction block, any linked blocks are preserved and the hash
- * table is not modified.  In general, you probably want to use _blk_free()
- * instead.
+ */
+static void *_arena_alloc(struct bpf_state *state, size_t size)
+{
+	size_t c_size;
+	struct bpf_arena *chunk = state->arena;
+
+	size = _BPF_ARENA_RND(size > 0 ? size : 1);
+	if (chunk == NULL || chunk->used + size > chunk->size) {
+		c_size = (size > _BPF_ARENA_CHUNK / 4 ? size : _BPF_ARENA_CHUNK);
+		chunk = malloc(_BPF_ARENA_HDR + c_size);
+		if (chunk == NULL)
+			return NULL;
+		chunk->size = c_size;
+		chunk->used = 0;
+		chunk->last = 0;
+		if (c_size != _BPF_ARENA_CHUNK && state->arena != NULL) {
+			chunk->next = state->arena->next;
+			state->arena->next = chunk;
+		} else {
+			chunk->next = state->arena;
+			state->arena = chunk;
+		}
+	}
+
+	chunk->last = chunk->used;
+	chunk->used += size;
+	memset(_BPF_ARENA_DATA(chunk) + chunk->last, 0, size);
+	return _BPF_ARENA_DATA(chunk) + chunk->last;
+}
+
+/**
+ * Resize memory allocated from the BPF state arena
+ * @param state the BPF state
+ * @param ptr the existing allocation, or NULL
+ * @param size_old the size of the existing allocation
+ * @param size the new size of the allocation
+ *
+ * Grow an allocation made by _arena_alloc(), in place if it is the most
+ * recent allocation and the chunk has room, otherwise by copying it to a new
+ * allocation.  Returns a pointer to the memory on success, NULL on failure.
+ *
+ */
+static void *_arena_realloc(struct bpf_state *state, void *ptr,
+			    size_t size_old, size_t size)
+{
+	void *new;
+	struct bpf_arena *chunk = state->arena;
+
+	if (ptr == NULL)
+		return _arena_alloc(state, size);
+
+	if (chunk != NULL &&
+	    ptr == _BPF_ARENA_DATA(chunk) + chunk->last &&
+	    chunk->last + _BPF_ARENA_RND(size) <= chunk->size) {
+		if (chunk->last + _BPF_ARENA_RND(size) > chunk->used) {
+			memset(_BPF_ARENA_DATA(chunk) + chunk->used, 0,
+			       chunk->last + _BPF_ARENA_RND(size) -
+			       chunk->used);
+			chunk->used = chunk->last + _BPF_ARENA_RND(size);
+		}
+		return ptr;
+	}
+
+	new = _arena_alloc(state, size);
+	if (new == NULL)
+		return NULL;
+	memcpy(new, ptr, (size_old < size ? size_old : size));
+	return new;
+}
+
+/**
+ * Release the BPF state arena
+ * @param state the BPF state
+ *
+ * Free all of the memory allocated from the BPF state arena.
  *
  */
-static void __blk_free(struct bpf_state *state, struct bpf_blk *blk)
+static void _arena_release(struct bpf_state *state)
 {
-	struct bpf_blk *b_tmp;
+	struct bpf_arena *chunk;
 
-	while (blk->hash_nxt != NULL) {
-		b_tmp = blk->hash_nxt;
-		blk->hash_nxt = b_tmp->hash_nxt;
-		if (!b_tmp->flag_dup)
-			free(b_tmp);
+	while (state->arena != NULL) {
+		chunk = state->arena;
+		state->arena = chunk->next;
+		free(chunk);
 	}
-	if (blk->blks != NULL && blk->flag_unique)
-		free(blk->blks);
-	free(blk);
 }
 
 /**
-* Free the BPF instruction block
+ * Free the BPF instruction block
  * @param state the BPF state
  * @param blk the BPF instruction block
  *
  * Free the BPF instruction block including any linked blocks.  The hash table
- * is updated to reflect the newly removed block(s).
+ * is updated to reflect the newly removed block(s), the memory itself is
+ * returned when the BPF state is released.
  *
  */
 static void _blk_free(struct bpf_state *state, struct bpf_blk *blk)
@@ -301,24 +555,23 @@ static void _blk_free(struct bpf_state *state, struct bpf_blk *blk)
 			break;
 		}
 	}
-	__blk_free(state, blk);
 }
 
 /**
  * Allocate and initialize a new instruction block
+ * @param state the BPF state
  *
  * Allocate a new BPF instruction block and perform some very basic
  * initialization.  Returns a pointer to the block on success, NULL on failure.
  *
  */
-static struct bpf_blk *_blk_alloc(void)
+static struct bpf_blk *_blk_alloc(struct bpf_state *state)
 {
 	struct bpf_blk *blk;
 
-	blk = zmalloc(sizeof(*blk));
+	blk = _arena_alloc(state, sizeof(*blk));
 	if (blk == NULL)
 		return NULL;
-	blk->flag_unique = true;
 	blk->acc_start = _ACC_STATE_UNDEF;
 	blk->acc_end = _ACC_STATE_UNDEF;
 
@@ -332,30 +585,35 @@ static struct bpf_blk *_blk_alloc(void)
  * @param size_add the minimum amount of instructions to add
  *
  * Resize the given instruction block such that it is at least as large as the
- * current size plus @size_add.  Returns a pointer to the block on success,
- * NULL on failure.
+ * current size plus @size_add, doubling the allocation as needed.  Returns a
+ * pointer to the block on success, NULL on failure.
  *
  */
 static struct bpf_blk *_blk_resize(struct bpf_state *state,
 				   struct bpf_blk *blk,
 				   unsigned int size_add)
 {
-	unsigned int size_adj = (AINC_BLK > size_add ? AINC_BLK : size_add);
+	unsigned int alloc;
 	struct bpf_instr *new;
 
 	if (blk == NULL)
 		return NULL;
 
-	if ((blk->blk_cnt + size_adj) <= blk->blk_alloc)
+	if ((blk->blk_cnt + size_add) <= blk->blk_alloc)
 		return blk;
 
-	blk->blk_alloc += size_adj;
-	new = realloc(blk->blks, blk->blk_alloc * sizeof(*(blk->blks)));
+	alloc = (blk->blk_alloc > 0 ? blk->blk_alloc * 2 : AINC_BLK);
+	while (alloc < blk->blk_cnt + size_add)
+		alloc *= 2;
+	new = _arena_realloc(state, blk->blks,
+			     blk->blk_alloc * sizeof(*(blk->blks)),
+			     alloc * sizeof(*(blk->blks)));
 	if (new == NULL) {
 		_blk_free(state, blk);
 		return NULL;
 	}
 	blk->blks = new;
+	blk->blk_alloc = alloc;
 
 	return blk;
 }
@@ -377,7 +635,7 @@ static struct bpf_blk *_blk_append(struct bpf_state *state,
 				   const struct bpf_instr *instr)
 {
 	if (blk == NULL) {
-		blk = _blk_alloc();
+		blk = _blk_alloc(state);
 		if (blk == NULL)
 			return NULL;
 	}
@@ -419,30 +677,45 @@ static struct bpf_blk *_blk_prepend(struct bpf_state *state,
 
 /**
  * Append a block of BPF instructions to the final BPF program
- * @param prg the BPF program
+ * @param state the BPF state
  * @param blk the BPF instruction block
  *
  * Add the BPF instruction block to the end of the BPF program and perform the
- * necssary translation.  Returns zero on success, negative values on failure
- * and in the case of failure the BPF program is free'd.
+ * necssary translation, the program buffer is grown geometrically.  Returns
+ * zero on success, negative values on failure and in the case of failure the
+ * BPF program is free'd.
  *
  */
-static int _bpf_append_blk(struct bpf_program *prg, const struct bpf_blk *blk)
+static int _bpf_append_blk(struct bpf_state *state, const struct bpf_blk *blk)
 {
 	int rc;
+	struct bpf_program *prg = state->bpf;
 	bpf_instr_raw *i_new;
 	bpf_instr_raw *i_iter;
 	unsigned int old_cnt = prg->blk_cnt;
+	unsigned int alloc;
 	unsigned int iter;
 
-	/* (re)allocate the program memory */
-	prg->blk_cnt += blk->blk_cnt;
-	i_new = realloc(prg->blks, BPF_PGM_SIZE(prg));
-	if (i_new == NULL) {
-		rc = -ENOMEM;
+	/* the program length must fit in the sock_fprog length field */
+	if (old_cnt + blk->blk_cnt > UINT16_MAX) {
+		rc = -E2BIG;
 		goto bpf_append_blk_failure;
 	}
-	prg->blks = i_new;
+
+	/* (re)allocate the program memory */
+	if (old_cnt + blk->blk_cnt > state->bpf_alloc) {
+		alloc = (state->bpf_alloc > 0 ? state->bpf_alloc * 2 : AINC_PROG);
+		while (alloc < old_cnt + blk->blk_cnt)
+			alloc *= 2;
+		i_new = realloc(prg->blks, alloc * sizeof(*(prg->blks)));
+		if (i_new == NULL) {
+			rc = -ENOMEM;
+			goto bpf_append_blk_failure;
+		}
+		prg->blks = i_new;
+		state->bpf_alloc = alloc;
+	}
+	prg->blk_cnt += blk->blk_cnt;
 
 	/* transfer and translate the blocks to raw instructions */
 	for (iter = 0; iter < blk->blk_cnt; iter++) {
@@ -491,6 +764,8 @@ static int _bpf_append_blk(struct bpf_program *prg, const struct bpf_blk *blk)
 bpf_append_blk_failure:
 	prg->blk_cnt = 0;
 	free(prg->blks);
+	prg->blks = NULL;
+	state->bpf_alloc = 0;
 	return rc;
 }
 
@@ -521,58 +796,171 @@ static void _program_free(struct bpf_program *prg)
  */
 static void _state_release(struct bpf_state *state)
 {
-	unsigned int bkt;
-	struct bpf_hash_bkt *iter;
-
 	if (state == NULL)
 		return;
 
-	/* release all of the hash table entries */
-	for (bkt = 0; bkt < _BPF_HASH_SIZE; bkt++) {
-		while (state->htbl[bkt]) {
-			iter = state->htbl[bkt];
-			state->htbl[bkt] = iter->next;
-			__blk_free(state, iter->blk);
-			free(iter);
-		}
-	}
+	/* release the hash table, the blocks and entries live in the arena */
+	if (state->htbl != NULL)
+		free(state->htbl);
+	_arena_release(state);
 	_program_free(state->bpf);
 
 	memset(state, 0, sizeof(*state));
 }
 
 /**
- * Add an instruction block to the BPF state hash table
+ * Initialize the BPF state hash table
+ * @param state the BPF state
+ * @param cnt the expected number of entries
+ *
+ * Allocate a hash table large enough to hold @cnt entries without growing.
+ * Returns zero on success, negative values on failure.
+ *
+ */
+static int _hsh_init(struct bpf_state *state, unsigned int cnt)
+{
+	unsigned int bits = _BPF_HASH_BITS_MIN;
+
+	while (bits < _BPF_HASH_BITS_MAX && ((unsigned int)1 << bits) < cnt)
+		bits++;
+
+	state->htbl = zmalloc(sizeof(*state->htbl) << bits);
+	if (state->htbl == NULL)
+		return -ENOMEM;
+	state->htbl_bits = bits;
+	state->htbl_cnt = 0;
+
+	return 0;
+}
+
+/**
+ * Grow the BPF state hash table
+ * @param state the BPF state
+ *
+ * Double the number of buckets in the hash table and rehash the existing
+ * entries.  The table is left untouched if it is already at its maximum size
+ * or if the new buckets can not be allocated, it remains usable either way.
+ *
+ */
+static void _hsh_grow(struct bpf_state *state)
+{
+	unsigned int bkt, bkt_new;
+	unsigned int bits = state->htbl_bits + 1;
+	struct bpf_hash_bkt **htbl;
+	struct bpf_hash_bkt *h_iter;
+
+	if (bits > _BPF_HASH_BITS_MAX)
+		return;
+	htbl = zmalloc(sizeof(*htbl) << bits);
+	if (htbl == NULL)
+		return;
+
+	for (bkt = 0; bkt < _BPF_HASH_SIZE(state); bkt++) {
+		while (state->htbl[bkt] != NULL) {
+			h_iter = state->htbl[bkt];
+			state->htbl[bkt] = h_iter->next;
+			bkt_new = h_iter->blk->hash &
+				  (((unsigned int)1 << bits) - 1);
+			h_iter->next = htbl[bkt_new];
+			htbl[bkt_new] = h_iter;
+		}
+	}
+	free(state->htbl);
+	state->htbl = htbl;
+	state->htbl_bits = bits;
+}
+
+/**
+ * Compare two instruction blocks
+ * @param a the first BPF instruction block
+ * @param b the second BPF instruction block
+ *
+ * Returns true if the two instruction blocks have the same instructions and
+ * accumulator states, false otherwise.
+ *
+ */
+static bool _blk_equal(const struct bpf_blk *a, const struct bpf_blk *b)
+{
+	return (_BLK_MSZE(a) == _BLK_MSZE(b) &&
+		memcmp(a->blks, b->blks, _BLK_MSZE(a)) == 0 &&
+		_ACC_CMP_EQ(a->acc_start, b->acc_start) &&
+		_ACC_CMP_EQ(a->acc_end, b->acc_end));
+}
+
+/**
+ * Reserve space for the blocks of an argument chain
+ * @param cache the argument chain cache
+ * @param cnt the number of blocks
+ *
+ * Grow the list of recorded blocks so that it can hold at least @cnt blocks.
+ * Returns zero on success, negative values on failure.
+ *
+ */
+static int _chain_cache_reserve(struct bpf_chain_cache *cache,
+				unsigned int cnt)
+{
+	unsigned int alloc;
+	struct bpf_blk **rec;
+
+	if (cnt <= cache->rec_alloc)
+		return 0;
+
+	alloc = (cache->rec_alloc > 0 ? cache->rec_alloc * 2 : 64);
+	while (alloc < cnt)
+		alloc *= 2;
+	rec = realloc(cache->rec, alloc * sizeof(*rec));
+	if (rec == NULL)
+		return -ENOMEM;
+	cache->rec = rec;
+	cache->rec_alloc = alloc;
+
+	return 0;
+}
+
+/**
+ * Record a block added to the hash table by an argument chain
+ * @param cache the argument chain cache
+ * @param blk the BPF instruction block
+ *
+ * Add the block to the list of blocks of the argument chain currently being
+ * generated.  If the list can not be grown the chain is marked as not
+ * cacheable, which is not an error.
+ *
+ */
+static void _chain_cache_rec(struct bpf_chain_cache *cache,
+			     struct bpf_blk *blk)
+{
+	if (_chain_cache_reserve(cache, cache->rec_cnt + 1) < 0) {
+		cache->rec_err = true;
+		return;
+	}
+	cache->rec[cache->rec_cnt++] = blk;
+}
+
+/**
+ * Add an instruction block with a known hash to the BPF state hash table
  * @param state the BPF state
  * @param blk_p pointer to the BPF instruction block
  * @param found initial found value (see _hsh_find_once() for description)
+ * @param h_val the hash of the block's contents
  *
  * This function adds an instruction block to the hash table, and frees the
  * block if an identical instruction block already exists, returning a pointer
- * to the original block in place of the given block.  Returns zero on success
- * and negative values on failure.
+ * to the original block in place of the given block.  The block's hash is
+ * @h_val, or @h_val with a non-zero upper word if a different block already
+ * uses @h_val.  Returns zero on success and negative values on failure.
  *
  */
-static int _hsh_add(struct bpf_state *state, struct bpf_blk **blk_p,
-		    unsigned int found)
+static int _hsh_add_hash(struct bpf_state *state, struct bpf_blk **blk_p,
+			 unsigned int found, uint64_t h_val)
 {
-	uint64_t h_val, h_val_tmp[3];
 	struct bpf_hash_bkt *h_new, *h_iter, *h_prev = NULL;
 	struct bpf_blk *blk = *blk_p;
-	struct bpf_blk *b_iter;
 
-	if (blk->flag_hash)
-		return 0;
-
-	h_new = zmalloc(sizeof(*h_new));
+	h_new = _arena_alloc(state, sizeof(*h_new));
 	if (h_new == NULL)
 		return -ENOMEM;
 
-	/* generate the hash */
-	h_val_tmp[0] = hash(blk->blks, _BLK_MSZE(blk));
-	h_val_tmp[1] = hash(&blk->acc_start, sizeof(blk->acc_start));
-	h_val_tmp[2] = hash(&blk->acc_end, sizeof(blk->acc_end));
-	h_val = hash(h_val_tmp, sizeof(h_val_tmp));
 	blk->hash = h_val;
 	blk->flag_hash = true;
 	blk->node = NULL;
@@ -581,51 +969,28 @@ static int _hsh_add(struct bpf_state *state, struct bpf_blk **blk_p,
 
 	/* insert the block into the hash table */
 hsh_add_restart:
-	h_iter = state->htbl[h_val & _BPF_HASH_MASK];
+	h_iter = state->htbl[_BPF_HASH_BKT(state, h_val)];
 	if (h_iter != NULL) {
 		do {
 			if ((h_iter->blk->hash == h_val) &&
-			    (_BLK_MSZE(h_iter->blk) == _BLK_MSZE(blk)) &&
-			    (memcmp(h_iter->blk->blks, blk->blks,
-				    _BLK_MSZE(blk)) == 0) &&
-			    _ACC_CMP_EQ(h_iter->blk->acc_start,
-					blk->acc_start) &&
-			    _ACC_CMP_EQ(h_iter->blk->acc_end,
-					blk->acc_end)) {
-				/* duplicate block */
-				free(h_new);
-
-				/* store the duplicate block */
-				b_iter = h_iter->blk;
-				while (b_iter->hash_nxt != NULL)
-					b_iter = b_iter->hash_nxt;
-				b_iter->hash_nxt = blk;
-
-				/* in some cases we want to return the
-				 * duplicate block */
-				if (found) {
-					blk->flag_dup = true;
+			    _blk_equal(h_iter->blk, blk)) {
+				/* duplicate block, in some cases we want to
+				 * return the duplicate block */
+				if (found)
 					return 0;
-				}
 
 				/* update the priority if needed */
 				if (h_iter->blk->priority < blk->priority)
 					h_iter->blk->priority = blk->priority;
 
-				/* try to save some memory */
-				free(blk->blks);
-				blk->blks = h_iter->blk->blks;
-				blk->flag_unique = false;
-
 				*blk_p = h_iter->blk;
-				return 0;
+				goto hsh_add_done;
 			} else if (h_iter->blk->hash == h_val) {
 				/* hash collision */
 				if ((h_val >> 32) == 0xffffffff) {
 					/* overflow */
 					blk->flag_hash = false;
 					blk->hash = 0;
-					free(h_new);
 					return -EFAULT;
 				}
 				h_val += ((uint64_t)1 << 32);
@@ -641,11 +1006,47 @@ hsh_add_restart:
 		} while (h_iter != NULL);
 		h_prev->next = h_new;
 	} else
-		state->htbl[h_val & _BPF_HASH_MASK] = h_new;
+		state->htbl[_BPF_HASH_BKT(state, h_val)] = h_new;
 
+	/* keep the chains short */
+	if (++state->htbl_cnt > _BPF_HASH_SIZE(state))
+		_hsh_grow(state);
+
+hsh_add_done:
+	if (state->chain_cache != NULL && state->chain_cache->rec_on)
+		_chain_cache_rec(state->chain_cache, *blk_p);
 	return 0;
 }
 
+/**
+ * Add an instruction block to the BPF state hash table
+ * @param state the BPF state
+ * @param blk_p pointer to the BPF instruction block
+ * @param found initial found value (see _hsh_find_once() for description)
+ *
+ * Hash the instruction block and add it to the hash table as described in
+ * _hsh_add_hash().  Blocks which are already in the hash table are left
+ * alone.  Returns zero on success and negative values on failure.
+ *
+ */
+static int _hsh_add(struct bpf_state *state, struct bpf_blk **blk_p,
+		    unsigned int found)
+{
+	uint64_t h_val, h_val_tmp[3];
+	struct bpf_blk *blk = *blk_p;
+
+	if (blk->flag_hash)
+		return 0;
+
+	/* generate the hash */
+	h_val_tmp[0] = hash(blk->blks, _BLK_MSZE(blk));
+	h_val_tmp[1] = hash(&blk->acc_start, sizeof(blk->acc_start));
+	h_val_tmp[2] = hash(&blk->acc_end, sizeof(blk->acc_end));
+	h_val = hash(h_val_tmp, sizeof(h_val_tmp));
+
+	return _hsh_add_hash(state, blk_p, found, h_val);
+}
+
 /**
  * Remove an entry from the hash table
  * @param state the BPF state
@@ -657,7 +1058,7 @@ hsh_add_restart:
  */
 static struct bpf_blk *_hsh_remove(struct bpf_state *state, uint64_t h_val)
 {
-	unsigned int bkt = h_val & _BPF_HASH_MASK;
+	unsigned int bkt = _BPF_HASH_BKT(state, h_val);
 	struct bpf_blk *blk;
 	struct bpf_hash_bkt *h_iter, *h_prev = NULL;
 
@@ -669,7 +1070,7 @@ static struct bpf_blk *_hsh_remove(struct bpf_state *state, uint64_t h_val)
 			else
 				state->htbl[bkt] = h_iter->next;
 			blk = h_iter->blk;
-			free(h_iter);
+			state->htbl_cnt--;
 			return blk;
 		}
 		h_prev = h_iter;
@@ -694,7 +1095,7 @@ static struct bpf_hash_bkt *_hsh_find_bkt(const struct bpf_state *state,
 {
 	struct bpf_hash_bkt *h_iter;
 
-	h_iter = state->htbl[h_val & _BPF_HASH_MASK];
+	h_iter = state->htbl[_BPF_HASH_BKT(state, h_val)];
 	while (h_iter != NULL) {
 		if (h_iter->blk->hash == h_val)
 			return h_iter;
@@ -812,7 +1213,7 @@ static struct bpf_blk *_gen_bpf_node(struct bpf_state *state,
 	struct bpf_blk *blk, *b_act;
 	struct bpf_instr instr;
 
-	blk = _blk_alloc();
+	blk = _blk_alloc(state);
 	if (blk == NULL)
 		return NULL;
 	blk->acc_start = *a_state;
@@ -1144,488 +1545,2507 @@ chain_failure:
 }
 
 /**
- * Generate the BPF instruction blocks for a given syscall
- * @param state the BPF state
- * @param sys the syscall filter DB entry
- * @param nxt_hash the hash value of the next syscall filter DB entry
- * @param acc_reset accumulator reset flag
+ * Reserve space in the argument chain key
+ * @param cache the argument chain cache
+ * @param cnt the number of words
  *
- * Generate the BPF instruction blocks for the given syscall filter and return
- * a pointer to the first block on success; returns NULL on failure.  It is
- * important to note that the block returned has not been added to the hash
- * table, however, any linked/referenced blocks have been added to the hash
- * table.
+ * Grow the key of the argument chain currently being generated so that @cnt
+ * more words can be added.  Returns a pointer to the first of the new words on
+ * success, NULL on failure.
  *
  */
-static struct bpf_blk *_gen_bpf_syscall(struct bpf_state *state,
-					const struct db_sys_list *sys,
-					uint64_t nxt_hash,
-					bool acc_reset)
+static uint32_t *_chain_cache_key_add(struct bpf_chain_cache *cache,
+				      unsigned int cnt)
 {
-	int rc;
-	struct bpf_instr instr;
-	struct bpf_blk *blk_c, *blk_s;
-	struct bpf_jump def_jump;
-	struct acc_state a_state;
-
-	/* we do the memset before the assignment to keep valgrind happy */
-	memset(&def_jump, 0, sizeof(def_jump));
-	def_jump = _BPF_JMP_HSH(state->def_hsh);
-
-	blk_s = _blk_alloc();
-	if (blk_s == NULL)
-		return NULL;
-
-	/* setup the accumulator state */
-	if (acc_reset) {
-		_BPF_INSTR(instr, _BPF_OP(state->arch, BPF_LD + BPF_ABS),
-			   _BPF_JMP_NO, _BPF_JMP_NO,
-			   _BPF_SYSCALL(state->arch));
-		blk_s = _blk_append(state, blk_s, &instr);
-		if (blk_s == NULL)
+	unsigned int alloc;
+	uint32_t *key;
+
+	if (cache->key_len + cnt > cache->key_alloc) {
+		alloc = (cache->key_alloc > 0 ? cache->key_alloc * 2 : 256);
+		while (alloc < cache->key_len + cnt)
+			alloc *= 2;
+		key = realloc(cache->key, alloc * sizeof(*key));
+		if (key == NULL)
 			return NULL;
-		/* we've loaded the syscall ourselves */
-		a_state = _ACC_STATE_OFFSET(_BPF_OFFSET_SYSCALL);
-		blk_s->acc_start = _ACC_STATE_UNDEF;
-		blk_s->acc_end = _ACC_STATE_OFFSET(_BPF_OFFSET_SYSCALL);
-	} else {
-		/* we rely on someone else to load the syscall */
-		a_state = _ACC_STATE_UNDEF;
-		blk_s->acc_start = _ACC_STATE_OFFSET(_BPF_OFFSET_SYSCALL);
-		blk_s->acc_end = _ACC_STATE_OFFSET(_BPF_OFFSET_SYSCALL);
+		cache->key = key;
+		cache->key_alloc = alloc;
 	}
+	key = &cache->key[cache->key_len];
+	cache->key_len += cnt;
 
-	/* generate the argument chains */
-	blk_c = _gen_bpf_chain(state, sys, sys->chains, &def_jump, &a_state);
-	if (blk_c == NULL) {
-		_blk_free(state, blk_s);
-		return NULL;
-	}
+	return key;
+}
 
-	/* syscall check */
-	_BPF_INSTR(instr, _BPF_OP(state->arch, BPF_JMP + BPF_JEQ),
-		   _BPF_JMP_HSH(blk_c->hash), _BPF_JMP_HSH(nxt_hash),
-		   _BPF_K(state->arch, sys->num));
-	blk_s = _blk_append(state, blk_s, &instr);
-	if (blk_s == NULL)
+/**
+ * Add a level of an argument chain to the argument chain key
+ * @param cache the argument chain cache
+ * @param node a node on the level
+ *
+ * Append everything _gen_bpf_chain() uses from the level, and the levels
+ * below it, to the key of the argument chain.  Returns zero on success,
+ * negative values on failure.
+ *
+ */
+static int _chain_cache_key_lvl(struct bpf_chain_cache *cache,
+				const struct db_arg_chain_tree *node)
+{
+	int rc;
+	unsigned int cnt = 0;
+	uint32_t *key;
+	const struct db_arg_chain_tree *c_iter;
+
+	while (node->lvl_prv != NULL)
+		node = node->lvl_prv;
+	for (c_iter = node; c_iter != NULL; c_iter = c_iter->lvl_nxt)
+		cnt++;
+
+	/* the nodes of the level first, then the levels below them */
+	key = _chain_cache_key_add(cache, 1 + cnt * 7);
+	if (key == NULL)
+		return -ENOMEM;
+	*key++ = cnt;
+	for (c_iter = node; c_iter != NULL; c_iter = c_iter->lvl_nxt) {
+		*key++ = c_iter->arg_offset;
+		*key++ = c_iter->op;
+		*key++ = c_iter->mask;
+		*key++ = c_iter->datum;
+		*key++ = (c_iter->act_t_flg ? 1 : 0) |
+			 (c_iter->act_f_flg ? 2 : 0) |
+			 (c_iter->nxt_t != NULL ? 4 : 0) |
+			 (c_iter->nxt_f != NULL ? 8 : 0);
+		*key++ = (c_iter->act_t_flg ? c_iter->act_t : 0);
+		*key++ = (c_iter->act_f_flg ? c_iter->act_f : 0);
+	}
+	for (c_iter = node; c_iter != NULL; c_iter = c_iter->lvl_nxt) {
+		if (c_iter->nxt_t != NULL) {
+			rc = _chain_cache_key_lvl(cache, c_iter->nxt_t);
+			if (rc < 0)
+				return rc;
+		}
+		if (c_iter->nxt_f != NULL) {
+			rc = _chain_cache_key_lvl(cache, c_iter->nxt_f);
+			if (rc < 0)
+				return rc;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Generate the key of an argument chain
+ * @param state the BPF state
+ * @param chain the filter chain
+ * @param nxt_jump the jump to fallthrough to at the end of the chain
+ * @param a_state the accumulator state
+ *
+ * Build the key which identifies the blocks generated by _gen_bpf_chain() for
+ * the given arguments; two chains with the same key generate the same blocks.
+ * Returns zero on success, negative values on failure.
+ *
+ */
+static int _chain_cache_key(const struct bpf_state *state,
+			    const struct db_arg_chain_tree *chain,
+			    const struct bpf_jump *nxt_jump,
+			    const struct acc_state *a_state)
+{
+	int rc;
+	uint32_t *key;
+	struct bpf_chain_cache *cache = state->chain_cache;
+
+	if (nxt_jump->type != TGT_PTR_HSH)
+		return -EINVAL;
+
+	cache->key_len = 0;
+	key = _chain_cache_key_add(cache, 5);
+	if (key == NULL)
+		return -ENOMEM;
+	key[0] = state->arch->endian;
+	key[1] = a_state->offset;
+	key[2] = a_state->mask;
+	key[3] = nxt_jump->tgt.hash;
+	key[4] = nxt_jump->tgt.hash >> 32;
+	rc = _chain_cache_key_lvl(cache, chain);
+	if (rc < 0)
+		return rc;
+	cache->key_hash = hash(cache->key, cache->key_len * sizeof(*cache->key));
+
+	return 0;
+}
+
+/**
+ * Find an argument chain in the argument chain cache
+ * @param cache the argument chain cache
+ *
+ * Find the entry whose key matches the current key of the cache.  Returns a
+ * pointer to the entry on success, NULL if the entry can not be found.
+ *
+ */
+static struct bpf_chain_ent *_chain_cache_find(struct bpf_chain_cache *cache)
+{
+	struct bpf_chain_ent *e_iter;
+
+	e_iter = cache->tbl[_BPF_CHAIN_BKT(cache, cache->key_hash)];
+	while (e_iter != NULL) {
+		if (e_iter->key_hash == cache->key_hash &&
+		    e_iter->key_len == cache->key_len &&
+		    memcmp(e_iter->key, cache->key,
+			   cache->key_len * sizeof(*cache->key)) == 0)
+			return e_iter;
+		e_iter = e_iter->next;
+	}
+
+	return NULL;
+}
+
+/**
+ * Remove an entry from the argument chain cache
+ * @param cache the argument chain cache
+ * @param ent the entry
+ *
+ * Remove the entry from the cache's hash table and free it.
+ *
+ */
+static void _chain_cache_remove(struct bpf_chain_cache *cache,
+				struct bpf_chain_ent *ent)
+{
+	struct bpf_chain_ent **e_iter;
+
+	e_iter = &cache->tbl[_BPF_CHAIN_BKT(cache, ent->key_hash)];
+	while (*e_iter != NULL) {
+		if (*e_iter == ent) {
+			*e_iter = ent->next;
+			cache->ent_cnt--;
+			break;
+		}
+		e_iter = &(*e_iter)->next;
+	}
+	free(ent);
+}
+
+/**
+ * Save the blocks of an argument chain in the argument chain cache
+ * @param cache the argument chain cache
+ * @param blk the first block of the chain
+ *
+ * Copy the blocks recorded while generating the argument chain into a new
+ * cache entry for the current key, replacing any existing entry.  The cache
+ * is left untouched if there is not enough memory.
+ *
+ */
+static void _chain_cache_store(struct bpf_chain_cache *cache,
+			       const struct bpf_blk *blk)
+{
+	unsigned int iter, bkt, bits, blk_cnt = 0, instr_cnt = 0;
+	size_t size;
+	struct bpf_chain_ent *ent, *e_iter, **tbl;
+	struct bpf_chain_blk *c_iter;
+	struct bpf_instr *i_iter;
+	struct bpf_blk *b_iter;
+
+	/* blocks which were added more than once only need to be saved once,
+	 * adding them again has no effect */
+	cache->ent_id++;
+	for (iter = 0; iter < cache->rec_cnt; iter++) {
+		b_iter = cache->rec[iter];
+		if (b_iter->chain_id == cache->ent_id)
+			continue;
+		b_iter->chain_id = cache->ent_id;
+		blk_cnt++;
+		instr_cnt += b_iter->blk_cnt;
+	}
+
+	size = sizeof(*ent) +
+	       blk_cnt * sizeof(*ent->blks) +
+	       instr_cnt * sizeof(*ent->instrs) +
+	       cache->key_len * sizeof(*ent->key);
+	ent = malloc(size);
+	if (ent == NULL)
+		return;
+	ent->blks = (struct bpf_chain_blk *)&ent[1];
+	ent->instrs = (struct bpf_instr *)&ent->blks[blk_cnt];
+	ent->key = (uint32_t *)&ent->instrs[instr_cnt];
+	ent->key_hash = cache->key_hash;
+	ent->key_len = cache->key_len;
+	memcpy(ent->key, cache->key, cache->key_len * sizeof(*ent->key));
+	ent->gen = cache->gen;
+	ent->blk_cnt = 0;
+	ent->head = blk_cnt;
+
+	i_iter = ent->instrs;
+	for (iter = 0; iter < cache->rec_cnt; iter++) {
+		b_iter = cache->rec[iter];
+		if (b_iter->chain_id != cache->ent_id)
+			continue;
+		b_iter->chain_id = 0;
+		if (b_iter == blk)
+			ent->head = ent->blk_cnt;
+		c_iter = &ent->blks[ent->blk_cnt++];
+		c_iter->hash = b_iter->hash;
+		c_iter->acc_start = b_iter->acc_start;
+		c_iter->acc_end = b_iter->acc_end;
+		c_iter->instr_cnt = b_iter->blk_cnt;
+		memcpy(i_iter, b_iter->blks, _BLK_MSZE(b_iter));
+		i_iter += b_iter->blk_cnt;
+	}
+	if (ent->head == ent->blk_cnt) {
+		/* the first block must be one of the recorded blocks */
+		free(ent);
+		return;
+	}
+
+	e_iter = _chain_cache_find(cache);
+	if (e_iter != NULL)
+		_chain_cache_remove(cache, e_iter);
+	bkt = _BPF_CHAIN_BKT(cache, ent->key_hash);
+	ent->next = cache->tbl[bkt];
+	cache->tbl[bkt] = ent;
+
+	/* keep the buckets short */
+	if (++cache->ent_cnt <= _BPF_CHAIN_SIZE(cache))
+		return;
+	bits = cache->tbl_bits + 1;
+	tbl = zmalloc(sizeof(*tbl) << bits);
+	if (tbl == NULL)
+		return;
+	for (bkt = 0; bkt < _BPF_CHAIN_SIZE(cache); bkt++) {
+		while (cache->tbl[bkt] != NULL) {
+			e_iter = cache->tbl[bkt];
+			cache->tbl[bkt] = e_iter->next;
+			iter = e_iter->key_hash & (((unsigned int)1 << bits) - 1);
+			e_iter->next = tbl[iter];
+			tbl[iter] = e_iter;
+		}
+	}
+	free(cache->tbl);
+	cache->tbl = tbl;
+	cache->tbl_bits = bits;
+}
+
+/**
+ * Add the cached blocks of an argument chain to the BPF state
+ * @param state the BPF state
+ * @param ent the argument chain cache entry
+ *
+ * Copy the cached blocks into the BPF state and add them to the hash table in
+ * the order _gen_bpf_chain() added them.  The blocks are only used if each of
+ * them ends up with the same hash as when it was generated, in which case the
+ * result is identical to generating the chain again; otherwise the blocks are
+ * removed from the hash table.  Returns a pointer to the first block of the
+ * chain on success, NULL on failure.
+ *
+ */
+static struct bpf_blk *_chain_cache_replay(struct bpf_state *state,
+					   const struct bpf_chain_ent *ent)
+{
+	unsigned int iter;
+	struct bpf_chain_cache *cache = state->chain_cache;
+	const struct bpf_chain_blk *c_iter;
+	const struct bpf_instr *i_iter = ent->instrs;
+	struct bpf_blk *blk, *b_new, *b_head = NULL;
+
+	/* make sure we can track the new blocks */
+	cache->rec_cnt = 0;
+	if (_chain_cache_reserve(cache, ent->blk_cnt) < 0)
+		return NULL;
+
+	for (iter = 0; iter < ent->blk_cnt; iter++) {
+		c_iter = &ent->blks[iter];
+		blk = _blk_alloc(state);
+		if (blk == NULL)
+			goto replay_failure;
+		blk->blks = _arena_alloc(state,
+					 c_iter->instr_cnt * sizeof(*i_iter));
+		if (blk->blks == NULL)
+			goto replay_failure;
+		memcpy(blk->blks, i_iter, c_iter->instr_cnt * sizeof(*i_iter));
+		i_iter += c_iter->instr_cnt;
+		blk->blk_cnt = c_iter->instr_cnt;
+		blk->blk_alloc = c_iter->instr_cnt;
+		blk->acc_start = c_iter->acc_start;
+		blk->acc_end = c_iter->acc_end;
+
+		/* the upper word of the hash is only used for collisions */
+		b_new = blk;
+		if (_hsh_add_hash(state, &b_new, 0,
+				  c_iter->hash & 0xffffffff) < 0)
+			goto replay_failure;
+		if (b_new == blk)
+			cache->rec[cache->rec_cnt++] = blk;
+		if (b_new->hash != c_iter->hash)
+			goto replay_failure;
+		if (iter == ent->head)
+			b_head = b_new;
+	}
+
+	return b_head;
+
+replay_failure:
+	for (iter = 0; iter < cache->rec_cnt; iter++)
+		_hsh_remove(state, cache->rec[iter]->hash);
+	return NULL;
+}
+
+/**
+ * Generates the BPF instruction blocks for a syscall's filter chain
+ * @param state the BPF state
+ * @param sys the syscall filter
+ * @param nxt_jump the jump to fallthrough to at the end of the chain
+ * @param a_state the accumulator state
+ *
+ * Generate the BPF instruction blocks for the syscall's filter chain just as
+ * _gen_bpf_chain() does, reusing the blocks saved in the argument chain cache
+ * by a previous generation if the chain has not changed since.  Returns a
+ * pointer to the first block on success; returns NULL on failure.
+ *
+ */
+static struct bpf_blk *_gen_bpf_chain_cached(struct bpf_state *state,
+					     const struct db_sys_list *sys,
+					     const struct bpf_jump *nxt_jump,
+					     struct acc_state *a_state)
+{
+	bool rec = false;
+	struct bpf_blk *blk;
+	struct bpf_chain_ent *ent;
+	struct bpf_chain_cache *cache = state->chain_cache;
+
+	if (cache != NULL && sys->chains != NULL &&
+	    _chain_cache_key(state, sys->chains, nxt_jump, a_state) == 0) {
+		ent = _chain_cache_find(cache);
+		if (ent != NULL) {
+			ent->gen = cache->gen;
+			blk = _chain_cache_replay(state, ent);
+			if (blk != NULL)
+				return blk;
+		}
+		rec = true;
+	}
+
+	if (rec) {
+		cache->rec_cnt = 0;
+		cache->rec_err = false;
+		cache->rec_on = true;
+	}
+	blk = _gen_bpf_chain(state, sys, sys->chains, nxt_jump, a_state);
+	if (rec) {
+		cache->rec_on = false;
+		if (blk != NULL && !cache->rec_err)
+			_chain_cache_store(cache, blk);
+	}
+
+	return blk;
+}
+
+/**
+ * Drop the unused entries from the argument chain cache
+ * @param cache the argument chain cache
+ *
+ * Free the entries which were not used by the current generation, so that the
+ * cache only holds the argument chains of the most recent filter.
+ *
+ */
+static void _chain_cache_sweep(struct bpf_chain_cache *cache)
+{
+	unsigned int bkt;
+	struct bpf_chain_ent **e_iter, *ent;
+
+	for (bkt = 0; bkt < _BPF_CHAIN_SIZE(cache); bkt++) {
+		e_iter = &cache->tbl[bkt];
+		while (*e_iter != NULL) {
+			ent = *e_iter;
+			if (ent->gen == cache->gen) {
+				e_iter = &ent->next;
+				continue;
+			}
+			*e_iter = ent->next;
+			cache->ent_cnt--;
+			free(ent);
+		}
+	}
+}
+
+/**
+ * Get the argument chain cache of a filter DB
+ * @param db the filter DB
+ *
+ * Return the argument chain cache of the filter DB, creating it if needed.
+ * Returns a pointer to the cache on success, NULL on failure.
+ *
+ */
+static struct bpf_chain_cache *_chain_cache_get(struct db_filter *db)
+{
+	struct bpf_chain_cache *cache;
+
+	if (db->chain_cache != NULL)
+		return db->chain_cache;
+
+	cache = zmalloc(sizeof(*cache));
+	if (cache == NULL)
+		return NULL;
+	cache->tbl = zmalloc(sizeof(*cache->tbl) << _BPF_CHAIN_BITS_MIN);
+	if (cache->tbl == NULL) {
+		free(cache);
+		return NULL;
+	}
+	cache->tbl_bits = _BPF_CHAIN_BITS_MIN;
+	db->chain_cache = cache;
+
+	return cache;
+}
+
+/**
+ * Find the syscall ranges in a filter DB
+ * @param db the filter DB
+ *
+ * Search the filter DB for runs of consecutive syscalls which have no argument
+ * chains and share the same action and priority so that they can be checked
+ * with a single syscall range check.  The run may contain a small number of
+ * syscalls without filters, these "holes" are checked individually.  The
+ * first syscall in a range has its rng_last field set to the last syscall in
+ * the range, while the other syscalls in the range have their rng_skip field
+ * set.
+ *
+ */
+static void _gen_bpf_sys_ranges(const struct db_filter *db)
+{
+	unsigned int cnt, holes, gap;
+	struct db_sys_list *s_iter, *s_nxt, *s_last;
+
+	s_iter = db->syscalls;
+	while (s_iter != NULL) {
+		s_iter->rng_last = NULL;
+		s_iter->rng_skip = false;
+		if (!s_iter->valid || s_iter->chains != NULL) {
+			s_iter = s_iter->next;
+			continue;
+		}
+
+		/* find the end of the run */
+		cnt = 1;
+		holes = 0;
+		s_last = s_iter;
+		for (s_nxt = s_iter->next; s_nxt != NULL; s_nxt = s_nxt->next) {
+			/* phantom entries are treated as holes */
+			if (!s_nxt->valid)
+				continue;
+			if (s_nxt->chains != NULL ||
+			    s_nxt->action != s_iter->action ||
+			    s_nxt->priority != s_iter->priority)
+				break;
+			gap = s_nxt->num - s_last->num - 1;
+			if (holes + gap > _BPF_RANGE_HOLES_MAX)
+				break;
+			holes += gap;
+			cnt++;
+			s_last = s_nxt;
+		}
+
+		/* a range check costs two instructions plus one per hole */
+		if (cnt <= holes + 2) {
+			s_iter = s_iter->next;
+			continue;
+		}
+		s_iter->rng_last = s_last;
+		s_nxt = s_iter;
+		do {
+			s_nxt = s_nxt->next;
+			s_nxt->rng_last = NULL;
+			s_nxt->rng_skip = true;
+		} while (s_nxt != s_last);
+		s_iter = s_last->next;
+	}
+}
+
+/**
+ * Generate the BPF instructions to check for a given syscall or syscall range
+ * @param state the BPF state
+ * @param blk the BPF instruction block
+ * @param sys the syscall filter DB entry
+ * @param b_chain the argument chain/action block for the syscall(s)
+ * @param nxt_jump the jump to take if there is no match, or NULL
+ *
+ * Append the BPF instructions to check for the given syscall, or syscall range
+ * if @sys is the start of a range, to the instruction block.  If the syscall
+ * matches we jump to @b_chain, otherwise we jump to @nxt_jump; if @nxt_jump is
+ * NULL we jump to the instruction immediately following the check.  Returns a
+ * pointer to the block on success, NULL on failure, and in the case of failure
+ * the instruction block is free'd.
+ *
+ */
+static struct bpf_blk *_gen_bpf_syscall_check(struct bpf_state *state,
+					      struct bpf_blk *blk,
+					      const struct db_sys_list *sys,
+					      const struct bpf_blk *b_chain,
+					      const struct bpf_jump *nxt_jump)
+{
+	unsigned int iter, size, hole, holes = 0;
+	struct bpf_instr instr;
+	struct bpf_jump act_jump, def_jump;
+	const struct db_sys_list *s_iter;
+
+	/* we do the memset before the assignment to keep valgrind happy */
+	memset(&act_jump, 0, sizeof(act_jump));
+	memset(&def_jump, 0, sizeof(def_jump));
+	act_jump = _BPF_JMP_HSH(b_chain->hash);
+	def_jump = _BPF_JMP_HSH(state->def_hsh);
+
+	if (sys->rng_last == NULL) {
+		/* single syscall check */
+		_BPF_INSTR(instr, _BPF_OP(state->arch, BPF_JMP + BPF_JEQ),
+			   act_jump,
+			   (nxt_jump != NULL ? *nxt_jump : _BPF_JMP_IMM(0)),
+			   _BPF_K(state->arch, sys->num));
+		return _blk_append(state, blk, &instr);
+	}
+
+	/* count the holes in the range */
+	hole = sys->num;
+	for (s_iter = sys; s_iter != sys->rng_last->next;
+	     s_iter = s_iter->next) {
+		if (!s_iter->valid)
+			continue;
+		holes += s_iter->num - hole;
+		hole = s_iter->num + 1;
+	}
+	size = 2 + holes;
+
+	/* range check */
+	_BPF_INSTR(instr, _BPF_OP(state->arch, BPF_JMP + BPF_JGE),
+		   _BPF_JMP_IMM(0),
+		   (nxt_jump != NULL ? *nxt_jump : _BPF_JMP_IMM(size - 1)),
+		   _BPF_K(state->arch, sys->num));
+	blk = _blk_append(state, blk, &instr);
+	if (blk == NULL)
+		return NULL;
+	_BPF_INSTR(instr, _BPF_OP(state->arch, BPF_JMP + BPF_JGT),
+		   (nxt_jump != NULL ? *nxt_jump : _BPF_JMP_IMM(size - 2)),
+		   (holes > 0 ? _BPF_JMP_IMM(0) : act_jump),
+		   _BPF_K(state->arch, sys->rng_last->num));
+	blk = _blk_append(state, blk, &instr);
+	if (blk == NULL)
+		return NULL;
+
+	/* hole checks */
+	iter = 0;
+	hole = sys->num;
+	for (s_iter = sys; s_iter != sys->rng_last->next;
+	     s_iter = s_iter->next) {
+		if (!s_iter->valid)
+			continue;
+		for (; hole < s_iter->num; hole++) {
+			_BPF_INSTR(instr,
+				   _BPF_OP(state->arch, BPF_JMP + BPF_JEQ),
+				   def_jump,
+				   (++iter < holes ?
+				    _BPF_JMP_IMM(0) : act_jump),
+				   _BPF_K(state->arch, hole));
+			blk = _blk_append(state, blk, &instr);
+			if (blk == NULL)
+				return NULL;
+		}
+		hole = s_iter->num + 1;
+	}
+
+	return blk;
+}
+
+/**
+ * Generate the BPF instruction blocks for a given syscall
+ * @param state the BPF state
+ * @param sys the syscall filter DB entry
+ * @param nxt_hash the hash value of the next syscall filter DB entry
+ * @param acc_reset accumulator reset flag
+ *
+ * Generate the BPF instruction blocks for the given syscall filter and return
+ * a pointer to the first block on success; returns NULL on failure.  It is
+ * important to note that the block returned has not been added to the hash
+ * table, however, any linked/referenced blocks have been added to the hash
+ * table.
+ *
+ */
+static struct bpf_blk *_gen_bpf_syscall(struct bpf_state *state,
+					const struct db_sys_list *sys,
+					uint64_t nxt_hash,
+					bool acc_reset)
+{
+	int rc;
+	struct bpf_instr instr;
+	struct bpf_blk *blk_c, *blk_s;
+	struct bpf_jump chn_jump, nxt_jump;
+	struct acc_state a_state;
+
+	/* we do the memset before the assignment to keep valgrind happy */
+	memset(&chn_jump, 0, sizeof(chn_jump));
+	memset(&nxt_jump, 0, sizeof(nxt_jump));
+	chn_jump = _BPF_JMP_HSH(state->chn_hsh);
+
+	blk_s = _blk_alloc(state);
+	if (blk_s == NULL)
+		return NULL;
+
+	/* setup the accumulator state */
+	if (acc_reset) {
+		_BPF_INSTR(instr, _BPF_OP(state->arch, BPF_LD + BPF_ABS),
+			   _BPF_JMP_NO, _BPF_JMP_NO,
+			   _BPF_SYSCALL(state->arch));
+		blk_s = _blk_append(state, blk_s, &instr);
+		if (blk_s == NULL)
+			return NULL;
+		/* we've loaded the syscall ourselves */
+		a_state = _ACC_STATE_OFFSET(_BPF_OFFSET_SYSCALL);
+		blk_s->acc_start = _ACC_STATE_UNDEF;
+		blk_s->acc_end = _ACC_STATE_OFFSET(_BPF_OFFSET_SYSCALL);
+	} else {
+		/* we rely on someone else to load the syscall */
+		a_state = _ACC_STATE_UNDEF;
+		blk_s->acc_start = _ACC_STATE_OFFSET(_BPF_OFFSET_SYSCALL);
+		blk_s->acc_end = _ACC_STATE_OFFSET(_BPF_OFFSET_SYSCALL);
+	}
+
+	/* generate the argument chains */
+	blk_c = _gen_bpf_chain_cached(state, sys, &chn_jump, &a_state);
+	if (blk_c == NULL) {
+		_blk_free(state, blk_s);
+		return NULL;
+	}
+
+	/* syscall check */
+	nxt_jump = _BPF_JMP_HSH(nxt_hash);
+	blk_s = _gen_bpf_syscall_check(state, blk_s, sys, blk_c, &nxt_jump);
+	if (blk_s == NULL)
+		return NULL;
+	blk_s->priority = sys->priority;
+
+	/* add to the hash table */
+	rc = _hsh_add(state, &blk_s, 1);
+	if (rc < 0) {
+		_blk_free(state, blk_s);
+		return NULL;
+	}
+
+	return blk_s;
+}
+
+/**
+ * Generate a binary search tree of syscall checks
+ * @param state the BPF state
+ * @param sys_list the syscall filter DB entries, sorted by syscall number
+ * @param sys_cnt the number of entries in @sys_list
+ * @param acc_reset accumulator reset flag
+ * @param root root of the tree flag
+ *
+ * Generate a balanced binary search tree of BPF_JGE checks over the syscalls
+ * in @sys_list, with a short linear BPF_JEQ check at each of the leaves.
+ * Returns a pointer to the block at the root of the tree on success, NULL on
+ * failure.  All of the blocks are added to the hash table; the root block is
+ * added in the same manner as _gen_bpf_syscall() so it can be linked into the
+ * architecture's block list.
+ *
+ */
+static struct bpf_blk *_gen_bpf_syscall_tree(struct bpf_state *state,
+					     struct db_sys_list **sys_list,
+					     unsigned int sys_cnt,
+					     bool acc_reset, bool root)
+{
+	int rc;
+	unsigned int iter, split;
+	struct bpf_instr instr;
+	struct bpf_blk *blk, *b_lo, *b_hi, *b_chain;
+	struct bpf_jump def_jump, chn_jump;
+	struct acc_state a_state;
+
+	/* we do the memset before the assignment to keep valgrind happy */
+	memset(&def_jump, 0, sizeof(def_jump));
+	memset(&chn_jump, 0, sizeof(chn_jump));
+	def_jump = _BPF_JMP_HSH(state->def_hsh);
+	chn_jump = _BPF_JMP_HSH(state->chn_hsh);
+
+	blk = _blk_alloc(state);
+	if (blk == NULL)
+		return NULL;
+	blk->acc_start = _ACC_STATE_OFFSET(_BPF_OFFSET_SYSCALL);
+	blk->acc_end = _ACC_STATE_OFFSET(_BPF_OFFSET_SYSCALL);
+
+	/* setup the accumulator state */
+	if (acc_reset) {
+		_BPF_INSTR(instr, _BPF_OP(state->arch, BPF_LD + BPF_ABS),
+			   _BPF_JMP_NO, _BPF_JMP_NO,
+			   _BPF_SYSCALL(state->arch));
+		blk = _blk_append(state, blk, &instr);
+		if (blk == NULL)
+			return NULL;
+		/* we've loaded the syscall ourselves */
+		blk->acc_start = _ACC_STATE_UNDEF;
+	}
+
+	if (sys_cnt > _BPF_BINTREE_LEAF) {
+		/* split the syscalls and generate the subtrees */
+		split = sys_cnt / 2;
+		b_lo = _gen_bpf_syscall_tree(state, sys_list, split,
+					     false, false);
+		if (b_lo == NULL)
+			goto tree_failure;
+		b_hi = _gen_bpf_syscall_tree(state, &sys_list[split],
+					     sys_cnt - split, false, false);
+		if (b_hi == NULL)
+			goto tree_failure;
+
+		_BPF_INSTR(instr, _BPF_OP(state->arch, BPF_JMP + BPF_JGE),
+			   _BPF_JMP_HSH(b_hi->hash), _BPF_JMP_HSH(b_lo->hash),
+			   _BPF_K(state->arch, sys_list[split]->num));
+		blk = _blk_append(state, blk, &instr);
+		if (blk == NULL)
+			return NULL;
+	} else {
+		/* leaf node, check each of the syscalls in turn */
+		for (iter = 0; iter < sys_cnt; iter++) {
+			a_state = _ACC_STATE_OFFSET(_BPF_OFFSET_SYSCALL);
+			b_chain = _gen_bpf_chain_cached(state, sys_list[iter],
+							&chn_jump, &a_state);
+			if (b_chain == NULL)
+				goto tree_failure;
+
+			blk = _gen_bpf_syscall_check(state, blk,
+						     sys_list[iter], b_chain,
+						     (iter + 1 < sys_cnt ?
+						      NULL : &def_jump));
+			if (blk == NULL)
+				return NULL;
+		}
+	}
+
+	/* add to the hash table */
+	rc = _hsh_add(state, &blk, (root ? 1 : 0));
+	if (rc < 0)
+		goto tree_failure;
+
+	return blk;
+
+tree_failure:
+	_blk_free(state, blk);
+	return NULL;
+}
+
+/**
+ * Generate the binary search tree for a given filter/architecture
+ * @param state the BPF state
+ * @param db the filter DB
+ * @param db_secondary the secondary DB
+ * @param acc_reset accumulator reset flag
+ * @param root the root block of the tree
+ *
+ * Generate the binary search tree of syscall checks for the given filter
+ * DB(s) and return the root block via @root; if there are no syscall filters
+ * @root is set to NULL.  Returns zero on success, negative values on failure.
+ *
+ */
+static int _gen_bpf_bintree(struct bpf_state *state,
+			    const struct db_filter *db,
+			    const struct db_filter *db_secondary,
+			    bool acc_reset, struct bpf_blk **root)
+{
+	unsigned int sys_cnt = 0;
+	struct db_sys_list *s_iter, *s_iter_b;
+	struct db_sys_list **sys_list;
+
+	*root = NULL;
+
+	/* count the syscalls */
+	db_list_foreach(s_iter, db->syscalls) {
+		if (s_iter->valid && !s_iter->rng_skip && !s_iter->pri_hot)
+			sys_cnt++;
+	}
+	if (db_secondary != NULL) {
+		db_list_foreach(s_iter, db_secondary->syscalls) {
+			if (s_iter->valid && !s_iter->rng_skip &&
+			    !s_iter->pri_hot)
+				sys_cnt++;
+		}
+	}
+	if (sys_cnt == 0)
+		return 0;
+
+	sys_list = zmalloc(sizeof(*sys_list) * sys_cnt);
+	if (sys_list == NULL)
+		return -ENOMEM;
+
+	/* merge the sorted syscall lists */
+	sys_cnt = 0;
+	s_iter = db->syscalls;
+	s_iter_b = (db_secondary != NULL ? db_secondary->syscalls : NULL);
+	while (s_iter != NULL || s_iter_b != NULL) {
+		if (s_iter_b == NULL ||
+		    (s_iter != NULL && s_iter->num <= s_iter_b->num)) {
+			if (s_iter->valid && !s_iter->rng_skip &&
+			    !s_iter->pri_hot)
+				sys_list[sys_cnt++] = s_iter;
+			s_iter = s_iter->next;
+		} else {
+			if (s_iter_b->valid && !s_iter_b->rng_skip &&
+			    !s_iter_b->pri_hot)
+				sys_list[sys_cnt++] = s_iter_b;
+			s_iter_b = s_iter_b->next;
+		}
+	}
+
+	*root = _gen_bpf_syscall_tree(state, sys_list, sys_cnt,
+				      acc_reset, true);
+	free(sys_list);
+	if (*root == NULL)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/**
+ * Sort the syscalls by priority
+ * @param a the first syscall
+ * @param b the second syscall
+ *
+ * This is a qsort() helper which sorts the syscalls by decreasing priority,
+ * syscalls with the same priority keep their original order.
+ *
+ */
+static int _gen_bpf_sys_pri_cmp(const void *a, const void *b)
+{
+	const struct bpf_sys_order *x = a, *y = b;
+
+	if (x->sys->priority != y->sys->priority)
+		return (x->sys->priority > y->sys->priority ? -1 : 1);
+	if (x->order != y->order)
+		return (x->order < y->order ? -1 : 1);
+	return 0;
+}
+
+/**
+ * Order the syscalls of the filter DB(s) by priority
+ * @param db the filter DB
+ * @param db_secondary the secondary DB
+ * @param head the highest priority syscall
+ * @param tail the lowest priority syscall
+ *
+ * Link the syscalls which are not skipped as part of a syscall range through
+ * their priority list fields, highest priority first; syscalls with the same
+ * priority are ordered as in the filter DB(s), the primary DB first.  Returns
+ * zero on success, negative values on failure.
+ *
+ */
+static int _gen_bpf_sys_sort(const struct db_filter *db,
+			     const struct db_filter *db_secondary,
+			     struct db_sys_list **head,
+			     struct db_sys_list **tail)
+{
+	unsigned int iter, sys_cnt = 0;
+	struct db_sys_list *s_iter;
+	struct bpf_sys_order *sys_list;
+
+	*head = NULL;
+	*tail = NULL;
+
+	db_list_foreach(s_iter, db->syscalls) {
+		if (!s_iter->rng_skip)
+			sys_cnt++;
+	}
+	if (db_secondary != NULL) {
+		db_list_foreach(s_iter, db_secondary->syscalls) {
+			if (!s_iter->rng_skip)
+				sys_cnt++;
+		}
+	}
+	if (sys_cnt == 0)
+		return 0;
+
+	sys_list = malloc(sizeof(*sys_list) * sys_cnt);
+	if (sys_list == NULL)
+		return -ENOMEM;
+
+	sys_cnt = 0;
+	db_list_foreach(s_iter, db->syscalls) {
+		if (s_iter->rng_skip)
+			continue;
+		sys_list[sys_cnt].sys = s_iter;
+		sys_list[sys_cnt].order = sys_cnt;
+		sys_cnt++;
+	}
+	if (db_secondary != NULL) {
+		db_list_foreach(s_iter, db_secondary->syscalls) {
+			if (s_iter->rng_skip)
+				continue;
+			sys_list[sys_cnt].sys = s_iter;
+			sys_list[sys_cnt].order = sys_cnt;
+			sys_cnt++;
+		}
+	}
+	qsort(sys_list, sys_cnt, sizeof(*sys_list), _gen_bpf_sys_pri_cmp);
+
+	for (iter = 0; iter < sys_cnt; iter++) {
+		s_iter = sys_list[iter].sys;
+		s_iter->pri_hot = false;
+		s_iter->pri_prv = (iter > 0 ? sys_list[iter - 1].sys : NULL);
+		s_iter->pri_nxt = (iter + 1 < sys_cnt ?
+				   sys_list[iter + 1].sys : NULL);
+	}
+	*head = sys_list[0].sys;
+	*tail = sys_list[sys_cnt - 1].sys;
+
+	free(sys_list);
+	return 0;
+}
+
+/**
+ * Generate the BPF instruction blocks for a given filter/architecture
+ * @param state the BPF state
+ * @param db the filter DB
+ * @param db_secondary the secondary DB
+ *
+ * Generate the BPF instruction block for the given filter DB(s)/architecture(s)
+ * and return a pointer to the block on succes, NULL on failure.  The resulting
+ * block assumes that the architecture token has already been loaded into the
+ * BPF accumulator.
+ *
+ */
+static struct bpf_blk *_gen_bpf_arch(struct bpf_state *state,
+				     const struct db_filter *db,
+				     const struct db_filter *db_secondary)
+{
+	int rc;
+	unsigned int blk_cnt = 0, hot_cnt = 0;
+	bool acc_reset;
+	struct bpf_instr instr;
+	struct db_sys_list *s_head = NULL, *s_tail = NULL, *s_iter;
+	struct db_sys_list *s_hot_head = NULL, *s_hot_tail = NULL;
+	struct bpf_blk *b_head = NULL, *b_tail = NULL, *b_iter, *b_new;
+
+	state->arch = db->arch;
+	if (state->chain_cache != NULL)
+		state->chain_cache->gen++;
+
+	/* find the syscall ranges */
+	_gen_bpf_sys_ranges(db);
+	if (db_secondary != NULL)
+		_gen_bpf_sys_ranges(db_secondary);
+
+	/* sort the syscall list */
+	rc = _gen_bpf_sys_sort(db, db_secondary, &s_head, &s_tail);
+	if (rc < 0)
+		goto arch_failure;
+
+	if ((state->arch->token == SCMP_ARCH_X86_64 ||
+	     state->arch->token == SCMP_ARCH_X32) && (db_secondary == NULL))
+		acc_reset = false;
+	else
+		acc_reset = true;
+
+	if (state->attr->optimize == 2) {
+		/* the highest priority syscalls are checked before the tree */
+		for (s_iter = s_head;
+		     s_iter != NULL && hot_cnt < _BPF_BINTREE_HOT;
+		     s_iter = s_iter->pri_nxt) {
+			if ((s_iter->priority & _DB_PRI_MASK_USER) == 0)
+				break;
+			if (!s_iter->valid)
+				continue;
+			s_iter->pri_hot = true;
+			if (hot_cnt++ == 0)
+				s_hot_head = s_iter;
+			s_hot_tail = s_iter;
+		}
+
+		/* create the binary tree of syscall filters */
+		rc = _gen_bpf_bintree(state, db, db_secondary,
+				      (hot_cnt > 0 ? false : acc_reset),
+				      &b_new);
+		if (rc < 0)
+			goto arch_failure;
+		if (b_new != NULL) {
+			b_new->prev = NULL;
+			b_new->next = NULL;
+			b_head = b_new;
+			b_tail = b_new;
+			blk_cnt++;
+		}
+
+		/* add the high priority syscalls to the block list head */
+		for (s_iter = s_hot_tail; s_iter != NULL;
+		     s_iter = s_iter->pri_prv) {
+			if (!s_iter->pri_hot)
+				continue;
+
+			b_new = _gen_bpf_syscall(state, s_iter,
+						 (b_head == NULL ?
+						  state->def_hsh :
+						  b_head->hash),
+						 (s_iter == s_hot_head ?
+						  acc_reset : false));
+			if (b_new == NULL)
+				goto arch_failure;
+
+			b_new->prev = NULL;
+			b_new->next = b_head;
+			if (b_head != NULL)
+				b_head->prev = b_new;
+			else
+				b_tail = b_new;
+			b_head = b_new;
+			blk_cnt++;
+		}
+	} else {
+		/* the first syscall filter must load the syscall number, skip
+		 * the priority only entries as they do not generate a filter */
+		while (s_head != NULL && !s_head->valid)
+			s_head = s_head->pri_nxt;
+
+		/* create the syscall filters and add them to block list */
+		for (s_iter = s_tail; s_iter != NULL;
+		     s_iter = s_iter->pri_prv) {
+			if (!s_iter->valid)
+				continue;
+
+			/* build the syscall filter */
+			b_new = _gen_bpf_syscall(state, s_iter,
+						 (b_head == NULL ?
+						  state->def_hsh :
+						  b_head->hash),
+						 (s_iter == s_head ?
+						  acc_reset : false));
+			if (b_new == NULL)
+				goto arch_failure;
+
+			/* add the filter to the list head */
+			b_new->prev = NULL;
+			b_new->next = b_head;
+			if (b_tail != NULL) {
+				b_head->prev = b_new;
+				b_head = b_new;
+			} else {
+				b_head = b_new;
+				b_tail = b_head;
+			}
+
+			if (b_tail->next != NULL)
+				b_tail = b_tail->next;
+			blk_cnt++;
+		}
+	}
+
+	/* additional ABI filtering */
+	if ((state->arch->token == SCMP_ARCH_X86_64 ||
+	     state->arch->token == SCMP_ARCH_X32) && (db_secondary == NULL)) {
+		_BPF_INSTR(instr, _BPF_OP(state->arch, BPF_LD + BPF_ABS),
+			   _BPF_JMP_NO, _BPF_JMP_NO, _BPF_SYSCALL(state->arch));
+		b_new = _blk_append(state, NULL, &instr);
+		if (b_new == NULL)
+			goto arch_failure;
+		b_new->acc_end = _ACC_STATE_OFFSET(_BPF_OFFSET_SYSCALL);
+		if (state->arch->token == SCMP_ARCH_X86_64) {
+			/* filter out x32 */
+			_BPF_INSTR(instr,
+				   _BPF_OP(state->arch, BPF_JMP + BPF_JGE),
+				   _BPF_JMP_NO,
+				   _BPF_JMP_NO,
+				   _BPF_K(state->arch, X32_SYSCALL_BIT));
+			if (b_head != NULL)
+				instr.jf = _BPF_JMP_HSH(b_head->hash);
+			else
+				instr.jf = _BPF_JMP_HSH(state->def_hsh);
+			b_new = _blk_append(state, b_new, &instr);
+			if (b_new == NULL)
+				goto arch_failure;
+			/* NOTE: starting with Linux v4.8 the seccomp filters
+			 *	 are processed both when the syscall is
+			 *	 initially executed as well as after any
+			 *	 tracing processes finish so we need to make
+			 *	 sure we don't trap the -1 syscall which
+			 *	 tracers can use to skip the syscall, see
+			 *	 seccomp(2) for more information */
+			_BPF_INSTR(instr,
+				   _BPF_OP(state->arch, BPF_JMP + BPF_JEQ),
+				   _BPF_JMP_NO,
+				   _BPF_JMP_HSH(state->bad_arch_hsh),
+				   _BPF_K(state->arch, -1));
+			if (b_head != NULL)
+				instr.jt = _BPF_JMP_HSH(b_head->hash);
+			else
+				instr.jt = _BPF_JMP_HSH(state->def_hsh);
+			blk_cnt++;
+		} else if (state->arch->token == SCMP_ARCH_X32) {
+			/* filter out x86_64 */
+			_BPF_INSTR(instr,
+				   _BPF_OP(state->arch, BPF_JMP + BPF_JGE),
+				   _BPF_JMP_NO,
+				   _BPF_JMP_HSH(state->bad_arch_hsh),
+				   _BPF_K(state->arch, X32_SYSCALL_BIT));
+			if (b_head != NULL)
+				instr.jt = _BPF_JMP_HSH(b_head->hash);
+			else
+				instr.jt = _BPF_JMP_HSH(state->def_hsh);
+			blk_cnt++;
+		} else
+			/* we should never get here */
+			goto arch_failure;
+		b_new = _blk_append(state, b_new, &instr);
+		if (b_new == NULL)
+			goto arch_failure;
+		b_new->next = b_head;
+		if (b_head != NULL)
+			b_head->prev = b_new;
+		b_head = b_new;
+		rc = _hsh_add(state, &b_head, 1);
+		if (rc < 0)
+			goto arch_failure;
+	}
+
+	/* do the ABI/architecture check */
+	_BPF_INSTR(instr, _BPF_OP(state->arch, BPF_JMP + BPF_JEQ),
+		   _BPF_JMP_NO, _BPF_JMP_NXT(blk_cnt++),
+		   _BPF_K(state->arch, state->arch->token_bpf));
+	if (b_head != NULL)
+		instr.jt = _BPF_JMP_HSH(b_head->hash);
+	else
+		instr.jt = _BPF_JMP_HSH(state->def_hsh);
+	b_new = _blk_append(state, NULL, &instr);
+	if (b_new == NULL)
+		goto arch_failure;
+	b_new->next = b_head;
+	if (b_head != NULL)
+		b_head->prev = b_new;
+	b_head = b_new;
+	rc = _hsh_add(state, &b_head, 1);
+	if (rc < 0)
+		goto arch_failure;
+
+	/* only keep the argument chains of this filter */
+	if (state->chain_cache != NULL)
+		_chain_cache_sweep(state->chain_cache);
+
+	state->arch = NULL;
+	return b_head;
+
+arch_failure:
+	/* NOTE: we do the cleanup here and not just return an error as all of
+	 * the instruction blocks may not be added to the hash table when we
+	 * hit an error */
+	state->arch = NULL;
+	b_iter = b_head;
+	while (b_iter != NULL) {
+		b_new = b_iter->next;
+		_blk_free(state, b_iter);
+		b_iter = b_new;
+	}
+	return NULL;
+}
+
+/**
+ * Merge a BPF state into another BPF state
+ * @param state the BPF state
+ * @param src the BPF state to merge
+ *
+ * Move the instruction blocks, hash table entries and memory of @src into
+ * @state.  If a block is already in @state the existing block is kept, just
+ * as _hsh_add() does.  Returns zero on success, -EAGAIN if two different
+ * blocks share a hash value, which only a serial build can resolve, and
+ * negative values on failure.
+ *
+ */
+static int _gen_bpf_state_merge(struct bpf_state *state,
+				struct bpf_state *src)
+{
+	unsigned int bkt;
+	struct bpf_arena *chunk;
+	struct bpf_hash_bkt *h_iter, *h_dst;
+
+	/* take the memory first, the current chunk of @state stays in front so
+	 * that _arena_realloc() keeps working */
+	if (src->arena != NULL) {
+		for (chunk = src->arena; chunk->next != NULL;
+		     chunk = chunk->next);
+		if (state->arena != NULL) {
+			chunk->next = state->arena->next;
+			state->arena->next = src->arena;
+		} else
+			state->arena = src->arena;
+		src->arena = NULL;
+	}
+
+	for (bkt = 0; bkt < _BPF_HASH_SIZE(src); bkt++) {
+		while (src->htbl[bkt] != NULL) {
+			h_iter = src->htbl[bkt];
+			src->htbl[bkt] = h_iter->next;
+			src->htbl_cnt--;
+
+			h_dst = _hsh_find_bkt(state, h_iter->blk->hash);
+			if (h_dst != NULL) {
+				if (!_blk_equal(h_dst->blk, h_iter->blk))
+					return -EAGAIN;
+				/* duplicate block, keep the existing block */
+				if (!h_iter->found &&
+				    h_dst->blk->priority < h_iter->blk->priority)
+					h_dst->blk->priority =
+						h_iter->blk->priority;
+				continue;
+			}
+
+			h_iter->next = state->htbl[_BPF_HASH_BKT(state,
+							h_iter->blk->hash)];
+			state->htbl[_BPF_HASH_BKT(state,
+						  h_iter->blk->hash)] = h_iter;
+			if (++state->htbl_cnt > _BPF_HASH_SIZE(state))
+				_hsh_grow(state);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Estimate the number of instruction blocks for an architecture
+ * @param db the filter DB
+ *
+ * Returns roughly one block per syscall and chain node, which is used to size
+ * the hash table.
+ *
+ */
+static unsigned int _gen_bpf_blk_cnt(const struct db_filter *db)
+{
+	unsigned int blk_cnt = 2;
+	struct db_sys_list *s_iter;
+
+	db_list_foreach(s_iter, db->syscalls)
+		blk_cnt += s_iter->node_cnt + 1;
+	return blk_cnt;
+}
+
+/**
+ * Generate the filter for an architecture on a worker thread
+ * @param arg the architecture job
+ *
+ * This is a pthread_create() helper which runs _gen_bpf_arch() using the
+ * job's own BPF state.
+ *
+ */
+static void *_gen_bpf_arch_thread(void *arg)
+{
+	struct bpf_arch_job *job = arg;
+
+	job->blk = _gen_bpf_arch(&job->state, job->db, job->db_secondary);
+	return NULL;
+}
+
+/**
+ * Generate the filters for all of the architectures
+ * @param state the BPF state
+ * @param jobs the architecture jobs
+ * @param job_cnt the number of architecture jobs
+ *
+ * Generate the filter for each architecture, in order, and save it in the
+ * architecture's job.  If parallel generation is enabled every architecture
+ * except the first is generated on a worker thread with its own BPF state,
+ * which is merged into @state once the thread is done.  The resulting blocks
+ * and hash values are the same as those of a serial build.  Returns zero on
+ * success, negative values on failure.
+ *
+ */
+static int _gen_bpf_archs(struct bpf_state *state,
+			  struct bpf_arch_job *jobs, unsigned int job_cnt)
+{
+	int rc = 0;
+	unsigned int iter;
+	struct bpf_arch_job *job;
+
+	if (!state->parallel || job_cnt < 2) {
+		for (iter = 0; iter < job_cnt; iter++) {
+			state->chain_cache = jobs[iter].cache;
+			jobs[iter].blk = _gen_bpf_arch(state, jobs[iter].db,
+						       jobs[iter].db_secondary);
+			state->chain_cache = NULL;
+			if (jobs[iter].blk == NULL)
+				return -ENOMEM;
+		}
+		return 0;
+	}
+
+	for (iter = 1; iter < job_cnt; iter++) {
+		job = &jobs[iter];
+		job->state.attr = state->attr;
+		job->state.bad_arch_hsh = state->bad_arch_hsh;
+		job->state.def_hsh = state->def_hsh;
+		job->state.chn_hsh = state->chn_hsh;
+		job->state.chain_cache = job->cache;
+		rc = _hsh_init(&job->state,
+			       _gen_bpf_blk_cnt(job->db) +
+			       (job->db_secondary != NULL ?
+				_gen_bpf_blk_cnt(job->db_secondary) : 0));
+		if (rc < 0)
+			break;
+		/* fall back to this thread if we can't start a new one */
+		if (pthread_create(&job->thread, NULL,
+				   _gen_bpf_arch_thread, job) == 0)
+			job->thread_valid = true;
+		else
+			_gen_bpf_arch_thread(job);
+	}
+
+	/* the first architecture is generated on this thread */
+	state->chain_cache = jobs[0].cache;
+	jobs[0].blk = _gen_bpf_arch(state, jobs[0].db, jobs[0].db_secondary);
+	state->chain_cache = NULL;
+	if (jobs[0].blk == NULL && rc == 0)
+		rc = -ENOMEM;
+
+	/* merge the architectures in order so the result matches a serial
+	 * build */
+	for (iter = 1; iter < job_cnt; iter++) {
+		job = &jobs[iter];
+		if (job->thread_valid)
+			pthread_join(job->thread, NULL);
+		if (rc == 0 && job->blk == NULL)
+			rc = -ENOMEM;
+		if (rc == 0)
+			rc = _gen_bpf_state_merge(state, &job->state);
+		_state_release(&job->state);
+	}
+
+	return rc;
+}
+
+/**
+ * Find the target block for the "next" jump
+ * @param blk the instruction block
+ * @param nxt the next offset
+ *
+ * Find the target block for the TGT_NXT jump using the given offset.  Returns
+ * a pointer to the target block on success or NULL on failure.
+ *
+ */
+static struct bpf_blk *_gen_bpf_find_nxt(const struct bpf_blk *blk,
+					 unsigned int nxt)
+{
+	struct bpf_blk *iter = blk->next;
+
+	for (; (iter != NULL) && (nxt > 0); nxt--)
+		iter = iter->next;
+
+	return iter;
+}
+
+/**
+ * Compare two instruction block positions
+ * @param a the first block position
+ * @param b the second block position
+ *
+ * This is a qsort() helper which sorts the block positions by hash value and
+ * then by position in the instruction block list.
+ *
+ */
+static int _gen_bpf_blk_pos_cmp(const void *a, const void *b)
+{
+	const struct bpf_blk_pos *p_a = a;
+	const struct bpf_blk_pos *p_b = b;
+
+	if (p_a->hash != p_b->hash)
+		return (p_a->hash > p_b->hash ? 1 : -1);
+	return (p_a->pos > p_b->pos) - (p_a->pos < p_b->pos);
+}
+
+/**
+ * Find an instruction block position
+ * @param pos the sorted instruction block positions
+ * @param pos_cnt the number of instruction block positions
+ * @param hash the block hash value
+ * @param blk the position in the instruction block list
+ *
+ * Find the first instruction block with the given hash value at, or after,
+ * the given position in the instruction block list.  Returns the index into
+ * the instruction block positions on success, negative values on failure.
+ *
+ */
+static int _gen_bpf_blk_pos_find(const struct bpf_blk_pos *pos,
+				 unsigned int pos_cnt,
+				 uint64_t hash, unsigned int blk)
+{
+	unsigned int lo = 0, hi = pos_cnt, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (pos[mid].hash < hash ||
+		    (pos[mid].hash == hash && pos[mid].pos < blk))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == pos_cnt || pos[lo].hash != hash)
+		return -EFAULT;
+
+	return lo;
+}
+
+/**
+ * Determine if a new block can be inserted after an instruction block
+ * @param state the BPF state
+ * @param blk the instruction block
+ *
+ * A new block can only be inserted after an instruction block if execution
+ * never falls through, or jumps by a fixed offset, past the end of the block.
+ * Returns true if a block can be inserted, false otherwise.
+ *
+ */
+static bool _gen_bpf_blk_sealed(const struct bpf_state *state,
+				const struct bpf_blk *blk)
+{
+	unsigned int iter;
+	uint16_t code;
+	const struct bpf_instr *i_iter;
+
+	if (blk->blk_cnt == 0)
+		return false;
+	code = _ttoh16(state->arch, blk->blks[blk->blk_cnt - 1].op);
+	if (BPF_CLASS(code) != BPF_RET && BPF_CLASS(code) != BPF_JMP)
+		return false;
+
+	for (iter = 0; iter < blk->blk_cnt; iter++) {
+		i_iter = &blk->blks[iter];
+		if (i_iter->jt.type == TGT_IMM &&
+		    iter + 1 + i_iter->jt.tgt.imm_j >= blk->blk_cnt)
+			return false;
+		if (i_iter->jf.type == TGT_IMM &&
+		    iter + 1 + i_iter->jf.tgt.imm_j >= blk->blk_cnt)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Create a long jump trampoline
+ * @param state the BPF state
+ * @param b_tgt the jump destination block
+ *
+ * Create a new instruction block to stand in for the jump destination block.
+ * Jumps to a return instruction are handled by duplicating the return
+ * instruction so no additional jump is needed, all other jumps are handled by
+ * an unconditional jump to the destination.  Returns a pointer to the new
+ * block on success, NULL on failure.
+ *
+ */
+static struct bpf_blk *_gen_bpf_tramp(struct bpf_state *state,
+				      const struct bpf_blk *b_tgt)
+{
+	struct bpf_instr instr;
+	struct bpf_blk *b_new;
+
+	if (b_tgt->blk_cnt == 1 &&
+	    b_tgt->blks[0].op == _BPF_OP(state->arch, BPF_RET))
+		b_new = _gen_bpf_action(state, NULL,
+					b_tgt->blks[0].k.tgt.imm_k);
+	else {
+		_BPF_INSTR(instr, _BPF_OP(state->arch, BPF_JMP + BPF_JA),
+			   _BPF_JMP_NO, _BPF_JMP_NO, _BPF_JMP_HSH(b_tgt->hash));
+		b_new = _blk_append(state, NULL, &instr);
+	}
+	if (b_new == NULL)
 		return NULL;
-	blk_s->priority = sys->priority;
 
-	/* add to the hash table */
-	rc = _hsh_add(state, &blk_s, 1);
-	if (rc < 0) {
-		_blk_free(state, blk_s);
-		return NULL;
+	/* NOTE - we need to be careful here, we're giving the block a hash
+	 *	  value (this is a sneaky way to ensure we leverage the
+	 *	  inserted long jumps as much as possible) but we never add the
+	 *	  block to the hash table so it won't get cleaned up
+	 *	  automatically */
+	b_new->hash = b_tgt->hash;
+
+	return b_new;
+}
+
+/**
+ * Record a new trampoline
+ * @param ins the trampoline counts
+ * @param blk_cnt the number of instruction blocks
+ * @param blk the position of the block following the trampoline
+ *
+ * The trampoline counts are kept in a Fenwick tree so that the number of
+ * trampolines inserted in front of a range of blocks can be found quickly.
+ *
+ */
+static void _gen_bpf_ins_add(unsigned int *ins, unsigned int blk_cnt,
+			     unsigned int blk)
+{
+	for (blk++; blk <= blk_cnt; blk += blk & -blk)
+		ins[blk]++;
+}
+
+/**
+ * Count the new trampolines in front of a block
+ * @param ins the trampoline counts
+ * @param blk the position of the block
+ *
+ * Returns the number of trampolines inserted in front of the given block, and
+ * all of the blocks before it.
+ *
+ */
+static unsigned int _gen_bpf_ins_sum(const unsigned int *ins, unsigned int blk)
+{
+	unsigned int sum = 0;
+
+	for (blk++; blk > 0; blk -= blk & -blk)
+		sum += ins[blk];
+
+	return sum;
+}
+
+/**
+ * Insert long jumps into the instruction block list
+ * @param state the BPF state
+ * @param b_head the head of the instruction block list
+ *
+ * Find all of the jumps in the instruction block list which are too long to
+ * be encoded and insert trampolines to reach their destinations.  The block
+ * list is indexed once and then walked backwards, inserting a trampoline
+ * directly after a block when one of its jumps can not reach either the
+ * destination or an existing trampoline to the destination; this way each
+ * trampoline is shared by every earlier jump to the same destination that can
+ * reach it.  The jump distances account for the trampolines as they are
+ * inserted so a single pass is normally sufficient, but the process is
+ * repeated until every jump can be encoded.  Returns the number of
+ * trampolines added on success, negative values on failure.
+ *
+ */
+static int _gen_bpf_build_jmps(struct bpf_state *state,
+			       struct bpf_blk *b_head)
+{
+	int rc = 0, tgt, grp, j;
+	unsigned int iter, i_blk, blk_cnt, res_cnt, added, src, dst, dst_tramp;
+	unsigned int *off = NULL, *ins = NULL, *tramp = NULL;
+	struct bpf_blk **blks = NULL, *b_iter, *b_new;
+	struct bpf_blk_pos *pos = NULL;
+	struct bpf_jump *j_iter[2];
+
+	do {
+		free(blks);
+		free(off);
+		free(ins);
+		free(tramp);
+		free(pos);
+		added = 0;
+
+		/* index the current block layout */
+		blk_cnt = 0;
+		for (b_iter = b_head; b_iter != NULL; b_iter = b_iter->next)
+			blk_cnt++;
+		blks = zmalloc(sizeof(*blks) * blk_cnt);
+		off = zmalloc(sizeof(*off) * (blk_cnt + 1));
+		ins = zmalloc(sizeof(*ins) * (blk_cnt + 1));
+		tramp = zmalloc(sizeof(*tramp) * blk_cnt);
+		pos = zmalloc(sizeof(*pos) * blk_cnt);
+		if (blks == NULL || off == NULL || ins == NULL ||
+		    tramp == NULL || pos == NULL) {
+			rc = -ENOMEM;
+			goto build_jmps_return;
+		}
+		for (b_iter = b_head, i_blk = 0;
+		     b_iter != NULL;
+		     b_iter = b_iter->next, i_blk++) {
+			blks[i_blk] = b_iter;
+			off[i_blk + 1] = off[i_blk] + b_iter->blk_cnt;
+			pos[i_blk].hash = b_iter->hash;
+			pos[i_blk].pos = i_blk;
+		}
+		qsort(pos, blk_cnt, sizeof(*pos), _gen_bpf_blk_pos_cmp);
+
+		/* check the jumps, verifying the jump targets as we go */
+		i_blk = blk_cnt;
+		while (i_blk > 0) {
+			b_iter = blks[i_blk - 1];
+			res_cnt = 0;
+			for (iter = 0; iter < b_iter->blk_cnt; iter++) {
+				j_iter[0] = &b_iter->blks[iter].jt;
+				j_iter[1] = &b_iter->blks[iter].jf;
+				for (j = 0; j < 2; j++) {
+					if (j_iter[j]->type == TGT_NONE ||
+					    j_iter[j]->type == TGT_IMM)
+						continue;
+					if (j_iter[j]->type != TGT_PTR_HSH) {
+						rc = -EFAULT;
+						goto build_jmps_return;
+					}
+
+					/* find the closest destination */
+					grp = _gen_bpf_blk_pos_find(pos,
+							blk_cnt,
+							j_iter[j]->tgt.hash,
+							0);
+					tgt = _gen_bpf_blk_pos_find(pos,
+							blk_cnt,
+							j_iter[j]->tgt.hash,
+							i_blk);
+					if (grp < 0 || tgt < 0) {
+						rc = -EFAULT;
+						goto build_jmps_return;
+					}
+					tgt = pos[tgt].pos;
+					src = off[i_blk - 1] + iter + 1 +
+					      _gen_bpf_ins_sum(ins, i_blk - 1);
+					dst = off[tgt] +
+					      _gen_bpf_ins_sum(ins, tgt);
+					if (tramp[grp] >= i_blk) {
+						dst_tramp = off[tramp[grp]] +
+							    _gen_bpf_ins_sum(ins,
+								tramp[grp]) - 1;
+						if (dst_tramp < dst)
+							dst = dst_tramp;
+					}
+					if (dst - src <= _BPF_JMP_MAX)
+						continue;
+
+					/* insert a trampoline after the block */
+					if (i_blk >= blk_cnt ||
+					    !_gen_bpf_blk_sealed(state,
+								 b_iter)) {
+						rc = -EFAULT;
+						goto build_jmps_return;
+					}
+					b_new = _gen_bpf_tramp(state,
+							       blks[tgt]);
+					if (b_new == NULL) {
+						rc = -ENOMEM;
+						goto build_jmps_return;
+					}
+					b_new->prev = blks[i_blk]->prev;
+					b_new->next = blks[i_blk];
+					b_new->prev->next = b_new;
+					blks[i_blk]->prev = b_new;
+					tramp[grp] = i_blk;
+					_gen_bpf_ins_add(ins, blk_cnt, i_blk);
+					res_cnt++;
+					rc++;
+				}
+			}
+			/* recheck the block if we added any trampolines */
+			if (res_cnt == 0)
+				i_blk--;
+			added += res_cnt;
+		}
+	} while (added > 0);
+
+build_jmps_return:
+	free(blks);
+	free(off);
+	free(ins);
+	free(tramp);
+	free(pos);
+	return rc;
+}
+
+/**
+ * Resolve the instruction block jumps
+ * @param state the BPF state
+ * @param b_head the first instruction block
+ *
+ * Lay out the instruction blocks once, indexing the offset of each block by
+ * its hash value, and use the index to convert all of the TGT_PTR_HSH jumps
+ * into relative jumps.  Conditional jumps resolve to the first block with the
+ * target hash after the jumping block, unconditional jumps to the last block
+ * with the target hash.  Returns zero on success, negative values on failure.
+ *
+ */
+static int _gen_bpf_resolve_jmps(struct bpf_state *state,
+				 struct bpf_blk *b_head)
+{
+	int rc = 0;
+	int idx;
+	unsigned int iter;
+	unsigned int blk, blk_cnt = 0;
+	unsigned int src, jmp_len;
+	unsigned int *off = NULL;
+	struct bpf_blk_pos *pos = NULL;
+	struct bpf_blk *b_iter;
+	struct bpf_instr *i_iter;
+
+	/* lay out the blocks */
+	for (b_iter = b_head; b_iter != NULL; b_iter = b_iter->next)
+		blk_cnt++;
+	if (blk_cnt == 0)
+		return 0;
+	off = malloc(sizeof(*off) * blk_cnt);
+	pos = malloc(sizeof(*pos) * blk_cnt);
+	if (off == NULL || pos == NULL) {
+		rc = -ENOMEM;
+		goto resolve_jmps_return;
+	}
+	for (blk = 0, b_iter = b_head; b_iter != NULL;
+	     blk++, b_iter = b_iter->next) {
+		off[blk] = (blk == 0 ? 0 : off[blk - 1] + b_iter->prev->blk_cnt);
+		pos[blk].hash = b_iter->hash;
+		pos[blk].pos = blk;
+	}
+	qsort(pos, blk_cnt, sizeof(*pos), _gen_bpf_blk_pos_cmp);
+
+	/* resolve the jumps */
+	for (blk = 0, b_iter = b_head; b_iter != NULL;
+	     blk++, b_iter = b_iter->next) {
+		for (iter = 0; iter < b_iter->blk_cnt; iter++) {
+			i_iter = &b_iter->blks[iter];
+			src = off[blk] + iter + 1;
+			if (i_iter->jt.type == TGT_PTR_HSH) {
+				idx = _gen_bpf_blk_pos_find(pos, blk_cnt,
+							    i_iter->jt.tgt.hash,
+							    blk + 1);
+				if (idx < 0)
+					goto resolve_jmps_fault;
+				jmp_len = off[pos[idx].pos] - src;
+				if (jmp_len > _BPF_JMP_MAX)
+					goto resolve_jmps_fault;
+				i_iter->jt = _BPF_JMP_IMM(jmp_len);
+			}
+			if (i_iter->jf.type == TGT_PTR_HSH) {
+				idx = _gen_bpf_blk_pos_find(pos, blk_cnt,
+							    i_iter->jf.tgt.hash,
+							    blk + 1);
+				if (idx < 0)
+					goto resolve_jmps_fault;
+				jmp_len = off[pos[idx].pos] - src;
+				if (jmp_len > _BPF_JMP_MAX)
+					goto resolve_jmps_fault;
+				i_iter->jf = _BPF_JMP_IMM(jmp_len);
+			}
+			if (i_iter->k.type == TGT_PTR_HSH) {
+				idx = _gen_bpf_blk_pos_find(pos, blk_cnt,
+							    i_iter->k.tgt.hash,
+							    0);
+				if (idx < 0)
+					goto resolve_jmps_fault;
+				while ((unsigned int)idx + 1 < blk_cnt &&
+				       pos[idx + 1].hash == pos[idx].hash)
+					idx++;
+				if (pos[idx].pos <= blk)
+					goto resolve_jmps_fault;
+				jmp_len = off[pos[idx].pos] - src;
+				i_iter->k = _BPF_K(state->arch, jmp_len);
+			}
+		}
+	}
+
+resolve_jmps_return:
+	if (off != NULL)
+		free(off);
+	if (pos != NULL)
+		free(pos);
+	return rc;
+
+resolve_jmps_fault:
+	rc = -EFAULT;
+	goto resolve_jmps_return;
+}
+
+/**
+ * Remove instructions from the BPF program
+ * @param state the BPF state
+ * @param remove the instructions to remove
+ *
+ * Remove the flagged instructions from the BPF program and adjust the jumps of
+ * the remaining instructions to match.  A jump to a removed instruction is
+ * adjusted to target the next remaining instruction, it is up to the caller to
+ * ensure that is correct.  Returns the number of instructions removed on
+ * success, negative values on failure.
+ *
+ */
+static int _gen_bpf_compact(struct bpf_state *state, const bool *remove)
+{
+	int rc = 0;
+	unsigned int iter, blk_cnt = state->bpf->blk_cnt;
+	uint16_t code;
+	uint32_t k;
+	unsigned int *pos;
+	bpf_instr_raw *i_iter;
+
+	pos = zmalloc(sizeof(*pos) * (blk_cnt + 1));
+	if (pos == NULL)
+		return -ENOMEM;
+
+	/* calculate the new instruction positions, a removed instruction
+	 * takes the position of the next instruction */
+	for (iter = 0; iter < blk_cnt; iter++) {
+		pos[iter + 1] = pos[iter] + (remove[iter] ? 0 : 1);
+		if (remove[iter])
+			rc++;
+	}
+	if (rc == 0)
+		goto compact_return;
+
+	/* fixup the jumps and compact the program */
+	for (iter = 0; iter < blk_cnt; iter++) {
+		if (remove[iter])
+			continue;
+		i_iter = &state->bpf->blks[iter];
+		code = _ttoh16(state->arch, i_iter->code);
+		if (BPF_CLASS(code) == BPF_JMP) {
+			if (BPF_OP(code) == BPF_JA) {
+				k = _ttoh32(state->arch, i_iter->k);
+				k = pos[iter + 1 + k] - pos[iter] - 1;
+				i_iter->k = _htot32(state->arch, k);
+			} else {
+				i_iter->jt = pos[iter + 1 + i_iter->jt] -
+					     pos[iter] - 1;
+				i_iter->jf = pos[iter + 1 + i_iter->jf] -
+					     pos[iter] - 1;
+			}
+		}
+		state->bpf->blks[pos[iter]] = *i_iter;
+	}
+	state->bpf->blk_cnt = pos[blk_cnt];
+
+compact_return:
+	free(pos);
+	return rc;
+}
+
+/**
+ * Determine the effect of a BPF instruction on the accumulator
+ * @param state the BPF state
+ * @param instr the BPF instruction
+ * @param a_state the accumulator state
+ *
+ * Update the accumulator state to reflect the execution of the given BPF
+ * instruction.  Returns true if the instruction leaves the accumulator
+ * unchanged and has no other side effects, false otherwise.
+ *
+ */
+static bool _gen_bpf_acc_step(const struct bpf_state *state,
+			      const bpf_instr_raw *instr,
+			      struct acc_state *a_state)
+{
+	uint16_t code = _ttoh16(state->arch, instr->code);
+	uint32_t k = _ttoh32(state->arch, instr->k);
+
+	switch (BPF_CLASS(code)) {
+	case BPF_LD:
+		if (code == (BPF_LD + BPF_ABS)) {
+			if (_ACC_CMP_EQ(*a_state, _ACC_STATE_OFFSET(k)))
+				return true;
+			*a_state = _ACC_STATE_OFFSET(k);
+		} else
+			*a_state = _ACC_STATE_UNDEF;
+		break;
+	case BPF_ALU:
+		if (code == (BPF_ALU + BPF_AND) && a_state->offset != -1) {
+			if ((a_state->mask & k) == a_state->mask)
+				return true;
+			a_state->mask &= k;
+		} else
+			*a_state = _ACC_STATE_UNDEF;
+		break;
+	case BPF_MISC:
+		if (BPF_MISCOP(code) == BPF_TXA)
+			*a_state = _ACC_STATE_UNDEF;
+		break;
+	default:
+		/* the accumulator is left untouched */
+		break;
+	}
+
+	return false;
+}
+
+/**
+ * Thread a jump past any redundant accumulator loads
+ * @param state the BPF state
+ * @param pos the position of the jump instruction
+ * @param off the jump offset
+ * @param off_max the maximum jump offset
+ * @param a_state the accumulator state along the jump
+ *
+ * Advance the jump offset past any instructions at the jump target which would
+ * leave the accumulator unchanged given the accumulator state along the jump.
+ * Returns the new jump offset.
+ *
+ */
+static uint32_t _gen_bpf_acc_thread(const struct bpf_state *state,
+				    unsigned int pos, uint32_t off,
+				    uint32_t off_max,
+				    const struct acc_state *a_state)
+{
+	struct acc_state a_tmp;
+	unsigned int tgt = pos + 1 + off;
+
+	while (off < off_max && tgt + 1 < state->bpf->blk_cnt) {
+		a_tmp = *a_state;
+		if (!_gen_bpf_acc_step(state, &state->bpf->blks[tgt], &a_tmp))
+			break;
+		off++;
+		tgt++;
+	}
+
+	return off;
+}
+
+/**
+ * Merge an accumulator state into a BPF instruction's incoming state
+ * @param acc the incoming accumulator states
+ * @param acc_seen the incoming accumulator state valid flags
+ * @param pos the BPF instruction
+ * @param a_state the accumulator state along the new incoming edge
+ *
+ * The accumulator state is only known at an instruction if it is the same
+ * along every incoming edge, otherwise it is undefined.
+ *
+ */
+static void _gen_bpf_acc_merge(struct acc_state *acc, bool *acc_seen,
+			       unsigned int pos,
+			       const struct acc_state *a_state)
+{
+	if (!acc_seen[pos]) {
+		acc[pos] = *a_state;
+		acc_seen[pos] = true;
+	} else if (!_ACC_CMP_EQ(acc[pos], *a_state))
+		acc[pos] = _ACC_STATE_UNDEF;
+}
+
+/**
+ * Fold a conditional jump on a zero accumulator
+ * @param state the BPF state
+ * @param instr the BPF conditional jump instruction
+ *
+ * Evaluate the conditional jump assuming a zero accumulator, which is the case
+ * after a BPF_ALU+BPF_AND with a zero mask, and point both branches of the
+ * jump at the branch which is always taken.
+ *
+ */
+static void _gen_bpf_acc_fold(const struct bpf_state *state,
+			      bpf_instr_raw *instr)
+{
+	uint16_t code = _ttoh16(state->arch, instr->code);
+	uint32_t k = _ttoh32(state->arch, instr->k);
+	bool taken;
+
+	if (BPF_SRC(code) != BPF_K)
+		return;
+
+	switch (BPF_OP(code)) {
+	case BPF_JEQ:
+	case BPF_JGE:
+		taken = (k == 0);
+		break;
+	case BPF_JGT:
+	case BPF_JSET:
+		taken = false;
+		break;
+	default:
+		return;
 	}
 
-	return blk_s;
+	if (taken)
+		instr->jf = instr->jt;
+	else
+		instr->jt = instr->jf;
 }
 
 /**
- * Generate the BPF instruction blocks for a given filter/architecture
+ * Remove redundant accumulator loads from the BPF program
  * @param state the BPF state
- * @param db the filter DB
- * @param db_secondary the secondary DB
  *
- * Generate the BPF instruction block for the given filter DB(s)/architecture(s)
- * and return a pointer to the block on succes, NULL on failure.  The resulting
- * block assumes that the architecture token has already been loaded into the
- * BPF accumulator.
+ * Perform a forward dataflow analysis over the BPF program to determine the
+ * accumulator state on entry to each instruction.  Jumps are threaded past any
+ * BPF_LD+BPF_ABS and BPF_ALU+BPF_AND instructions which would leave the
+ * accumulator unchanged along the jump, and conditional jumps on a known zero
+ * accumulator are resolved, after which any such instructions which are
+ * redundant along every incoming edge, as well as any unreachable
+ * instructions, are removed.  BPF only allows forward jumps so a single pass
+ * in program order is sufficient.  Returns the number of instructions removed
+ * on success, negative values on failure.
  *
  */
-static struct bpf_blk *_gen_bpf_arch(struct bpf_state *state,
-				     const struct db_filter *db,
-				     const struct db_filter *db_secondary)
+static int _gen_bpf_acc_opt(struct bpf_state *state)
 {
-	int rc;
-	unsigned int blk_cnt = 0;
-	bool acc_reset;
-	struct bpf_instr instr;
-	struct db_sys_list *s_head = NULL, *s_tail = NULL, *s_iter, *s_iter_b;
-	struct bpf_blk *b_head = NULL, *b_tail = NULL, *b_iter, *b_new;
+	int rc = 0;
+	unsigned int iter, blk_cnt = state->bpf->blk_cnt;
+	uint16_t code;
+	uint32_t k;
+	bool *acc_seen = NULL, *remove = NULL;
+	struct acc_state *acc = NULL, a_state;
+	bpf_instr_raw *i_iter;
 
-	state->arch = db->arch;
+	if (blk_cnt == 0)
+		return 0;
 
-	/* sort the syscall list */
-	db_list_foreach(s_iter, db->syscalls) {
-		if (s_head != NULL) {
-			s_iter_b = s_head;
-			while ((s_iter_b->pri_nxt != NULL) &&
-			       (s_iter->priority <= s_iter_b->priority))
-				s_iter_b = s_iter_b->pri_nxt;
-
-			if (s_iter->priority > s_iter_b->priority) {
-				s_iter->pri_prv = s_iter_b->pri_prv;
-				s_iter->pri_nxt = s_iter_b;
-				if (s_iter_b == s_head) {
-					s_head->pri_prv = s_iter;
-					s_head = s_iter;
-				} else {
-					s_iter->pri_prv->pri_nxt = s_iter;
-					s_iter->pri_nxt->pri_prv = s_iter;
-				}
-			} else {
-				s_iter->pri_prv = s_tail;
-				s_iter->pri_nxt = NULL;
-				s_iter->pri_prv->pri_nxt = s_iter;
-				s_tail = s_iter;
-			}
-		} else {
-			s_head = s_iter;
-			s_tail = s_iter;
-			s_head->pri_prv = NULL;
-			s_head->pri_nxt = NULL;
-		}
+	acc = zmalloc(sizeof(*acc) * blk_cnt);
+	acc_seen = zmalloc(sizeof(*acc_seen) * blk_cnt);
+	remove = zmalloc(sizeof(*remove) * blk_cnt);
+	if (acc == NULL || acc_seen == NULL || remove == NULL) {
+		rc = -ENOMEM;
+		goto acc_opt_return;
 	}
-	if (db_secondary != NULL) {
-		db_list_foreach(s_iter, db_secondary->syscalls) {
-			if (s_head != NULL) {
-				s_iter_b = s_head;
-				while ((s_iter_b->pri_nxt != NULL) &&
-				       (s_iter->priority <= s_iter_b->priority))
-					s_iter_b = s_iter_b->pri_nxt;
-
-				if (s_iter->priority > s_iter_b->priority) {
-					s_iter->pri_prv = s_iter_b->pri_prv;
-					s_iter->pri_nxt = s_iter_b;
-					if (s_iter_b == s_head) {
-						s_head->pri_prv = s_iter;
-						s_head = s_iter;
-					} else {
-						s_iter->pri_prv->pri_nxt =
-							s_iter;
-						s_iter->pri_nxt->pri_prv =
-							s_iter;
-					}
-				} else {
-					s_iter->pri_prv = s_tail;
-					s_iter->pri_nxt = NULL;
-					s_iter->pri_prv->pri_nxt = s_iter;
-					s_tail = s_iter;
+	acc[0] = _ACC_STATE_UNDEF;
+	acc_seen[0] = true;
+
+	/* determine the accumulator state at each instruction */
+	for (iter = 0; iter < blk_cnt; iter++) {
+		if (!acc_seen[iter]) {
+			/* unreachable */
+			remove[iter] = true;
+			continue;
+		}
+		i_iter = &state->bpf->blks[iter];
+		code = _ttoh16(state->arch, i_iter->code);
+		k = _ttoh32(state->arch, i_iter->k);
+		a_state = acc[iter];
+
+		if (BPF_CLASS(code) == BPF_RET)
+			continue;
+		if (BPF_CLASS(code) == BPF_JMP) {
+			if (BPF_OP(code) == BPF_JA) {
+				k = _gen_bpf_acc_thread(state, iter, k,
+							UINT32_MAX, &a_state);
+				if (iter + 1 + k >= blk_cnt) {
+					rc = -EFAULT;
+					goto acc_opt_return;
 				}
-			} else {
-				s_head = s_iter;
-				s_tail = s_iter;
-				s_head->pri_prv = NULL;
-				s_head->pri_nxt = NULL;
+				i_iter->k = _htot32(state->arch, k);
+				_gen_bpf_acc_merge(acc, acc_seen,
+						   iter + 1 + k, &a_state);
+				continue;
 			}
+			if (a_state.offset != -1 && a_state.mask == 0)
+				_gen_bpf_acc_fold(state, i_iter);
+			i_iter->jt = _gen_bpf_acc_thread(state, iter,
+							 i_iter->jt,
+							 _BPF_JMP_MAX,
+							 &a_state);
+			i_iter->jf = _gen_bpf_acc_thread(state, iter,
+							 i_iter->jf,
+							 _BPF_JMP_MAX,
+							 &a_state);
+			if (iter + 1 + i_iter->jt >= blk_cnt ||
+			    iter + 1 + i_iter->jf >= blk_cnt) {
+				rc = -EFAULT;
+				goto acc_opt_return;
+			}
+			_gen_bpf_acc_merge(acc, acc_seen,
+					   iter + 1 + i_iter->jt, &a_state);
+			_gen_bpf_acc_merge(acc, acc_seen,
+					   iter + 1 + i_iter->jf, &a_state);
+			continue;
+		}
+
+		if (_gen_bpf_acc_step(state, i_iter, &a_state))
+			remove[iter] = true;
+		if (iter + 1 >= blk_cnt) {
+			rc = -EFAULT;
+			goto acc_opt_return;
 		}
+		_gen_bpf_acc_merge(acc, acc_seen, iter + 1, &a_state);
 	}
 
-	if ((state->arch->token == SCMP_ARCH_X86_64 ||
-	     state->arch->token == SCMP_ARCH_X32) && (db_secondary == NULL))
-		acc_reset = false;
-	else
-		acc_reset = true;
+	/* remove the instructions */
+	rc = _gen_bpf_compact(state, remove);
 
-	/* create the syscall filters and add them to block list group */
-	for (s_iter = s_tail; s_iter != NULL; s_iter = s_iter->pri_prv) {
-		if (!s_iter->valid)
-			continue;
+acc_opt_return:
+	free(acc);
+	free(acc_seen);
+	free(remove);
+	return rc;
+}
 
-		/* build the syscall filter */
-		b_new = _gen_bpf_syscall(state, s_iter,
-					 (b_head == NULL ?
-					  state->def_hsh : b_head->hash),
-					 (s_iter == s_head ?
-					  acc_reset : false));
-		if (b_new == NULL)
-			goto arch_failure;
+/**
+ * Find the final destination of a jump
+ * @param state the BPF state
+ * @param tgt the jump target
+ * @param tgt_max the furthest allowed jump target
+ *
+ * Follow any unconditional jumps at the jump target, and if the jump lands on
+ * a return instruction, move the target to the last identical return
+ * instruction in range so that any duplicates can be removed.  Returns the new
+ * jump target.
+ *
+ */
+static unsigned int _gen_bpf_peep_tgt(const struct bpf_state *state,
+				      unsigned int tgt, unsigned int tgt_max)
+{
+	const bpf_instr_raw *blks = state->bpf->blks;
+	unsigned int iter;
+	uint16_t code;
+	uint32_t k;
 
-		/* add the filter to the list head */
-		b_new->prev = NULL;
-		b_new->next = b_head;
-		if (b_tail != NULL) {
-			b_head->prev = b_new;
-			b_head = b_new;
-		} else {
-			b_head = b_new;
-			b_tail = b_head;
-		}
+	if (tgt_max >= state->bpf->blk_cnt)
+		tgt_max = state->bpf->blk_cnt - 1;
 
-		if (b_tail->next != NULL)
-			b_tail = b_tail->next;
-		blk_cnt++;
+	while (tgt < tgt_max) {
+		code = _ttoh16(state->arch, blks[tgt].code);
+		if (code == (BPF_JMP + BPF_JA)) {
+			k = _ttoh32(state->arch, blks[tgt].k);
+			if (k >= tgt_max - tgt)
+				break;
+			tgt += 1 + k;
+			continue;
+		}
+		if (BPF_CLASS(code) == BPF_RET) {
+			for (iter = tgt_max; iter > tgt; iter--) {
+				if (blks[iter].code == blks[tgt].code &&
+				    blks[iter].k == blks[tgt].k) {
+					tgt = iter;
+					break;
+				}
+			}
+		}
+		break;
 	}
 
-	/* additional ABI filtering */
-	if ((state->arch->token == SCMP_ARCH_X86_64 ||
-	     state->arch->token == SCMP_ARCH_X32) && (db_secondary == NULL)) {
-		_BPF_INSTR(instr, _BPF_OP(state->arch, BPF_LD + BPF_ABS),
-			   _BPF_JMP_NO, _BPF_JMP_NO, _BPF_SYSCALL(state->arch));
-		b_new = _blk_append(state, NULL, &instr);
-		if (b_new == NULL)
-			goto arch_failure;
-		b_new->acc_end = _ACC_STATE_OFFSET(_BPF_OFFSET_SYSCALL);
-		if (state->arch->token == SCMP_ARCH_X86_64) {
-			/* filter out x32 */
-			_BPF_INSTR(instr,
-				   _BPF_OP(state->arch, BPF_JMP + BPF_JGE),
-				   _BPF_JMP_NO,
-				   _BPF_JMP_NO,
-				   _BPF_K(state->arch, X32_SYSCALL_BIT));
-			if (b_head != NULL)
-				instr.jf = _BPF_JMP_HSH(b_head->hash);
-			else
-				instr.jf = _BPF_JMP_HSH(state->def_hsh);
-			b_new = _blk_append(state, b_new, &instr);
-			if (b_new == NULL)
-				goto arch_failure;
-			/* NOTE: starting with Linux v4.8 the seccomp filters
-			 *	 are processed both when the syscall is
-			 *	 initially executed as well as after any
-			 *	 tracing processes finish so we need to make
-			 *	 sure we don't trap the -1 syscall which
-			 *	 tracers can use to skip the syscall, see
-			 *	 seccomp(2) for more information */
-			_BPF_INSTR(instr,
-				   _BPF_OP(state->arch, BPF_JMP + BPF_JEQ),
-				   _BPF_JMP_NO,
-				   _BPF_JMP_HSH(state->bad_arch_hsh),
-				   _BPF_K(state->arch, -1));
-			if (b_head != NULL)
-				instr.jt = _BPF_JMP_HSH(b_head->hash);
-			else
-				instr.jt = _BPF_JMP_HSH(state->def_hsh);
-			blk_cnt++;
-		} else if (state->arch->token == SCMP_ARCH_X32) {
-			/* filter out x86_64 */
-			_BPF_INSTR(instr,
-				   _BPF_OP(state->arch, BPF_JMP + BPF_JGE),
-				   _BPF_JMP_NO,
-				   _BPF_JMP_HSH(state->bad_arch_hsh),
-				   _BPF_K(state->arch, X32_SYSCALL_BIT));
-			if (b_head != NULL)
-				instr.jt = _BPF_JMP_HSH(b_head->hash);
-			else
-				instr.jt = _BPF_JMP_HSH(state->def_hsh);
-			blk_cnt++;
-		} else
-			/* we should never get here */
-			goto arch_failure;
-		b_new = _blk_append(state, b_new, &instr);
-		if (b_new == NULL)
-			goto arch_failure;
-		b_new->next = b_head;
-		if (b_head != NULL)
-			b_head->prev = b_new;
-		b_head = b_new;
-		rc = _hsh_add(state, &b_head, 1);
-		if (rc < 0)
-			goto arch_failure;
-	}
+	return tgt;
+}
 
-	/* do the ABI/architecture check */
-	_BPF_INSTR(instr, _BPF_OP(state->arch, BPF_JMP + BPF_JEQ),
-		   _BPF_JMP_NO, _BPF_JMP_NXT(blk_cnt++),
-		   _BPF_K(state->arch, state->arch->token_bpf));
-	if (b_head != NULL)
-		instr.jt = _BPF_JMP_HSH(b_head->hash);
-	else
-		instr.jt = _BPF_JMP_HSH(state->def_hsh);
-	b_new = _blk_append(state, NULL, &instr);
-	if (b_new == NULL)
-		goto arch_failure;
-	b_new->next = b_head;
-	if (b_head != NULL)
-		b_head->prev = b_new;
-	b_head = b_new;
-	rc = _hsh_add(state, &b_head, 1);
-	if (rc < 0)
-		goto arch_failure;
+/**
+ * Compare two BPF instructions as part of two instruction sequences
+ * @param state the BPF state
+ * @param i_a the instruction in the first sequence
+ * @param i_b the instruction in the second sequence
+ * @param end_a the last instruction in the first sequence
+ *
+ * Two instructions are equivalent if they are identical and any jumps either
+ * land on the same instruction outside the sequences or on the same relative
+ * position inside the sequences.  Instructions which do not continue on to the
+ * rest of the sequence are never equivalent.  Returns true if the instructions
+ * are equivalent, false otherwise.
+ *
+ */
+static bool _gen_bpf_peep_equal(const struct bpf_state *state,
+				unsigned int i_a, unsigned int i_b,
+				unsigned int end_a)
+{
+	const bpf_instr_raw *a = &state->bpf->blks[i_a];
+	const bpf_instr_raw *b = &state->bpf->blks[i_b];
+	uint16_t code;
+
+	if (a->code != b->code || a->k != b->k)
+		return false;
+
+	code = _ttoh16(state->arch, a->code);
+	if (BPF_CLASS(code) == BPF_RET)
+		return false;
+	if (BPF_CLASS(code) != BPF_JMP)
+		return true;
+	if (BPF_OP(code) == BPF_JA)
+		return false;
+
+	if (i_a + 1 + a->jt <= end_a) {
+		if (a->jt != b->jt)
+			return false;
+	} else if (i_a + a->jt != i_b + b->jt)
+		return false;
+	if (i_a + 1 + a->jf <= end_a) {
+		if (a->jf != b->jf)
+			return false;
+	} else if (i_a + a->jf != i_b + b->jf)
+		return false;
+
+	return true;
+}
 
-	state->arch = NULL;
-	return b_head;
+/**
+ * Redirect the jumps into a BPF instruction sequence
+ * @param state the BPF state
+ * @param start_a the first instruction in the old sequence
+ * @param end_a the last instruction in the old sequence
+ * @param start_b the first instruction in the new sequence
+ * @param apply true to redirect the jumps, false to only check them
+ *
+ * Redirect any jumps into the middle of the old sequence, from outside the
+ * sequence, to the matching instruction in the new sequence.  Returns true if
+ * all of the jumps can be redirected, false otherwise.
+ *
+ */
+static bool _gen_bpf_peep_redirect(struct bpf_state *state,
+				   unsigned int start_a, unsigned int end_a,
+				   unsigned int start_b, bool apply)
+{
+	unsigned int iter, tgt;
+	uint16_t code;
+	uint32_t k;
+	bpf_instr_raw *i_iter;
 
-arch_failure:
-	/* NOTE: we do the cleanup here and not just return an error as all of
-	 * the instruction blocks may not be added to the hash table when we
-	 * hit an error */
-	state->arch = NULL;
-	b_iter = b_head;
-	while (b_iter != NULL) {
-		b_new = b_iter->next;
-		_blk_free(state, b_iter);
-		b_iter = b_new;
+	for (iter = 0; iter < start_a; iter++) {
+		i_iter = &state->bpf->blks[iter];
+		code = _ttoh16(state->arch, i_iter->code);
+		if (BPF_CLASS(code) != BPF_JMP)
+			continue;
+
+		if (BPF_OP(code) == BPF_JA) {
+			k = _ttoh32(state->arch, i_iter->k);
+			tgt = iter + 1 + k;
+			if (tgt > start_a && tgt <= end_a && apply)
+				i_iter->k = _htot32(state->arch,
+						    k + start_b - start_a);
+			continue;
+		}
+
+		tgt = iter + 1 + i_iter->jt;
+		if (tgt > start_a && tgt <= end_a) {
+			if (i_iter->jt + start_b - start_a > _BPF_JMP_MAX)
+				return false;
+			if (apply)
+				i_iter->jt += start_b - start_a;
+		}
+		tgt = iter + 1 + i_iter->jf;
+		if (tgt > start_a && tgt <= end_a) {
+			if (i_iter->jf + start_b - start_a > _BPF_JMP_MAX)
+				return false;
+			if (apply)
+				i_iter->jf += start_b - start_a;
+		}
 	}
-	return NULL;
+
+	return true;
 }
 
 /**
- * Find the target block for the "next" jump
- * @param blk the instruction block
- * @param nxt the next offset
+ * Merge a duplicated tail in the BPF program
+ * @param state the BPF state
  *
- * Find the target block for the TGT_NXT jump using the given offset.  Returns
- * a pointer to the target block on success or NULL on failure.
+ * Search for two identical instruction sequences which end with the same
+ * return instruction and replace the earlier sequence with an unconditional
+ * jump to the later sequence; the rest of the earlier sequence is left
+ * unreachable.  Only a single tail is merged on each call.  Returns true if a
+ * tail was merged, false otherwise.
  *
  */
-static struct bpf_blk *_gen_bpf_find_nxt(const struct bpf_blk *blk,
-					 unsigned int nxt)
+static bool _gen_bpf_peep_tail(struct bpf_state *state)
 {
-	struct bpf_blk *iter = blk->next;
+	bpf_instr_raw *blks = state->bpf->blks;
+	unsigned int blk_cnt = state->bpf->blk_cnt;
+	unsigned int r_a, r_b, len, start_a, start_b;
 
-	for (; (iter != NULL) && (nxt > 0); nxt--)
-		iter = iter->next;
+	for (r_a = 0; r_a < blk_cnt; r_a++) {
+		if (BPF_CLASS(_ttoh16(state->arch, blks[r_a].code)) != BPF_RET)
+			continue;
+		for (r_b = r_a + 1; r_b < blk_cnt; r_b++) {
+			if (blks[r_b].code != blks[r_a].code ||
+			    blks[r_b].k != blks[r_a].k)
+				continue;
 
-	return iter;
+			len = 1;
+			while (len <= r_a && r_b - len > r_a &&
+			       _gen_bpf_peep_equal(state,
+						   r_a - len, r_b - len, r_a))
+				len++;
+			if (len < 2)
+				continue;
+
+			start_a = r_a - len + 1;
+			start_b = r_b - len + 1;
+			if (!_gen_bpf_peep_redirect(state,
+						    start_a, r_a, start_b,
+						    false))
+				continue;
+			_gen_bpf_peep_redirect(state,
+					       start_a, r_a, start_b, true);
+			memset(&blks[start_a], 0, sizeof(blks[start_a]));
+			blks[start_a].code = _htot16(state->arch,
+						     BPF_JMP + BPF_JA);
+			blks[start_a].k = _htot32(state->arch,
+						  start_b - start_a - 1);
+			return true;
+		}
+	}
+
+	return false;
 }
 
 /**
- * Manage jumps to return instructions
+ * Perform peephole optimizations on the BPF program
  * @param state the BPF state
- * @param blk the instruction block to check
- * @param offset the instruction offset into the instruction block
- * @param blk_ret the return instruction block
  *
- * Using the given block and instruction offset, calculate the jump distance
- * between the jumping instruction and return instruction block.  If the jump
- * distance is too great, duplicate the return instruction to reduce the
- * distance to the maximum value.  Returns 1 if a long jump was added, zero if
- * the existing jump is valid, and negative values on failure.
+ * Thread jumps through unconditional jumps, point jumps at the last identical
+ * return instruction in range, replace unconditional jumps to a return
+ * instruction with the return instruction itself, and turn conditional jumps
+ * with identical targets into unconditional jumps.  A single duplicated tail
+ * is then merged, after which any unreachable instructions, any jumps to the
+ * next instruction, and any accumulator updates which are never used are
+ * removed.  Returns the number of instructions
+ * removed on success, negative values on failure.
  *
  */
-static int _gen_bpf_build_jmp_ret(struct bpf_state *state,
-				  struct bpf_blk *blk, unsigned int offset,
-				  struct bpf_blk *blk_ret)
+static int _gen_bpf_peephole(struct bpf_state *state)
 {
-	unsigned int j_len;
-	uint64_t tgt_hash = blk_ret->hash;
-	struct bpf_blk *b_jmp, *b_new;
+	int rc = 0;
+	unsigned int iter, tgt, jt, jf, blk_cnt = state->bpf->blk_cnt;
+	uint16_t code;
+	uint32_t k;
+	bool *reach = NULL, *live = NULL, *remove = NULL;
+	bpf_instr_raw *i_iter;
 
-	/* calculate the jump distance */
-	j_len = blk->blk_cnt - (offset + 1);
-	b_jmp = blk->next;
-	while (b_jmp != NULL && b_jmp != blk_ret && j_len < _BPF_JMP_MAX_RET) {
-		j_len += b_jmp->blk_cnt;
-		b_jmp = b_jmp->next;
-	}
-	if (b_jmp == NULL)
-		return -EFAULT;
-	if (j_len <= _BPF_JMP_MAX_RET && b_jmp == blk_ret)
+	if (blk_cnt == 0)
 		return 0;
 
-	/* we need a closer return instruction, see if one already exists */
-	j_len = blk->blk_cnt - (offset + 1);
-	b_jmp = blk->next;
-	while (b_jmp != NULL && b_jmp->hash != tgt_hash &&
-	       j_len < _BPF_JMP_MAX_RET) {
-		j_len += b_jmp->blk_cnt;
-		b_jmp = b_jmp->next;
+	reach = zmalloc(sizeof(*reach) * blk_cnt);
+	live = zmalloc(sizeof(*live) * (blk_cnt + 1));
+	remove = zmalloc(sizeof(*remove) * blk_cnt);
+	if (reach == NULL || live == NULL || remove == NULL) {
+		rc = -ENOMEM;
+		goto peephole_return;
+	}
+
+	/* thread the jumps */
+	for (iter = 0; iter < blk_cnt; iter++) {
+		i_iter = &state->bpf->blks[iter];
+		code = _ttoh16(state->arch, i_iter->code);
+		if (BPF_CLASS(code) != BPF_JMP)
+			continue;
+
+		if (BPF_OP(code) == BPF_JA) {
+			k = _ttoh32(state->arch, i_iter->k);
+			if (k >= blk_cnt - iter - 1) {
+				rc = -EFAULT;
+				goto peephole_return;
+			}
+			tgt = _gen_bpf_peep_tgt(state, iter + 1 + k, blk_cnt);
+			code = _ttoh16(state->arch, state->bpf->blks[tgt].code);
+			if (BPF_CLASS(code) == BPF_RET)
+				*i_iter = state->bpf->blks[tgt];
+			else
+				i_iter->k = _htot32(state->arch,
+						    tgt - iter - 1);
+			continue;
+		}
+
+		if (iter + 1 + i_iter->jt >= blk_cnt ||
+		    iter + 1 + i_iter->jf >= blk_cnt) {
+			rc = -EFAULT;
+			goto peephole_return;
+		}
+		jt = _gen_bpf_peep_tgt(state, iter + 1 + i_iter->jt,
+				       iter + 1 + _BPF_JMP_MAX) - iter - 1;
+		jf = _gen_bpf_peep_tgt(state, iter + 1 + i_iter->jf,
+				       iter + 1 + _BPF_JMP_MAX) - iter - 1;
+		if (jt == jf) {
+			/* both branches lead to the same place */
+			memset(i_iter, 0, sizeof(*i_iter));
+			i_iter->code = _htot16(state->arch, BPF_JMP + BPF_JA);
+			i_iter->k = _htot32(state->arch, jt);
+		} else {
+			i_iter->jt = jt;
+			i_iter->jf = jf;
+		}
+	}
+
+	/* merge a duplicated tail */
+	_gen_bpf_peep_tail(state);
+
+	/* find the unreachable instructions and no-op jumps */
+	reach[0] = true;
+	for (iter = 0; iter < blk_cnt; iter++) {
+		if (!reach[iter]) {
+			remove[iter] = true;
+			continue;
+		}
+		i_iter = &state->bpf->blks[iter];
+		code = _ttoh16(state->arch, i_iter->code);
+
+		if (BPF_CLASS(code) == BPF_RET)
+			continue;
+		if (BPF_CLASS(code) == BPF_JMP) {
+			if (BPF_OP(code) == BPF_JA) {
+				k = _ttoh32(state->arch, i_iter->k);
+				reach[iter + 1 + k] = true;
+				if (k == 0)
+					remove[iter] = true;
+			} else {
+				reach[iter + 1 + i_iter->jt] = true;
+				reach[iter + 1 + i_iter->jf] = true;
+			}
+			continue;
+		}
+		if (iter + 1 >= blk_cnt) {
+			rc = -EFAULT;
+			goto peephole_return;
+		}
+		reach[iter + 1] = true;
 	}
-	if (b_jmp == NULL)
-		return -EFAULT;
-	if (j_len <= _BPF_JMP_MAX_RET && b_jmp->hash == tgt_hash)
-		return 0;
 
-	/* we need to insert a new return instruction - create one */
-	b_new = _gen_bpf_action(state, NULL, blk_ret->blks[0].k.tgt.imm_k);
-	if (b_new == NULL)
-		return -EFAULT;
+	/* find the accumulator updates which are never used, BPF only allows
+	 * forward jumps so a single backwards pass is sufficient */
+	for (iter = blk_cnt; iter-- > 0; ) {
+		i_iter = &state->bpf->blks[iter];
+		code = _ttoh16(state->arch, i_iter->code);
 
-	/* NOTE - we need to be careful here, we're giving the block a hash
-	 *	  value (this is a sneaky way to ensure we leverage the
-	 *	  inserted long jumps as much as possible) but we never add the
-	 *	  block to the hash table so it won't get cleaned up
-	 *	  automatically */
-	b_new->hash = tgt_hash;
+		switch (BPF_CLASS(code)) {
+		case BPF_RET:
+			live[iter] = (BPF_RVAL(code) == BPF_A);
+			break;
+		case BPF_JMP:
+			if (BPF_OP(code) == BPF_JA) {
+				k = _ttoh32(state->arch, i_iter->k);
+				live[iter] = live[iter + 1 + k];
+			} else
+				live[iter] = true;
+			break;
+		case BPF_LD:
+			if (!live[iter + 1])
+				remove[iter] = true;
+			live[iter] = false;
+			break;
+		case BPF_ALU:
+			if (BPF_SRC(code) == BPF_K && !live[iter + 1]) {
+				remove[iter] = true;
+				live[iter] = false;
+			} else
+				live[iter] = true;
+			break;
+		case BPF_MISC:
+			if (BPF_MISCOP(code) == BPF_TXA) {
+				if (!live[iter + 1])
+					remove[iter] = true;
+				live[iter] = false;
+			} else
+				live[iter] = true;
+			break;
+		case BPF_ST:
+			live[iter] = true;
+			break;
+		default:
+			live[iter] = live[iter + 1];
+			break;
+		}
+	}
 
-	/* insert the jump after the current jumping block */
-	b_new->prev = blk;
-	b_new->next = blk->next;
-	blk->next->prev = b_new;
-	blk->next = b_new;
+	/* remove the instructions */
+	rc = _gen_bpf_compact(state, remove);
 
-	return 1;
+peephole_return:
+	free(reach);
+	free(live);
+	free(remove);
+	return rc;
 }
 
 /**
- * Manage jump lengths by duplicating and adding jumps if needed
+ * Optimize the BPF program
  * @param state the BPF state
- * @param tail the tail of the instruction block list
- * @param blk the instruction block to check
- * @param offset the instruction offset into the instruction block
- * @param tgt_hash the hash of the jump destination block
  *
- * Using the given block and instruction offset, calculate the jump distance
- * between the jumping instruction and the destination.  If the jump distance
- * is too great, add a long jump instruction to reduce the distance to a legal
- * value.  Returns 1 if a new instruction was added, zero if the existing jump
- * is valid, and negative values on failure.
+ * Remove the redundant accumulator loads from the BPF program and, if the
+ * peephole optimizer is enabled, repeatedly run the peephole and accumulator
+ * optimizations until the peephole optimizer is unable to remove any more
+ * instructions.  Returns the number of instructions removed by the peephole
+ * optimizer on success, negative values on failure.
  *
  */
-static int _gen_bpf_build_jmp(struct bpf_state *state,
-			      struct bpf_blk *tail,
-			      struct bpf_blk *blk, unsigned int offset,
-			      uint64_t tgt_hash)
+static int _gen_bpf_optimize(struct bpf_state *state)
 {
-	int rc;
-	unsigned int jmp_len;
-	struct bpf_instr instr;
-	struct bpf_blk *b_new, *b_jmp, *b_tgt;
-
-	/* find the jump target */
-	b_tgt = tail;
-	while (b_tgt != blk && b_tgt->hash != tgt_hash)
-		b_tgt = b_tgt->prev;
-	if (b_tgt == blk)
-		return -EFAULT;
-
-	if (b_tgt->blk_cnt == 1 &&
-	    b_tgt->blks[0].op == _BPF_OP(state->arch, BPF_RET)) {
-		rc = _gen_bpf_build_jmp_ret(state, blk, offset, b_tgt);
-		if (rc == 1)
-			return 1;
-		else if (rc < 0)
-			return rc;
-	}
+	int rc, cnt = 0;
 
-	/* calculate the jump distance */
-	jmp_len = blk->blk_cnt - (offset + 1);
-	b_jmp = blk->next;
-	while (b_jmp != NULL && b_jmp != b_tgt && jmp_len < _BPF_JMP_MAX) {
-		jmp_len += b_jmp->blk_cnt;
-		b_jmp = b_jmp->next;
-	}
-	if (b_jmp == NULL)
-		return -EFAULT;
-	if (jmp_len <= _BPF_JMP_MAX && b_jmp == b_tgt)
+	/* remove any redundant accumulator loads */
+	rc = _gen_bpf_acc_opt(state);
+	if (rc < 0)
+		return rc;
+	if (!state->attr->peephole)
 		return 0;
 
-	/* we need a long jump, see if one already exists */
-	jmp_len = blk->blk_cnt - (offset + 1);
-	b_jmp = blk->next;
-	while (b_jmp != NULL && b_jmp->hash != tgt_hash &&
-	       jmp_len < _BPF_JMP_MAX) {
-		jmp_len += b_jmp->blk_cnt;
-		b_jmp = b_jmp->next;
+	while ((rc = _gen_bpf_peephole(state)) > 0) {
+		cnt += rc;
+		/* removed instructions can make more loads redundant */
+		rc = _gen_bpf_acc_opt(state);
+		if (rc < 0)
+			return rc;
 	}
-	if (b_jmp == NULL)
-		return -EFAULT;
-	if (jmp_len <= _BPF_JMP_MAX && b_jmp->hash == tgt_hash)
-		return 0;
-
-	/* we need to insert a long jump - create one */
-	_BPF_INSTR(instr, _BPF_OP(state->arch, BPF_JMP + BPF_JA),
-		   _BPF_JMP_NO, _BPF_JMP_NO, _BPF_JMP_HSH(tgt_hash));
-	b_new = _blk_append(state, NULL, &instr);
-	if (b_new == NULL)
-		return -EFAULT;
-
-	/* NOTE - we need to be careful here, we're giving the block a hash
-	 *	  value (this is a sneaky way to ensure we leverage the
-	 *	  inserted long jumps as much as possible) but we never add the
-	 *	  block to the hash table so it won't get cleaned up
-	 *	  automatically */
-	b_new->hash = tgt_hash;
-
-	/* insert the jump after the current jumping block */
-	b_new->prev = blk;
-	b_new->next = blk->next;
-	blk->next->prev = b_new;
-	blk->next = b_new;
+	if (rc < 0)
+		return rc;
 
-	return 1;
+	return cnt;
 }
 
 /**
@@ -1642,13 +4062,12 @@ static int _gen_bpf_build_bpf(struct bpf_state *state,
 {
 	int rc;
 	int iter;
-	uint64_t h_val;
-	unsigned int res_cnt;
-	unsigned int jmp_len;
+	unsigned int blk_cnt, job_cnt = 0;
 	int arch_x86_64 = -1, arch_x32 = -1;
 	struct bpf_instr instr;
 	struct bpf_instr *i_iter;
 	struct bpf_blk *b_badarch, *b_default;
+	struct bpf_arch_job *jobs;
 	struct bpf_blk *b_head = NULL, *b_tail = NULL, *b_iter, *b_new, *b_jmp;
 	struct db_filter *db_secondary = NULL;
 	struct arch_def pseudo_arch;
@@ -1656,6 +4075,14 @@ static int _gen_bpf_build_bpf(struct bpf_state *state,
 	if (col->filter_cnt == 0)
 		return -EINVAL;
 
+	/* size the hash table for roughly one block per syscall and node */
+	blk_cnt = 2;
+	for (iter = 0; iter < col->filter_cnt; iter++)
+		blk_cnt += _gen_bpf_blk_cnt(col->filters[iter]);
+	rc = _hsh_init(state, blk_cnt);
+	if (rc < 0)
+		return rc;
+
 	/* create a fake architecture definition for use in the early stages */
 	memset(&pseudo_arch, 0, sizeof(pseudo_arch));
 	pseudo_arch.endian = col->endian;
@@ -1679,6 +4106,17 @@ static int _gen_bpf_build_bpf(struct bpf_state *state,
 		return rc;
 	state->def_hsh = b_default->hash;
 
+	/* generate the argument chain default action */
+	if (state->act_chain != state->attr->act_default) {
+		b_default = _gen_bpf_action(state, NULL, state->act_chain);
+		if (b_default == NULL)
+			return -ENOMEM;
+		rc = _hsh_add(state, &b_default, 0);
+		if (rc < 0)
+			return rc;
+	}
+	state->chn_hsh = b_default->hash;
+
 	/* load the architecture token/number */
 	_BPF_INSTR(instr, _BPF_OP(state->arch, BPF_LD + BPF_ABS),
 		   _BPF_JMP_NO, _BPF_JMP_NO, _BPF_ARCH(state->arch));
@@ -1692,6 +4130,9 @@ static int _gen_bpf_build_bpf(struct bpf_state *state,
 	b_tail = b_head;
 
 	/* generate the per-architecture filters */
+	jobs = zmalloc(sizeof(*jobs) * col->filter_cnt);
+	if (jobs == NULL)
+		return -ENOMEM;
 	for (iter = 0; iter < col->filter_cnt; iter++) {
 		if (col->filters[iter]->arch->token == SCMP_ARCH_X86_64)
 			arch_x86_64 = iter;
@@ -1713,16 +4154,25 @@ static int _gen_bpf_build_bpf(struct bpf_state *state,
 		} else
 			db_secondary = NULL;
 
-		/* create the filter for the architecture(s) */
-		b_new = _gen_bpf_arch(state, col->filters[iter], db_secondary);
-		if (b_new == NULL)
-			return -ENOMEM;
+		jobs[job_cnt].db = col->filters[iter];
+		jobs[job_cnt].db_secondary = db_secondary;
+		jobs[job_cnt].cache = _chain_cache_get(col->filters[iter]);
+		job_cnt++;
+	}
+
+	/* create the filters for the architecture(s) */
+	rc = _gen_bpf_archs(state, jobs, job_cnt);
+	for (iter = 0; rc == 0 && iter < job_cnt; iter++) {
+		b_new = jobs[iter].blk;
 		b_new->prev = b_tail;
 		b_tail->next = b_new;
 		b_tail = b_new;
 		while (b_tail->next != NULL)
 			b_tail = b_tail->next;
 	}
+	free(jobs);
+	if (rc < 0)
+		return rc;
 
 	/* add a badarch action to the end */
 	b_badarch->prev = b_tail;
@@ -1815,164 +4265,514 @@ static int _gen_bpf_build_bpf(struct bpf_state *state,
 					b_jmp->next->prev = b_jmp;
 			}
 		}
-		if (b_jmp != NULL) {
-			while (b_tail->next != NULL)
-				b_tail = b_tail->next;
-			b_iter = b_tail;
-		} else
+		/* every block after the one we just pulled in has already had
+		 * its jumps pulled in, so continue with the new block */
+		if (b_jmp != NULL)
+			b_iter = b_jmp;
+		else
 			b_iter = b_iter->prev;
 	} while (b_iter != NULL);
 
 
-	/* NOTE - from here to the end of the function we need to fail via the
-	 *	  the build_bpf_free_blks label, not just return an error; see
-	 *	  the _gen_bpf_build_jmp() function for details */
+	/* insert long jumps where necessary, we also verify that all our jump
+	 * targets are valid at this point in the process */
+	rc = _gen_bpf_build_jmps(state, b_head);
+	if (rc < 0)
+		return rc;
+	state->tramp_cnt = rc;
 
-	/* check for long jumps and insert if necessary, we also verify that
-	 * all our jump targets are valid at this point in the process */
-	b_iter = b_tail;
-	do {
-		res_cnt = 0;
-		for (iter = b_iter->blk_cnt - 1; iter >= 0; iter--) {
-			i_iter = &b_iter->blks[iter];
-			switch (i_iter->jt.type) {
-			case TGT_NONE:
-			case TGT_IMM:
-				break;
-			case TGT_PTR_HSH:
-				h_val = i_iter->jt.tgt.hash;
-				rc = _gen_bpf_build_jmp(state, b_tail,
-							b_iter, iter,
-							h_val);
-				if (rc < 0)
-					goto build_bpf_free_blks;
-				res_cnt += rc;
-				break;
-			default:
-				/* fatal error */
-				goto build_bpf_free_blks;
-			}
-			switch (i_iter->jf.type) {
-			case TGT_NONE:
-			case TGT_IMM:
-				break;
-			case TGT_PTR_HSH:
-				h_val = i_iter->jf.tgt.hash;
-				rc = _gen_bpf_build_jmp(state, b_tail,
-							b_iter, iter,
-							h_val);
-				if (rc < 0)
-					goto build_bpf_free_blks;
-				res_cnt += rc;
-				break;
-			default:
-				/* fatal error */
-				goto build_bpf_free_blks;
-			}
-		}
-		if (res_cnt == 0)
-			b_iter = b_iter->prev;
-	} while (b_iter != NULL);
+	/* resolve the TGT_PTR_HSH jumps */
+	rc = _gen_bpf_resolve_jmps(state, b_head);
+	if (rc < 0)
+		return rc;
 
 	/* build the bpf program */
-	do {
-		b_iter = b_head;
-		/* resolve the TGT_PTR_HSH jumps */
-		for (iter = 0; iter < b_iter->blk_cnt; iter++) {
-			i_iter = &b_iter->blks[iter];
-			if (i_iter->jt.type == TGT_PTR_HSH) {
-				h_val = i_iter->jt.tgt.hash;
-				jmp_len = b_iter->blk_cnt - (iter + 1);
-				b_jmp = b_iter->next;
-				while (b_jmp != NULL && b_jmp->hash != h_val) {
-					jmp_len += b_jmp->blk_cnt;
-					b_jmp = b_jmp->next;
-				}
-				if (b_jmp == NULL || jmp_len > _BPF_JMP_MAX)
-					goto build_bpf_free_blks;
-				i_iter->jt = _BPF_JMP_IMM(jmp_len);
-			}
-			if (i_iter->jf.type == TGT_PTR_HSH) {
-				h_val = i_iter->jf.tgt.hash;
-				jmp_len = b_iter->blk_cnt - (iter + 1);
-				b_jmp = b_iter->next;
-				while (b_jmp != NULL && b_jmp->hash != h_val) {
-					jmp_len += b_jmp->blk_cnt;
-					b_jmp = b_jmp->next;
-				}
-				if (b_jmp == NULL || jmp_len > _BPF_JMP_MAX)
-					goto build_bpf_free_blks;
-				i_iter->jf = _BPF_JMP_IMM(jmp_len);
-			}
-			if (i_iter->k.type == TGT_PTR_HSH) {
-				h_val = i_iter->k.tgt.hash;
-				jmp_len = b_iter->blk_cnt - (iter + 1);
-				b_jmp = b_tail;
-				while (b_jmp->hash != h_val)
-					b_jmp = b_jmp->prev;
-				b_jmp = b_jmp->prev;
-				while (b_jmp != b_iter) {
-					jmp_len += b_jmp->blk_cnt;
-					b_jmp = b_jmp->prev;
-				}
-				if (b_jmp == NULL)
-					goto build_bpf_free_blks;
-				i_iter->k = _BPF_K(state->arch, jmp_len);
-			}
+	for (b_iter = b_head; b_iter != NULL; b_iter = b_iter->next) {
+		rc = _bpf_append_blk(state, b_iter);
+		if (rc < 0)
+			return rc;
+	}
+
+	/* optimize the bpf program */
+	rc = _gen_bpf_optimize(state);
+	if (rc < 0)
+		return rc;
+	state->peephole_cnt = rc;
+
+	return 0;
+}
+
+/**
+ * Generate a single BPF program from the filter DB
+ * @param col the seccomp filter collection
+ * @param act_chain the action of the argument chains which don't match
+ * @param prgm the generated BPF program
+ *
+ * This function generates a BPF representation of the given filter collection
+ * and updates the collection's statistics.  Returns zero on success, negative
+ * values on failure.
+ *
+ */
+static int _gen_bpf_generate(struct db_filter_col *col, uint32_t act_chain,
+			     struct bpf_program **prgm)
+{
+	int rc;
+	bool parallel = (col->attr.parallel != 0);
+	struct bpf_state state;
+
+gen_restart:
+	memset(&state, 0, sizeof(state));
+	state.attr = &col->attr;
+	state.act_chain = act_chain;
+	state.parallel = parallel;
+
+	state.bpf = zmalloc(sizeof(*(state.bpf)));
+	if (state.bpf == NULL)
+		return -ENOMEM;
+
+	rc = _gen_bpf_build_bpf(&state, col);
+	if (rc == -EAGAIN && parallel) {
+		/* a hash collision between two architectures, which only a
+		 * serial build can resolve */
+		_state_release(&state);
+		parallel = false;
+		goto gen_restart;
+	}
+	if (rc == 0) {
+		col->stats.peephole = state.peephole_cnt;
+		col->stats.trampolines = state.tramp_cnt;
+		*prgm = state.bpf;
+		state.bpf = NULL;
+	}
+	_state_release(&state);
+
+	return rc;
+}
+
+/**
+ * Check if an argument chain can return a notify action
+ * @param node the argument chain
+ *
+ * Returns true if any node in the argument chain has a notify action, false
+ * otherwise.
+ *
+ */
+static bool _gen_bpf_chain_notify(const struct db_arg_chain_tree *node)
+{
+	const struct db_arg_chain_tree *iter;
+
+	if (node == NULL)
+		return false;
+	while (node->lvl_prv != NULL)
+		node = node->lvl_prv;
+
+	for (iter = node; iter != NULL; iter = iter->lvl_nxt) {
+		if (iter->act_t_flg && iter->act_t == SCMP_ACT_NOTIFY)
+			return true;
+		if (iter->act_f_flg && iter->act_f == SCMP_ACT_NOTIFY)
+			return true;
+		if (_gen_bpf_chain_notify(iter->nxt_t) ||
+		    _gen_bpf_chain_notify(iter->nxt_f))
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Sort the syscalls of a filter stack
+ * @param a the first syscall
+ * @param b the second syscall
+ *
+ * This is a qsort() helper which sorts the syscalls in the order they are
+ * assigned to the filters of a filter stack: syscalls which must be handled by
+ * the first filter, then by decreasing priority.
+ *
+ */
+static int _gen_bpf_split_cmp(const void *a, const void *b)
+{
+	const struct bpf_split_sys *s_a = a;
+	const struct bpf_split_sys *s_b = b;
+
+	if (s_a->first != s_b->first)
+		return (s_a->first ? -1 : 1);
+	if (s_a->sys->priority != s_b->sys->priority)
+		return (s_a->sys->priority > s_b->sys->priority ? -1 : 1);
+	if (s_a->filter != s_b->filter)
+		return (s_a->filter < s_b->filter ? -1 : 1);
+	if (s_a->sys->num != s_b->sys->num)
+		return (s_a->sys->num < s_b->sys->num ? -1 : 1);
+	return 0;
+}
+
+/**
+ * Free a filter collection created by _gen_bpf_split_col()
+ * @param split the filter collection
+ *
+ * Free the syscall lists and filters of the collection, the argument chains
+ * are shared with the original collection and are not touched.
+ *
+ */
+static void _gen_bpf_split_release(struct db_filter_col *split)
+{
+	unsigned int iter;
+	struct db_filter *db;
+	struct db_sys_list *s_iter;
+
+	if (split->filters == NULL)
+		return;
+
+	for (iter = 0; iter < split->filter_cnt; iter++) {
+		db = split->filters[iter];
+		if (db == NULL)
+			continue;
+		while (db->syscalls != NULL) {
+			s_iter = db->syscalls;
+			db->syscalls = s_iter->next;
+			free(s_iter);
 		}
+		gen_bpf_cache_release(db->chain_cache);
+		free(db);
+	}
+	free(split->filters);
+	split->filters = NULL;
+}
 
-		/* build the bpf program */
-		if (_bpf_append_blk(state->bpf, b_iter) < 0)
-			goto build_bpf_free_blks;
+/**
+ * Create the filter collection for one filter of a filter stack
+ * @param col the seccomp filter collection
+ * @param first the index of the first syscall in this filter
+ * @param last the index after the last syscall in this filter
+ * @param hot_last the index after the last syscall in the first filter
+ * @param split the new filter collection
+ *
+ * Build a filter collection which handles the syscalls with a split index in
+ * the range [@first, @last) exactly as @col does and allows every other
+ * syscall handled by @col.  The first filter of the stack keeps the default
+ * action of @col and allows the syscalls handled by the rest of the stack, so
+ * the filter which handles a syscall decides its action; all other filters
+ * allow unknown syscalls.  The argument chains of every filter still fall
+ * through to the default action of @col, see _gen_bpf_split_gen(), so the
+ * combined result of the stack is the action of the original filter.  The filters after the
+ * first also allow the prioritized syscalls of the first filter up front so
+ * the hot syscalls only pay for a short check in each of them.  Returns zero
+ * on success, negative values on failure.
+ *
+ */
+static int _gen_bpf_split_col(const struct db_filter_col *col,
+			      unsigned int first, unsigned int last,
+			      unsigned int hot_last,
+			      struct db_filter_col *split)
+{
+	unsigned int iter;
+	bool stub;
+	struct db_filter *db;
+	struct db_sys_list *s_iter, *s_new, **s_tail;
+
+	memset(split, 0, sizeof(*split));
+	split->state = col->state;
+	split->attr = col->attr;
+	split->endian = col->endian;
+	if (first > 0)
+		split->attr.act_default = SCMP_ACT_ALLOW;
+
+	split->filters = zmalloc(sizeof(*split->filters) * col->filter_cnt);
+	if (split->filters == NULL)
+		return -ENOMEM;
+	split->filter_cnt = col->filter_cnt;
 
-		/* we're done with the block, free it */
-		b_head = b_iter->next;
-		_blk_free(state, b_iter);
-	} while (b_head != NULL);
+	for (iter = 0; iter < col->filter_cnt; iter++) {
+		db = zmalloc(sizeof(*db));
+		if (db == NULL)
+			goto split_col_failure;
+		db->arch = col->filters[iter]->arch;
+		split->filters[iter] = db;
+
+		s_tail = &db->syscalls;
+		db_list_foreach(s_iter, col->filters[iter]->syscalls) {
+			if (!s_iter->valid)
+				continue;
+
+			if (s_iter->split_idx >= first &&
+			    s_iter->split_idx < last) {
+				s_new = malloc(sizeof(*s_new));
+				if (s_new == NULL)
+					goto split_col_failure;
+				*s_new = *s_iter;
+			} else {
+				if (first == 0)
+					stub = (s_iter->split_idx >= last &&
+						col->attr.act_default !=
+						SCMP_ACT_ALLOW);
+				else
+					stub = (s_iter->split_idx < hot_last &&
+						(s_iter->priority &
+						 _DB_PRI_MASK_USER));
+				if (!stub)
+					continue;
+
+				s_new = zmalloc(sizeof(*s_new));
+				if (s_new == NULL)
+					goto split_col_failure;
+				s_new->num = s_iter->num;
+				if (first > 0)
+					s_new->priority = (s_iter->priority &
+							   _DB_PRI_MASK_USER) |
+							  _DB_PRI_MASK_CHAIN;
+				s_new->action = SCMP_ACT_ALLOW;
+				s_new->valid = true;
+			}
+			s_new->next = NULL;
+			*s_tail = s_new;
+			s_tail = &s_new->next;
+		}
+	}
 
 	return 0;
 
-build_bpf_free_blks:
-	b_iter = b_head;
-	while (b_iter != NULL) {
-		b_jmp = b_iter->next;
-		_hsh_remove(state, b_iter->hash);
-		__blk_free(state, b_iter);
-		b_iter = b_jmp;
+split_col_failure:
+	_gen_bpf_split_release(split);
+	return -ENOMEM;
+}
+
+/**
+ * Generate one filter of a filter stack
+ * @param col the seccomp filter collection
+ * @param first the index of the first syscall in this filter
+ * @param last the index after the last syscall in this filter
+ * @param hot_last the index after the last syscall in the first filter
+ * @param prgm the generated BPF program
+ * @param stats the statistics of the generated BPF program
+ *
+ * Generate the BPF program for the filter described by _gen_bpf_split_col(),
+ * the argument chains which don't match return the default action of @col
+ * rather than the default action of the filter.  Returns zero on success,
+ * -E2BIG if the program does not fit in the kernel's limits, other negative
+ * values on failure.
+ *
+ */
+static int _gen_bpf_split_gen(const struct db_filter_col *col,
+			      unsigned int first, unsigned int last,
+			      unsigned int hot_last,
+			      struct bpf_program **prgm,
+			      struct db_filter_stats *stats)
+{
+	int rc;
+	struct db_filter_col split;
+
+	rc = _gen_bpf_split_col(col, first, last, hot_last, &split);
+	if (rc < 0)
+		return rc;
+
+	rc = _gen_bpf_generate(&split, col->attr.act_default, prgm);
+	if (rc == 0 && (*prgm)->blk_cnt > BPF_MAXINSNS) {
+		_program_free(*prgm);
+		*prgm = NULL;
+		rc = -E2BIG;
 	}
-	return -EFAULT;
+	if (rc == 0)
+		*stats = split.stats;
+
+	_gen_bpf_split_release(&split);
+	return rc;
 }
 
 /**
  * Generate a BPF representation of the filter DB
  * @param col the seccomp filter collection
  *
- * This function generates a BPF representation of the given filter collection.
+ * This function generates a BPF representation of the given filter collection,
+ * or returns a copy of the program previously generated from an identical
+ * collection if the filter cache is enabled.  The blocks generated for each
+ * syscall's argument chains are kept with the filter DBs, so that the next
+ * generation only has to generate the argument chains which have changed.
  * Returns a pointer to a valid bpf_program on success, NULL on failure.
  *
  */
-struct bpf_program *gen_bpf_generate(const struct db_filter_col *col)
+struct bpf_program *gen_bpf_generate(struct db_filter_col *col)
 {
 	int rc;
-	struct bpf_state state;
 	struct bpf_program *prgm;
 
-	memset(&state, 0, sizeof(state));
-	state.attr = &col->attr;
+	rc = cache_lookup(col, &prgm);
+	if (rc > 0)
+		return prgm;
 
-	prgm = zmalloc(sizeof(*(prgm)));
-	if (prgm == NULL)
+	if (_gen_bpf_generate(col, col->attr.act_default, &prgm) < 0)
 		return NULL;
-	state.bpf = prgm;
 
-	rc = _gen_bpf_build_bpf(&state, col);
 	if (rc == 0)
-		state.bpf = NULL;
-	_state_release(&state);
-
+		cache_store(col, prgm);
 	return prgm;
 }
 
+/**
+ * Generate a stack of BPF filters from the filter DB
+ * @param col the seccomp filter collection
+ * @param stack the generated BPF programs
+ *
+ * This function generates a BPF representation of the given filter collection
+ * as a stack of BPF programs which each fit in the kernel's BPF_MAXINSNS limit
+ * and which, when loaded together, enforce the same policy as the collection.
+ * The syscalls are distributed over the filters in priority order so the hot
+ * syscalls are handled by the first filter.  The first filter is also the only
+ * filter that can return a notify action, as only one filter can request a
+ * notification fd, and it handles the syscalls used to load filters so that it
+ * can be loaded last, on top of the other filters.  The stack consists of a
+ * single program if the collection fits in one filter.  On success @stack is
+ * set to a NULL terminated array of programs and the number of programs is
+ * returned, negative values are returned on failure.
+ *
+ */
+int gen_bpf_generate_stack(struct db_filter_col *col,
+			   struct bpf_program ***stack)
+{
+	int rc;
+	unsigned int iter;
+	unsigned int cnt = 0, s_cnt = 0;
+	unsigned int first = 0, last = 0, hot_last = 0;
+	unsigned int lo, hi, probe;
+	int sys_seccomp, sys_prctl;
+	uint64_t peephole = 0, trampolines = 0;
+	struct db_sys_list *s_iter;
+	struct bpf_split_sys *units = NULL;
+	struct bpf_program *prgm, *best = NULL;
+	struct bpf_program **stk = NULL, **stk_new;
+	struct db_filter_stats stats, best_stats;
+
+	/* order the syscalls as they should be assigned to the filters */
+	for (iter = 0; iter < col->filter_cnt; iter++)
+		db_list_foreach(s_iter, col->filters[iter]->syscalls)
+			if (s_iter->valid)
+				cnt++;
+	if (cnt > 0) {
+		units = zmalloc(sizeof(*units) * cnt);
+		if (units == NULL)
+			return -ENOMEM;
+	}
+	sys_seccomp = arch_syscall_resolve_name(arch_def_native, "seccomp");
+	sys_prctl = arch_syscall_resolve_name(arch_def_native, "prctl");
+	cnt = 0;
+	for (iter = 0; iter < col->filter_cnt; iter++) {
+		db_list_foreach(s_iter, col->filters[iter]->syscalls) {
+			if (!s_iter->valid)
+				continue;
+			units[cnt].sys = s_iter;
+			units[cnt].filter = iter;
+			if (s_iter->chains == NULL)
+				units[cnt].first = (s_iter->action ==
+						    SCMP_ACT_NOTIFY);
+			else
+				/* the chains fall through to the default */
+				units[cnt].first =
+					(col->attr.act_default ==
+					 SCMP_ACT_NOTIFY ||
+					 _gen_bpf_chain_notify(s_iter->chains));
+			if (col->filters[iter]->arch == arch_def_native &&
+			    ((int)s_iter->num == sys_seccomp ||
+			     (int)s_iter->num == sys_prctl))
+				units[cnt].first = true;
+			cnt++;
+		}
+	}
+	if (cnt > 0)
+		qsort(units, cnt, sizeof(*units), _gen_bpf_split_cmp);
+	for (iter = 0; iter < cnt; iter++)
+		units[iter].sys->split_idx = iter;
+
+	/* fill each filter with as many syscalls as it can hold */
+	do {
+		lo = (first < cnt ? first + 1 : first);
+		hi = cnt;
+		probe = hi;
+		while (lo <= hi) {
+			rc = _gen_bpf_split_gen(col, first, probe,
+						(first == 0 ? probe : hot_last),
+						&prgm, &stats);
+			if (rc == 0) {
+				_program_free(best);
+				best = prgm;
+				best_stats = stats;
+				last = probe;
+				lo = probe + 1;
+			} else if (rc == -E2BIG) {
+				if (probe == lo)
+					break;
+				hi = probe - 1;
+			} else
+				goto stack_failure;
+			probe = lo + (hi - lo) / 2;
+		}
+		if (best == NULL) {
+			rc = -E2BIG;
+			goto stack_failure;
+		}
+
+		stk_new = realloc(stk, sizeof(*stk) * (s_cnt + 2));
+		if (stk_new == NULL) {
+			rc = -ENOMEM;
+			goto stack_failure;
+		}
+		stk = stk_new;
+		stk[s_cnt++] = best;
+		stk[s_cnt] = NULL;
+		best = NULL;
+		peephole += best_stats.peephole;
+		trampolines += best_stats.trampolines;
+
+		if (first == 0)
+			hot_last = last;
+		first = last;
+	} while (first < cnt);
+
+	if (hot_last < cnt && units[hot_last].first) {
+		rc = -E2BIG;
+		goto stack_failure;
+	}
+
+	col->stats.peephole = peephole;
+	col->stats.trampolines = trampolines;
+	if (units != NULL)
+		free(units);
+	*stack = stk;
+	return s_cnt;
+
+stack_failure:
+	_program_free(best);
+	if (units != NULL)
+		free(units);
+	gen_bpf_release_stack(stk);
+	return rc;
+}
+
+/**
+ * Free the argument chain cache
+ * @param cache the argument chain cache
+ *
+ * Free the argument chain cache of a filter DB, see gen_bpf_generate().
+ *
+ */
+void gen_bpf_cache_release(struct bpf_chain_cache *cache)
+{
+	unsigned int bkt;
+	struct bpf_chain_ent *ent;
+
+	if (cache == NULL)
+		return;
+
+	for (bkt = 0; bkt < _BPF_CHAIN_SIZE(cache); bkt++) {
+		while (cache->tbl[bkt] != NULL) {
+			ent = cache->tbl[bkt];
+			cache->tbl[bkt] = ent->next;
+			free(ent);
+		}
+	}
+	free(cache->tbl);
+	free(cache->key);
+	free(cache->rec);
+	free(cache);
+}
+
 /**
  * Free memory associated with a BPF representation
  * @param program the BPF representation
@@ -1985,3 +4785,23 @@ void gen_bpf_release(struct bpf_program *program)
 {
 	_program_free(program);
 }
+
+/**
+ * Free memory associated with a stack of BPF programs
+ * @param stack the BPF programs
+ *
+ * Free the memory associated with the BPF programs generated by the
+ * gen_bpf_generate_stack() function.
+ *
+ */
+void gen_bpf_release_stack(struct bpf_program **stack)
+{
+	unsigned int iter;
+
+	if (stack == NULL)
+		return;
+
+	for (iter = 0; stack[iter] != NULL; iter++)
+		_program_free(stack[iter]);
+	free(stack);
+}
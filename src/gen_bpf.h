@@ -36,7 +36,13 @@ struct bpf_program {
 #define BPF_PGM_SIZE(x) \
 	((x)->blk_cnt * sizeof(*((x)->blks)))
 
-struct bpf_program *gen_bpf_generate(const struct db_filter_col *col);
+struct bpf_program *gen_bpf_generate(struct db_filter_col *col);
 void gen_bpf_release(struct bpf_program *program);
 
+void gen_bpf_cache_release(struct bpf_chain_cache *cache);
+
+int gen_bpf_generate_stack(struct db_filter_col *col,
+			   struct bpf_program ***stack);
+void gen_bpf_release_stack(struct bpf_program **stack);
+
 #endif
@@ -30,6 +30,7 @@ cdef extern from "seccomp.h":
         unsigned int micro
 
     ctypedef void* scmp_filter_ctx
+    ctypedef void* scmp_filter_prep
 
     cdef enum:
         SCMP_ARCH_NATIVE
@@ -60,6 +61,17 @@ cdef extern from "seccomp.h":
         SCMP_FLTATR_API_TSKIP
         SCMP_FLTATR_CTL_LOG
         SCMP_FLTATR_CTL_SSB
+        SCMP_FLTATR_CTL_OPTIMIZE
+        SCMP_FLTATR_CTL_PEEPHOLE
+        SCMP_FLTATR_CTL_SPLIT
+        SCMP_FLTATR_CTL_PARALLEL
+
+    cdef enum scmp_filter_stat:
+        SCMP_FLTSTAT_PEEPHOLE
+        SCMP_FLTSTAT_TRAMPOLINES
+        SCMP_FLTSTAT_FILTERS
+        SCMP_FLTSTAT_CACHE_HITS
+        SCMP_FLTSTAT_CACHE_MISSES
 
     cdef enum scmp_compare:
         SCMP_CMP_NE
@@ -80,6 +92,16 @@ cdef extern from "seccomp.h":
     unsigned int SCMP_ACT_ERRNO(int errno)
     unsigned int SCMP_ACT_TRACE(int value)
 
+    cdef enum:
+        SCMP_RULE_EXACT
+
+    cdef enum:
+        SCMP_LOAD_NNP
+        SCMP_LOAD_TSYNC
+        SCMP_LOAD_LOG
+        SCMP_LOAD_SPEC_ALLOW
+        SCMP_LOAD_NEW_LISTENER
+
     ctypedef uint64_t scmp_datum_t
 
     cdef struct scmp_arg_cmp:
@@ -88,6 +110,12 @@ cdef extern from "seccomp.h":
         scmp_datum_t datum_a
         scmp_datum_t datum_b
 
+    cdef struct scmp_rule:
+        uint32_t action
+        int syscall
+        unsigned int arg_cnt
+        scmp_arg_cmp *arg_array
+
     cdef struct seccomp_data:
         int nr
         uint32_t arch
@@ -116,6 +144,8 @@ cdef extern from "seccomp.h":
     unsigned int seccomp_api_get()
     int seccomp_api_set(unsigned int level)
 
+    int seccomp_cache_set(unsigned int size, char *path)
+
     scmp_filter_ctx seccomp_init(uint32_t def_action)
     int seccomp_reset(scmp_filter_ctx ctx, uint32_t def_action)
     void seccomp_release(scmp_filter_ctx ctx)
@@ -129,18 +159,32 @@ cdef extern from "seccomp.h":
     int seccomp_arch_remove(scmp_filter_ctx ctx, int arch_token)
 
     int seccomp_load(scmp_filter_ctx ctx)
+    int seccomp_load_raw(void *bpf, size_t len, uint32_t flags)
+    int seccomp_prepare(scmp_filter_ctx ctx, scmp_filter_prep *prep)
+    int seccomp_load_prepared(scmp_filter_prep prep)
+    void seccomp_prepare_release(scmp_filter_prep prep)
 
     int seccomp_attr_get(scmp_filter_ctx ctx,
                          scmp_filter_attr attr, uint32_t* value)
     int seccomp_attr_set(scmp_filter_ctx ctx,
                          scmp_filter_attr attr, uint32_t value)
+    int seccomp_stat_get(scmp_filter_ctx ctx,
+                         scmp_filter_stat stat, uint64_t* value)
 
     char *seccomp_syscall_resolve_num_arch(int arch_token, int num)
+    const char *seccomp_syscall_resolve_num_arch_static(int arch_token,
+                                                        int num)
     int seccomp_syscall_resolve_name_arch(int arch_token, char *name)
     int seccomp_syscall_resolve_name_rewrite(int arch_token, char *name)
     int seccomp_syscall_resolve_name(char *name)
+    int seccomp_syscall_resolve_names(uint32_t *arch_tokens,
+                                      unsigned int arch_cnt,
+                                      const char **names,
+                                      unsigned int name_cnt,
+                                      int *syscalls)
     int seccomp_syscall_priority(scmp_filter_ctx ctx,
                                  int syscall, uint8_t priority)
+    int seccomp_profile_load(scmp_filter_ctx ctx, int fd)
 
     int seccomp_rule_add(scmp_filter_ctx ctx, uint32_t action,
                          int syscall, unsigned int arg_cnt, ...)
@@ -154,6 +198,9 @@ cdef extern from "seccomp.h":
                                      uint32_t action, int syscall,
                                      unsigned int arg_cnt,
                                      scmp_arg_cmp *arg_array)
+    int seccomp_rule_add_bulk(scmp_filter_ctx ctx,
+                              scmp_rule *rules, size_t rule_cnt,
+                              uint32_t flags)
 
     int seccomp_notify_alloc(seccomp_notif **req, seccomp_notif_resp **resp)
     void seccomp_notify_free(seccomp_notif *req, seccomp_notif_resp *resp)
@@ -164,6 +211,9 @@ cdef extern from "seccomp.h":
 
     int seccomp_export_pfc(scmp_filter_ctx ctx, int fd)
     int seccomp_export_bpf(scmp_filter_ctx ctx, int fd)
+    int seccomp_export_bpf_mem(scmp_filter_ctx ctx, void *buf, size_t *len)
+    int seccomp_export_ctx(scmp_filter_ctx ctx, void *buf, size_t *len)
+    int seccomp_import_ctx(void *buf, size_t len, scmp_filter_ctx *ctx)
 
 # kate: syntax python;
 # kate: indent-mode python; space-indent on; indent-width 4; mixedindent off;
@@ -52,6 +52,14 @@ Argument comparison values (see the Arg class):
     GE - arg >= datum_a
     MASKED_EQ - (arg & datum_a) == datum_b
 
+Raw filter load flags (see load_raw()):
+
+    LOAD_NNP - set NO_NEW_PRIVS before loading the filter
+    LOAD_TSYNC - synchronize the filter across all threads
+    LOAD_LOG - log all actions except ALLOW
+    LOAD_SPEC_ALLOW - disable the speculative store bypass mitigation
+    LOAD_NEW_LISTENER - return a notification fd for the filter
+
 
 Example:
 
@@ -83,7 +91,8 @@ __date__ = "3 February 2017"
 from cpython.version cimport PY_MAJOR_VERSION
 from libc.stdint cimport int8_t, int16_t, int32_t, int64_t
 from libc.stdint cimport uint8_t, uint16_t, uint32_t, uint64_t
-from libc.stdlib cimport free
+from libc.stdlib cimport calloc, malloc, free
+from libc.string cimport memcpy
 import errno
 
 cimport libseccomp
@@ -132,6 +141,12 @@ GE = libseccomp.SCMP_CMP_GE
 GT = libseccomp.SCMP_CMP_GT
 MASKED_EQ = libseccomp.SCMP_CMP_MASKED_EQ
 
+LOAD_NNP = libseccomp.SCMP_LOAD_NNP
+LOAD_TSYNC = libseccomp.SCMP_LOAD_TSYNC
+LOAD_LOG = libseccomp.SCMP_LOAD_LOG
+LOAD_SPEC_ALLOW = libseccomp.SCMP_LOAD_SPEC_ALLOW
+LOAD_NEW_LISTENER = libseccomp.SCMP_LOAD_NEW_LISTENER
+
 def system_arch():
     """ Return the system architecture value.
 
@@ -151,13 +166,14 @@ def resolve_syscall(arch, syscall):
     Resolve an architecture's syscall name to the correct number or the
     syscall number to the correct name.
     """
-    cdef char *ret_str
+    cdef const char *ret_str
 
     if isinstance(syscall, basestring):
         return libseccomp.seccomp_syscall_resolve_name_rewrite(arch,
                                                                c_str(syscall))
     elif isinstance(syscall, int):
-        ret_str = libseccomp.seccomp_syscall_resolve_num_arch(arch, syscall)
+        ret_str = libseccomp.seccomp_syscall_resolve_num_arch_static(arch,
+                                                                     syscall)
         if ret_str is NULL:
             raise ValueError('Unknown syscall %d on arch %d' % (syscall, arch))
         else:
@@ -165,6 +181,53 @@ def resolve_syscall(arch, syscall):
     else:
         raise TypeError("Syscall must either be an int or str type")
 
+def resolve_syscalls(arches, syscalls):
+    """ Resolve a set of syscall names for a set of architectures.
+
+    Arguments:
+    arches - a list of architecture values, e.g. Arch.*
+    syscalls - a list of syscall names
+
+    Description:
+    Resolve each of the syscall names to the correct number for each of the
+    architectures in a single call.  Returns a list with an entry for each
+    syscall name, each entry is a list of the syscall numbers in the same
+    order as the architectures.  Unknown syscall names resolve to
+    __NR_SCMP_ERROR.
+    """
+    cdef uint32_t *c_arches
+    cdef const char **c_names
+    cdef int *c_syscalls
+    arches = list(arches)
+    names = [c_str(syscall) for syscall in syscalls]
+    if len(arches) == 0 or len(names) == 0:
+        return [[] for name in names]
+    c_arches = <uint32_t *>calloc(len(arches), sizeof(uint32_t))
+    c_names = <const char **>calloc(len(names), sizeof(char *))
+    c_syscalls = <int *>calloc(len(arches) * len(names), sizeof(int))
+    if c_arches == NULL or c_names == NULL or c_syscalls == NULL:
+        free(c_arches)
+        free(c_names)
+        free(c_syscalls)
+        raise MemoryError()
+    try:
+        for i, arch in enumerate(arches):
+            c_arches[i] = int(arch)
+        for i, name in enumerate(names):
+            c_names[i] = name
+        rc = libseccomp.seccomp_syscall_resolve_names(c_arches, len(arches),
+                                                      c_names, len(names),
+                                                      c_syscalls)
+        if rc != 0:
+            raise RuntimeError(str.format("Library error (errno = {0})", rc))
+        return [[c_syscalls[i * len(arches) + j]
+                 for j in range(len(arches))]
+                for i in range(len(names))]
+    finally:
+        free(c_arches)
+        free(c_names)
+        free(c_syscalls)
+
 def get_api():
     """ Query the level of API support
 
@@ -194,6 +257,45 @@ def set_api(unsigned int level):
     elif rc != 0:
         raise RuntimeError(str.format("Library error (errno = {0})", rc))
 
+def set_cache(unsigned int size, path=None):
+    """ Configure the filter cache
+
+    Arguments:
+    size - the number of filters to keep in memory
+    path - the cache directory, or None
+
+    Description:
+    Configure the process wide cache of generated BPF filters.  Up to size
+    filters are kept in memory and, if path is not None, the filters are
+    also stored in the given directory so other processes can use them.
+    The cache is disabled if size is zero and path is None.
+    """
+    cdef char *c_path = NULL
+    if path is not None:
+        path_str = path.encode()
+        c_path = path_str
+    rc = libseccomp.seccomp_cache_set(size, c_path)
+    if rc != 0:
+        raise RuntimeError(str.format("Library error (errno = {0})", rc))
+
+def load_raw(bytes bpf, uint32_t flags=0):
+    """ Load a BPF filter into the kernel
+
+    Arguments:
+    bpf - the BPF filter, e.g. from SyscallFilter.export_bpf_mem()
+    flags - zero or more of the LOAD_* flags
+
+    Description:
+    Load the given BPF filter into the kernel without a filter object.
+    Returns the notification fd if LOAD_NEW_LISTENER is given, zero
+    otherwise.
+    """
+    cdef char *c_bpf = bpf
+    rc = libseccomp.seccomp_load_raw(c_bpf, len(bpf), flags)
+    if rc < 0:
+        raise RuntimeError(str.format("Library error (errno = {0})", rc))
+    return rc
+
 cdef class Arch:
     """ Python object representing the SyscallFilter architecture values.
 
@@ -316,6 +418,10 @@ cdef class Attr:
     CTL_TSKIP - allow rules with a -1 syscall number
     CTL_LOG - log not-allowed actions
     CTL_SSB - disable SSB mitigations
+    CTL_OPTIMIZE - the filter's optimization level
+    CTL_PEEPHOLE - peephole optimize the filter
+    CTL_SPLIT - split oversized filters into a filter stack on load
+    CTL_PARALLEL - generate the filters of the architectures in parallel
     """
     ACT_DEFAULT = libseccomp.SCMP_FLTATR_ACT_DEFAULT
     ACT_BADARCH = libseccomp.SCMP_FLTATR_ACT_BADARCH
@@ -324,6 +430,26 @@ cdef class Attr:
     API_TSKIP = libseccomp.SCMP_FLTATR_API_TSKIP
     CTL_LOG = libseccomp.SCMP_FLTATR_CTL_LOG
     CTL_SSB = libseccomp.SCMP_FLTATR_CTL_SSB
+    CTL_OPTIMIZE = libseccomp.SCMP_FLTATR_CTL_OPTIMIZE
+    CTL_PEEPHOLE = libseccomp.SCMP_FLTATR_CTL_PEEPHOLE
+    CTL_SPLIT = libseccomp.SCMP_FLTATR_CTL_SPLIT
+    CTL_PARALLEL = libseccomp.SCMP_FLTATR_CTL_PARALLEL
+
+cdef class Stat:
+    """ Python object representing the SyscallFilter statistics.
+
+    Data values:
+    PEEPHOLE - instructions removed by the peephole optimizer
+    TRAMPOLINES - long jump trampolines added to the filter
+    FILTERS - filters loaded into the kernel
+    CACHE_HITS - filters found in the filter cache
+    CACHE_MISSES - filters missing from the filter cache
+    """
+    PEEPHOLE = libseccomp.SCMP_FLTSTAT_PEEPHOLE
+    TRAMPOLINES = libseccomp.SCMP_FLTSTAT_TRAMPOLINES
+    FILTERS = libseccomp.SCMP_FLTSTAT_FILTERS
+    CACHE_HITS = libseccomp.SCMP_FLTSTAT_CACHE_HITS
+    CACHE_MISSES = libseccomp.SCMP_FLTSTAT_CACHE_MISSES
 
 cdef class Arg:
     """ Python object representing a SyscallFilter syscall argument.
@@ -570,6 +696,36 @@ cdef class NotificationResponse:
         """
         self._flags = value
 
+cdef class PreparedFilter:
+    """ Python object representing a prepared seccomp syscall filter. """
+    cdef libseccomp.scmp_filter_prep _prep
+
+    def __cinit__(self):
+        self._prep = NULL
+
+    def __dealloc__(self):
+        """ Releases the prepared filter.
+
+        Description:
+        Releases the prepared filter.  This function does not affect any
+        seccomp filters already loaded into the kernel.
+        """
+        if self._prep != NULL:
+            libseccomp.seccomp_prepare_release(self._prep)
+
+    def load(self):
+        """ Load the prepared filter into the Linux Kernel.
+
+        Description:
+        Load the prepared filter into the Linux Kernel.  As soon as the
+        method returns the filter will be active and enforcing.  Returns
+        the notification fd if the filter uses NOTIFY, zero otherwise.
+        """
+        rc = libseccomp.seccomp_load_prepared(self._prep)
+        if rc < 0:
+            raise RuntimeError(str.format("Library error (errno = {0})", rc))
+        return rc
+
 cdef class SyscallFilter:
     """ Python object representing a seccomp syscall filter. """
     cdef int _defaction
@@ -708,6 +864,20 @@ cdef class SyscallFilter:
         if rc != 0:
             raise RuntimeError(str.format("Library error (errno = {0})", rc))
 
+    def prepare(self):
+        """ Prepare the filter for loading into the Linux Kernel.
+
+        Description:
+        Generate the current filter and return it as a PreparedFilter
+        object which can be loaded later, changes made to the filter after
+        this method returns do not affect the prepared filter.
+        """
+        cdef PreparedFilter prep = PreparedFilter()
+        rc = libseccomp.seccomp_prepare(self._ctx, &prep._prep)
+        if rc != 0:
+            raise RuntimeError(str.format("Library error (errno = {0})", rc))
+        return prep
+
     def get_attr(self, attr):
         """ Get an attribute value from the filter.
 
@@ -727,6 +897,25 @@ cdef class SyscallFilter:
             raise RuntimeError(str.format("Library error (errno = {0})", rc))
         return value
 
+    def get_stat(self, stat):
+        """ Get a statistic value from the filter.
+
+        Arguments:
+        stat - the statistic, e.g. Stat.*
+
+        Description:
+        Lookup the given statistic from the most recently generated filter
+        and return the statistic's value to the caller.
+        """
+        cdef uint64_t value = 0
+        rc = libseccomp.seccomp_stat_get(self._ctx,
+                                         stat, <uint64_t *>&value)
+        if rc == -errno.EEXIST:
+            raise ValueError("Invalid statistic")
+        elif rc != 0:
+            raise RuntimeError(str.format("Library error (errno = {0})", rc))
+        return value
+
     def set_attr(self, attr, int value):
         """ Set a filter attribute.
 
@@ -771,6 +960,24 @@ cdef class SyscallFilter:
         if rc != 0:
             raise RuntimeError(str.format("Library error (errno = {0})", rc))
 
+    def load_profile(self, file):
+        """ Set the syscall priorities from a frequency profile.
+
+        Arguments:
+        file - the profile file
+
+        Description:
+        Read a syscall frequency profile from the given file and set the
+        syscall priorities such that the most frequently used syscalls have
+        the least overhead in the generated filter code.  The profile uses
+        the format generated by "scmp_app_inspector -f", each line starting
+        with a count is followed by a syscall name or number and all other
+        lines are skipped.
+        """
+        rc = libseccomp.seccomp_profile_load(self._ctx, file.fileno())
+        if rc != 0:
+            raise RuntimeError(str.format("Library error (errno = {0})", rc))
+
     def add_rule(self, int action, syscall, *args):
         """ Add a new rule to filter.
 
@@ -938,6 +1145,67 @@ cdef class SyscallFilter:
         if rc != 0:
             raise RuntimeError(str.format("Library error (errno = {0})", rc))
 
+    def add_rules(self, rules, exact=False):
+        """ Add a set of new rules to filter.
+
+        Arguments:
+        rules - a list of rules, each a tuple of an action, a syscall name
+                or number, and an optional number of Arg objects
+        exact - add the rules exactly as specified
+
+        Description:
+        Add all of the given rules to the filter as if add_rule(), or
+        add_rule_exactly() if exact is True, were called for each one.  The
+        rules are added as a single operation, either all of the rules are
+        added or the filter is left unchanged.  This is much faster than
+        adding a large number of rules one at a time.
+        """
+        cdef libseccomp.scmp_rule *c_rules
+        cdef libseccomp.scmp_arg_cmp *c_args
+        cdef Arg arg
+        cdef uint32_t flags = 0
+        rules = list(rules)
+        if len(rules) == 0:
+            return
+        c_rules = <libseccomp.scmp_rule *>calloc(len(rules),
+                                                 sizeof(libseccomp.scmp_rule))
+        c_args = <libseccomp.scmp_arg_cmp *>calloc(len(rules) * 6,
+                                                   sizeof(libseccomp.scmp_arg_cmp))
+        if c_rules == NULL or c_args == NULL:
+            free(c_rules)
+            free(c_args)
+            raise MemoryError()
+        try:
+            for i, rule in enumerate(rules):
+                action = rule[0]
+                syscall = rule[1]
+                args = rule[2:]
+                if isinstance(syscall, str):
+                    syscall_str = syscall.encode()
+                    syscall_num = \
+                        libseccomp.seccomp_syscall_resolve_name(syscall_str)
+                elif isinstance(syscall, int):
+                    syscall_num = syscall
+                else:
+                    raise TypeError("Syscall must either be an int or str type")
+                if len(args) > 6:
+                    raise RuntimeError("Maximum number of arguments exceeded")
+                for j, arg in enumerate(args):
+                    c_args[i * 6 + j] = arg.to_c()
+                c_rules[i].action = action
+                c_rules[i].syscall = syscall_num
+                c_rules[i].arg_cnt = len(args)
+                c_rules[i].arg_array = &c_args[i * 6]
+            if exact:
+                flags = libseccomp.SCMP_RULE_EXACT
+            rc = libseccomp.seccomp_rule_add_bulk(self._ctx, c_rules,
+                                                  len(rules), flags)
+        finally:
+            free(c_rules)
+            free(c_args)
+        if rc != 0:
+            raise RuntimeError(str.format("Library error (errno = {0})", rc))
+
     def receive_notify(self):
         """ Receive seccomp notifications.
 
@@ -1022,5 +1290,81 @@ cdef class SyscallFilter:
         if rc != 0:
             raise RuntimeError(str.format("Library error (errno = {0})", rc))
 
+    def export_bpf_mem(self):
+        """ Export the filter in BPF format.
+
+        Description:
+        Return the filter in Berkley Packet Filter (BPF) as bytes.  The
+        output is identical to what is loaded into the Linux Kernel.
+        """
+        cdef size_t len = 0
+        cdef char *buf
+        rc = libseccomp.seccomp_export_bpf_mem(self._ctx, NULL, &len)
+        if rc != 0:
+            raise RuntimeError(str.format("Library error (errno = {0})", rc))
+        buf = <char *>malloc(len)
+        if buf == NULL:
+            raise MemoryError()
+        try:
+            rc = libseccomp.seccomp_export_bpf_mem(self._ctx, buf, &len)
+            if rc != 0:
+                raise RuntimeError(str.format("Library error (errno = {0})",
+                                              rc))
+            return buf[:len]
+        finally:
+            free(buf)
+
+    def export_ctx(self):
+        """ Export the filter in a binary format.
+
+        Description:
+        Return the filter's attributes, architectures, rules and syscall
+        priorities as bytes which can be passed to import_ctx().
+        """
+        cdef size_t len = 0
+        cdef char *buf
+        rc = libseccomp.seccomp_export_ctx(self._ctx, NULL, &len)
+        if rc != 0:
+            raise RuntimeError(str.format("Library error (errno = {0})", rc))
+        buf = <char *>malloc(len)
+        if buf == NULL:
+            raise MemoryError()
+        try:
+            rc = libseccomp.seccomp_export_ctx(self._ctx, buf, &len)
+            if rc != 0:
+                raise RuntimeError(str.format("Library error (errno = {0})",
+                                              rc))
+            return buf[:len]
+        finally:
+            free(buf)
+
+    def import_ctx(self, bytes data):
+        """ Replace the filter with one exported in a binary format.
+
+        Arguments:
+        data - the output of export_ctx()
+
+        Description:
+        Replace the filter's attributes, architectures, rules and syscall
+        priorities with the ones exported by export_ctx().
+        """
+        cdef libseccomp.scmp_filter_ctx ctx
+        cdef char *buf
+        # copy the data to meet the alignment requirements
+        buf = <char *>malloc(len(data))
+        if buf == NULL:
+            raise MemoryError()
+        try:
+            memcpy(buf, <char *>data, len(data))
+            rc = libseccomp.seccomp_import_ctx(buf, len(data), &ctx)
+        finally:
+            free(buf)
+        if rc == -errno.EINVAL:
+            raise ValueError("Invalid filter data")
+        if rc != 0:
+            raise RuntimeError(str.format("Library error (errno = {0})", rc))
+        libseccomp.seccomp_release(self._ctx)
+        self._ctx = ctx
+
 # kate: syntax python;
 # kate: indent-mode python; space-indent on; indent-width 4; mixedindent off;
@@ -26,6 +26,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <sys/prctl.h>
 
@@ -56,6 +57,18 @@ static int _support_seccomp_flag_spec_allow = -1;
 static int _support_seccomp_flag_new_listener = -1;
 static int _support_seccomp_user_notif = -1;
 
+/**
+ * A filter prepared for loading
+ */
+struct sys_filter_prep {
+	/* the SCMP_LOAD_* flags */
+	uint32_t flags;
+
+	/* the BPF programs, the instructions are stored after the array */
+	unsigned int prgm_cnt;
+	struct bpf_program prgms[];
+};
+
 /**
  * Check to see if the seccomp() syscall is supported
  *
@@ -294,65 +307,249 @@ void sys_set_seccomp_flag(int flag, bool enable)
 }
 
 /**
- * Loads the filter into the kernel
- * @param col the filter collection
+ * Load a single BPF program into the kernel
+ * @param prgm the BPF program
+ * @param flags the SCMP_LOAD_* flags
  *
- * This function loads the given seccomp filter context into the kernel.  If
- * the filter was loaded correctly, the kernel will be enforcing the filter
- * when this function returns.  Returns zero on success, negative values on
- * error.
+ * This function loads the given BPF program into the kernel using the given
+ * flags; NO_NEW_PRIVS is not handled here and must be set by the caller.
+ * Returns zero, or the notification fd if SCMP_LOAD_NEW_LISTENER is given, on
+ * success, negative values on error.
  *
  */
-int sys_filter_load(struct db_filter_col *col)
+static int _sys_filter_load_prgm(const struct bpf_program *prgm,
+				 uint32_t flags)
 {
 	int rc;
-	struct bpf_program *prgm = NULL;
-
-	prgm = gen_bpf_generate(col);
-	if (prgm == NULL)
-		return -ENOMEM;
-
-	/* attempt to set NO_NEW_PRIVS */
-	if (col->attr.nnp_enable) {
-		rc = prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
-		if (rc < 0)
-			goto filter_load_out;
-	}
 
 	/* load the filter into the kernel */
 	if (sys_chk_seccomp_syscall() == 1) {
 		int flgs = 0;
-		if (col->attr.tsync_enable)
+		if (flags & SCMP_LOAD_TSYNC)
 			flgs |= SECCOMP_FILTER_FLAG_TSYNC;
-		if (col->attr.log_enable)
+		if (flags & SCMP_LOAD_LOG)
 			flgs |= SECCOMP_FILTER_FLAG_LOG;
-		if (col->attr.spec_allow)
+		if (flags & SCMP_LOAD_SPEC_ALLOW)
 			flgs |= SECCOMP_FILTER_FLAG_SPEC_ALLOW;
-
-      if (_support_seccomp_user_notif > 0 && col->notify_used)
-         flgs |= SECCOMP_FILTER_FLAG_NEW_LISTENER;
+		if (flags & SCMP_LOAD_NEW_LISTENER)
+			flgs |= SECCOMP_FILTER_FLAG_NEW_LISTENER;
 
 		rc = syscall(_nr_seccomp, SECCOMP_SET_MODE_FILTER, flgs, prgm);
 
-		if (rc > 0 && col->attr.tsync_enable)
+		if (rc > 0 && !(flags & SCMP_LOAD_NEW_LISTENER)) {
 			/* always return -ESRCH if we fail to sync threads */
 			errno = ESRCH;
-		if (rc > 0 && _support_seccomp_user_notif > 0) {
-			/* return 0 on NEW_LISTENER success, but save the fd */
-			col->notify_fd = rc;
-			rc = 0;
+			rc = -1;
 		}
 	} else
 		rc = prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, prgm);
 
-filter_load_out:
-	/* cleanup and return */
-	gen_bpf_release(prgm);
 	if (rc < 0)
 		return -errno;
 	return rc;
 }
 
+/**
+ * Prepare a filter collection for loading
+ * @param col the filter collection
+ * @param prep the prepared filter
+ *
+ * This function generates the BPF program(s) for the given filter collection
+ * and copies them, along with the load flags configured in the collection,
+ * into a single block of memory which can later be loaded with
+ * sys_filter_load_prepared().  The seccomp() syscall support is checked here
+ * so that loading the prepared filter does not need to.  Returns zero on
+ * success, negative values on error.
+ *
+ */
+int sys_filter_prepare(struct db_filter_col *col, struct sys_filter_prep **prep)
+{
+	int rc = 0;
+	unsigned int prgm_cnt = 1;
+	unsigned int iter;
+	size_t size;
+	bpf_instr_raw *blks;
+	struct bpf_program *prgm = NULL;
+	struct bpf_program **stack = NULL;
+	struct bpf_program **prgms = &prgm;
+	struct sys_filter_prep *p;
+
+	if (col->attr.split_enable) {
+		rc = gen_bpf_generate_stack(col, &stack);
+		if (rc < 0)
+			return rc;
+		prgm_cnt = rc;
+		prgms = stack;
+	} else {
+		prgm = gen_bpf_generate(col);
+		if (prgm == NULL)
+			return -ENOMEM;
+	}
+
+	size = sizeof(*p) + prgm_cnt * sizeof(p->prgms[0]);
+	for (iter = 0; iter < prgm_cnt; iter++)
+		size += BPF_PGM_SIZE(prgms[iter]);
+	p = zmalloc(size);
+	if (p == NULL) {
+		rc = -ENOMEM;
+		goto filter_prepare_out;
+	}
+
+	/* the instructions follow the program array */
+	blks = (bpf_instr_raw *)&p->prgms[prgm_cnt];
+	for (iter = 0; iter < prgm_cnt; iter++) {
+		p->prgms[iter].blk_cnt = prgms[iter]->blk_cnt;
+		p->prgms[iter].blks = blks;
+		memcpy(blks, prgms[iter]->blks, BPF_PGM_SIZE(prgms[iter]));
+		blks += prgms[iter]->blk_cnt;
+	}
+	p->prgm_cnt = prgm_cnt;
+
+	if (col->attr.nnp_enable)
+		p->flags |= SCMP_LOAD_NNP;
+	if (col->attr.tsync_enable)
+		p->flags |= SCMP_LOAD_TSYNC;
+	if (col->attr.log_enable)
+		p->flags |= SCMP_LOAD_LOG;
+	if (col->attr.spec_allow)
+		p->flags |= SCMP_LOAD_SPEC_ALLOW;
+	if (_support_seccomp_user_notif > 0 && col->notify_used)
+		p->flags |= SCMP_LOAD_NEW_LISTENER;
+
+	sys_chk_seccomp_syscall();
+
+	*prep = p;
+	rc = 0;
+
+filter_prepare_out:
+	gen_bpf_release(prgm);
+	gen_bpf_release_stack(stack);
+	return rc;
+}
+
+/**
+ * Loads a prepared filter into the kernel
+ * @param prep the prepared filter
+ *
+ * This function loads the given prepared filter into the kernel.  If the
+ * filter is a stack of BPF programs the first program is loaded last, as it is
+ * the only one which may restrict the seccomp() and prctl() syscalls needed to
+ * load the others, and it is the only one which may request a notification fd;
+ * a failure part way through leaves the programs loaded so far in place.  This
+ * function only makes the prctl() and seccomp() syscalls, it does not allocate
+ * or free any memory and it is async-signal-safe.  Returns zero, or the
+ * notification fd if one was requested, on success, negative values on error.
+ *
+ */
+int sys_filter_load_prepared(const struct sys_filter_prep *prep)
+{
+	int rc;
+	unsigned int iter;
+	uint32_t flags = prep->flags & ~SCMP_LOAD_NEW_LISTENER;
+
+	/* attempt to set NO_NEW_PRIVS */
+	if (prep->flags & SCMP_LOAD_NNP) {
+		rc = prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+		if (rc < 0)
+			return -errno;
+	}
+
+	for (iter = prep->prgm_cnt - 1; iter > 0; iter--) {
+		rc = _sys_filter_load_prgm(&prep->prgms[iter], flags);
+		if (rc < 0)
+			return rc;
+	}
+	return _sys_filter_load_prgm(&prep->prgms[0], prep->flags);
+}
+
+/**
+ * Free a prepared filter
+ * @param prep the prepared filter
+ *
+ * Free the memory associated with a filter prepared by sys_filter_prepare().
+ *
+ */
+void sys_filter_prepare_release(struct sys_filter_prep *prep)
+{
+	free(prep);
+}
+
+/**
+ * Loads the filter into the kernel
+ * @param col the filter collection
+ *
+ * This function loads the given seccomp filter context into the kernel.  If
+ * the filter was loaded correctly, the kernel will be enforcing the filter
+ * when this function returns.  If splitting is enabled and the filter is too
+ * large for a single BPF program it is loaded as a stack of filters; a
+ * failure part way through leaves the filters loaded so far in place.
+ * Returns zero on success, negative values on error.
+ *
+ */
+int sys_filter_load(struct db_filter_col *col)
+{
+	int rc;
+	struct sys_filter_prep *prep;
+
+	rc = sys_filter_prepare(col, &prep);
+	if (rc < 0)
+		return rc;
+
+	rc = sys_filter_load_prepared(prep);
+	if (rc >= 0) {
+		/* return 0 on NEW_LISTENER success, but save the fd */
+		if (rc > 0)
+			col->notify_fd = rc;
+		col->stats.filters = prep->prgm_cnt;
+		rc = 0;
+	}
+
+	sys_filter_prepare_release(prep);
+	return rc;
+}
+
+/**
+ * Loads a raw BPF program into the kernel
+ * @param prgm the BPF program
+ * @param flags the SCMP_LOAD_* flags
+ *
+ * This function loads the given BPF program into the kernel, setting
+ * NO_NEW_PRIVS first if requested.  The flags are checked against the
+ * capabilities of the running kernel before anything is changed.  Returns
+ * zero, or the notification fd if SCMP_LOAD_NEW_LISTENER is given, on success,
+ * negative values on error.
+ *
+ */
+int sys_filter_load_raw(const struct bpf_program *prgm, uint32_t flags)
+{
+	int rc;
+
+	/* kernel disallows TSYNC and NEW_LISTENER in one filter */
+	if ((flags & SCMP_LOAD_TSYNC) && (flags & SCMP_LOAD_NEW_LISTENER))
+		return -EINVAL;
+	if ((flags & SCMP_LOAD_TSYNC) &&
+	    sys_chk_seccomp_flag(SECCOMP_FILTER_FLAG_TSYNC) != 1)
+		return -EOPNOTSUPP;
+	if ((flags & SCMP_LOAD_LOG) &&
+	    sys_chk_seccomp_flag(SECCOMP_FILTER_FLAG_LOG) != 1)
+		return -EOPNOTSUPP;
+	if ((flags & SCMP_LOAD_SPEC_ALLOW) &&
+	    sys_chk_seccomp_flag(SECCOMP_FILTER_FLAG_SPEC_ALLOW) != 1)
+		return -EOPNOTSUPP;
+	if ((flags & SCMP_LOAD_NEW_LISTENER) &&
+	    sys_chk_seccomp_flag(SECCOMP_FILTER_FLAG_NEW_LISTENER) != 1)
+		return -EOPNOTSUPP;
+
+	/* attempt to set NO_NEW_PRIVS */
+	if (flags & SCMP_LOAD_NNP) {
+		rc = prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+		if (rc < 0)
+			return -errno;
+	}
+
+	return _sys_filter_load_prgm(prgm, flags);
+}
+
 int sys_notify_alloc(struct seccomp_notif **req,
 		     struct seccomp_notif_resp **resp)
 {
@@ -40,6 +40,8 @@
 #define MAX_ERRNO		4095
 
 struct db_filter_col;
+struct bpf_program;
+struct sys_filter_prep;
 
 #ifdef HAVE_LINUX_SECCOMP_H
 
@@ -210,6 +212,10 @@ int sys_chk_seccomp_flag(int flag);
 void sys_set_seccomp_flag(int flag, bool enable);
 
 int sys_filter_load(struct db_filter_col *col);
+int sys_filter_load_raw(const struct bpf_program *prgm, uint32_t flags);
+int sys_filter_prepare(struct db_filter_col *col, struct sys_filter_prep **prep);
+int sys_filter_load_prepared(const struct sys_filter_prep *prep);
+void sys_filter_prepare_release(struct sys_filter_prep *prep);
 
 int sys_notify_alloc(struct seccomp_notif **req,
 		     struct seccomp_notif_resp **resp);
@@ -31,6 +31,7 @@ int main(int argc, char *argv[])
 {
 	int rc;
 	int iter;
+	uint64_t val;
 	struct util_options opts;
 	scmp_filter_ctx ctx = NULL;
 
@@ -74,6 +75,13 @@ int main(int argc, char *argv[])
 	if (rc)
 		goto out;
 
+	/* the chains are long enough to require trampolines */
+	rc = seccomp_stat_get(ctx, SCMP_FLTSTAT_TRAMPOLINES, &val);
+	if (rc != 0)
+		goto out;
+	if (opts.bpf_flg && val == 0)
+		rc = -EFAULT;
+
 out:
 	seccomp_release(ctx);
 	return (rc < 0 ? -rc : rc);
@@ -50,6 +50,8 @@ def test(args):
 args = util.get_opt()
 ctx = test(args)
 util.filter_output(args, ctx)
+if args.bpf and ctx.get_stat(Stat.TRAMPOLINES) == 0:
+    raise RuntimeError("Failed adding long jump trampolines")
 
 # kate: syntax python;
 # kate: indent-mode python; space-indent on; indent-width 4; mixedindent off;
@@ -120,6 +120,76 @@ int main(int argc, char *argv[])
 		goto out;
 	}
 
+	rc = seccomp_attr_set(ctx, SCMP_FLTATR_CTL_OPTIMIZE, 2);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_attr_get(ctx, SCMP_FLTATR_CTL_OPTIMIZE, &val);
+	if (rc != 0)
+		goto out;
+	if (val != 2) {
+		rc = -1;
+		goto out;
+	}
+	rc = seccomp_attr_set(ctx, SCMP_FLTATR_CTL_OPTIMIZE, 3);
+	if (rc != -EINVAL) {
+		rc = -1;
+		goto out;
+	}
+
+	rc = seccomp_attr_get(ctx, SCMP_FLTATR_CTL_PEEPHOLE, &val);
+	if (rc != 0)
+		goto out;
+	if (val != 1) {
+		rc = -1;
+		goto out;
+	}
+	rc = seccomp_attr_set(ctx, SCMP_FLTATR_CTL_PEEPHOLE, 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_attr_get(ctx, SCMP_FLTATR_CTL_PEEPHOLE, &val);
+	if (rc != 0)
+		goto out;
+	if (val != 0) {
+		rc = -1;
+		goto out;
+	}
+
+	rc = seccomp_attr_get(ctx, SCMP_FLTATR_CTL_SPLIT, &val);
+	if (rc != 0)
+		goto out;
+	if (val != 0) {
+		rc = -1;
+		goto out;
+	}
+	rc = seccomp_attr_set(ctx, SCMP_FLTATR_CTL_SPLIT, 1);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_attr_get(ctx, SCMP_FLTATR_CTL_SPLIT, &val);
+	if (rc != 0)
+		goto out;
+	if (val != 1) {
+		rc = -1;
+		goto out;
+	}
+
+	rc = seccomp_attr_get(ctx, SCMP_FLTATR_CTL_PARALLEL, &val);
+	if (rc != 0)
+		goto out;
+	if (val != 0) {
+		rc = -1;
+		goto out;
+	}
+	rc = seccomp_attr_set(ctx, SCMP_FLTATR_CTL_PARALLEL, 1);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_attr_get(ctx, SCMP_FLTATR_CTL_PARALLEL, &val);
+	if (rc != 0)
+		goto out;
+	if (val != 1) {
+		rc = -1;
+		goto out;
+	}
+
 	rc = 0;
 out:
 	seccomp_release(ctx);
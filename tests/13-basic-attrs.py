@@ -55,6 +55,18 @@ def test():
     f.set_attr(Attr.CTL_SSB, 1)
     if f.get_attr(Attr.CTL_SSB) != 1:
         raise RuntimeError("Failed getting Attr.CTL_SSB")
+    f.set_attr(Attr.CTL_OPTIMIZE, 2)
+    if f.get_attr(Attr.CTL_OPTIMIZE) != 2:
+        raise RuntimeError("Failed getting Attr.CTL_OPTIMIZE")
+    f.set_attr(Attr.CTL_PEEPHOLE, 0)
+    if f.get_attr(Attr.CTL_PEEPHOLE) != 0:
+        raise RuntimeError("Failed getting Attr.CTL_PEEPHOLE")
+    f.set_attr(Attr.CTL_SPLIT, 1)
+    if f.get_attr(Attr.CTL_SPLIT) != 1:
+        raise RuntimeError("Failed getting Attr.CTL_SPLIT")
+    f.set_attr(Attr.CTL_PARALLEL, 1)
+    if f.get_attr(Attr.CTL_PARALLEL) != 1:
+        raise RuntimeError("Failed getting Attr.CTL_PARALLEL")
 
 test()
 
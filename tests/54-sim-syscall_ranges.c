@@ -0,0 +1,100 @@
+/**
+ * Seccomp Library test program
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <seccomp.h>
+
+#include "util.h"
+
+int main(int argc, char *argv[])
+{
+	int rc;
+	int iter;
+	struct util_options opts;
+	scmp_filter_ctx ctx = NULL;
+
+	rc = util_getopt(argc, argv, &opts);
+	if (rc < 0)
+		goto out;
+
+	ctx = seccomp_init(SCMP_ACT_KILL);
+	if (ctx == NULL)
+		return ENOMEM;
+
+	/* the syscall and argument numbers are all fake to make the test
+	 * simpler */
+
+	/* range with holes at 1005 and 1012 */
+	for (iter = 1000; iter < 1020; iter++) {
+		if (iter == 1005 || iter == 1012)
+			continue;
+		rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ALLOW, iter, 0);
+		if (rc != 0)
+			goto out;
+	}
+	/* argument chain, breaks the range */
+	rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ALLOW, 1020, 1,
+				    SCMP_A0(SCMP_CMP_EQ, 0));
+	if (rc != 0)
+		goto out;
+	/* range without holes */
+	for (iter = 1021; iter < 1030; iter++) {
+		rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ALLOW, iter, 0);
+		if (rc != 0)
+			goto out;
+	}
+	/* different action, new range */
+	for (iter = 1030; iter < 1036; iter++) {
+		rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ERRNO(5), iter, 0);
+		if (rc != 0)
+			goto out;
+	}
+	/* too short for a range */
+	for (iter = 1040; iter < 1042; iter++) {
+		rc = seccomp_rule_add_exact(ctx, SCMP_ACT_TRAP, iter, 0);
+		if (rc != 0)
+			goto out;
+	}
+	/* too many holes for a range */
+	for (iter = 1050; iter < 1055; iter += 2) {
+		rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ALLOW, iter, 0);
+		if (rc != 0)
+			goto out;
+	}
+	/* different priority, breaks the range */
+	rc = seccomp_syscall_priority(ctx, 1061, 5);
+	if (rc != 0)
+		goto out;
+	for (iter = 1060; iter < 1066; iter++) {
+		rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ALLOW, iter, 0);
+		if (rc != 0)
+			goto out;
+	}
+
+	rc = util_filter_output(&opts, ctx);
+	if (rc)
+		goto out;
+
+out:
+	seccomp_release(ctx);
+	return (rc < 0 ? -rc : rc);
+}
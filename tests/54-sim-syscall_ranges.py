@@ -0,0 +1,56 @@
+#!/usr/bin/env python
+
+#
+# Seccomp Library test program
+#
+# Copyright (c) 2020 Nestybox, Inc.
+#
+
+#
+# This library is free software; you can redistribute it and/or modify it
+# under the terms of version 2.1 of the GNU Lesser General Public License as
+# published by the Free Software Foundation.
+#
+# This library is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+# for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this library; if not, see <http://www.gnu.org/licenses>.
+#
+
+import argparse
+import sys
+
+import util
+
+from seccomp import *
+
+def test(args):
+    f = SyscallFilter(KILL)
+    # the syscall and argument numbers are all fake to make the test simpler
+    for i in range(1000, 1020):
+        if i in (1005, 1012):
+            continue
+        f.add_rule_exactly(ALLOW, i)
+    f.add_rule_exactly(ALLOW, 1020, Arg(0, EQ, 0))
+    for i in range(1021, 1030):
+        f.add_rule_exactly(ALLOW, i)
+    for i in range(1030, 1036):
+        f.add_rule_exactly(ERRNO(5), i)
+    for i in range(1040, 1042):
+        f.add_rule_exactly(TRAP, i)
+    for i in range(1050, 1055, 2):
+        f.add_rule_exactly(ALLOW, i)
+    f.syscall_priority(1061, 5)
+    for i in range(1060, 1066):
+        f.add_rule_exactly(ALLOW, i)
+    return f
+
+args = util.get_opt()
+ctx = test(args)
+util.filter_output(args, ctx)
+
+# kate: syntax python;
+# kate: indent-mode python; space-indent on; indent-width 4; mixedindent off;
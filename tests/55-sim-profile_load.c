@@ -0,0 +1,235 @@
+/**
+ * Seccomp Library test program
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/filter.h>
+
+#include <seccomp.h>
+
+#include "util.h"
+
+/* the output of "scmp_app_inspector -f" */
+static const char *profile =
+	"============================================================\n"
+	"Syscall Report (\"./app\")\n"
+	"   freq syscall\n"
+	"============================================================\n"
+	"    812 getpid\n"
+	"    500 read\n"
+	"    500 futex\n"
+	"     20 close\n"
+	"      3 openat\n"
+	"      1 --- SIGCHLD {si_signo=SIGCHLD} ---\n"
+	"      1 exit_group\n"
+	"      1 +++ exited with 0 +++\n";
+static const char *profile_bad = "    42\n";
+
+static const uint32_t order_arch[] = {
+	SCMP_ARCH_X86_64,
+	SCMP_ARCH_X86,
+	SCMP_ARCH_AARCH64,
+	SCMP_ARCH_ARM,
+	SCMP_ARCH_PPC64LE,
+};
+
+/* the expected dispatch order, a lower rank must be checked first */
+static const struct {
+	const char *name;
+	unsigned int rank;
+} order_sys[] = {
+	{ "read", 0 },
+	{ "futex", 0 },
+	{ "close", 1 },
+	{ "openat", 2 },
+	{ "exit_group", 3 },
+	{ "write", 3 },
+};
+
+#define ORDER_SYS_CNT	(sizeof(order_sys) / sizeof(order_sys[0]))
+#define ORDER_ARCH_CNT	(sizeof(order_arch) / sizeof(order_arch[0]))
+
+static int order_check(scmp_filter_ctx ctx, uint32_t optimize)
+{
+	int rc;
+	int fds[2];
+	ssize_t len;
+	unsigned int iter, a, s, s_b, cnt;
+	unsigned int pos[ORDER_SYS_CNT];
+	int num;
+	struct sock_filter prog[1024];
+	const uint16_t jeq = BPF_JMP | BPF_JEQ | BPF_K;
+
+	rc = seccomp_attr_set(ctx, SCMP_FLTATR_CTL_OPTIMIZE, optimize);
+	if (rc != 0)
+		return rc;
+
+	if (pipe(fds) < 0)
+		return -errno;
+	rc = seccomp_export_bpf(ctx, fds[1]);
+	close(fds[1]);
+	if (rc != 0) {
+		close(fds[0]);
+		return rc;
+	}
+	len = read(fds[0], prog, sizeof(prog));
+	close(fds[0]);
+	if (len < 0)
+		return -errno;
+	cnt = len / sizeof(prog[0]);
+
+	for (a = 0; a < ORDER_ARCH_CNT; a++) {
+		/* find the start of the arch filter */
+		for (iter = 0; iter < cnt; iter++) {
+			if (prog[iter].code == jeq &&
+			    prog[iter].k == order_arch[a])
+				break;
+		}
+		if (iter == cnt)
+			return -ENOENT;
+
+		/* find the first check of each syscall */
+		for (s = 0; s < ORDER_SYS_CNT; s++) {
+			num = seccomp_syscall_resolve_name_arch(order_arch[a],
+							order_sys[s].name);
+			if (num < 0)
+				return -ENOENT;
+			for (pos[s] = iter + 1; pos[s] < cnt; pos[s]++) {
+				if (prog[pos[s]].code == jeq &&
+				    prog[pos[s]].k == (uint32_t)num)
+					break;
+			}
+			if (pos[s] == cnt)
+				return -ENOENT;
+		}
+
+		for (s = 0; s < ORDER_SYS_CNT; s++) {
+			for (s_b = 0; s_b < ORDER_SYS_CNT; s_b++) {
+				if (order_sys[s].rank < order_sys[s_b].rank &&
+				    pos[s] > pos[s_b])
+					return -EFAULT;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int profile_load(scmp_filter_ctx ctx, const char *text)
+{
+	int rc;
+	int fds[2];
+	ssize_t len;
+
+	if (pipe(fds) < 0)
+		return -errno;
+	len = write(fds[1], text, strlen(text));
+	close(fds[1]);
+	if (len < 0) {
+		close(fds[0]);
+		return -errno;
+	}
+	rc = seccomp_profile_load(ctx, fds[0]);
+	close(fds[0]);
+
+	return rc;
+}
+
+int main(int argc, char *argv[])
+{
+	int rc;
+	struct util_options opts;
+	scmp_filter_ctx ctx = NULL;
+
+	rc = util_getopt(argc, argv, &opts);
+	if (rc < 0)
+		goto out;
+
+	ctx = seccomp_init(SCMP_ACT_KILL);
+	if (ctx == NULL)
+		return ENOMEM;
+
+	/* getpid has no rule so it is a priority only entry at the head of
+	 * the syscall list, check the arches which reload the syscall */
+	rc = seccomp_arch_remove(ctx, SCMP_ARCH_NATIVE);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_arch_add(ctx, SCMP_ARCH_X86_64);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_arch_add(ctx, SCMP_ARCH_X86);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_arch_add(ctx, SCMP_ARCH_AARCH64);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_arch_add(ctx, SCMP_ARCH_ARM);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_arch_add(ctx, SCMP_ARCH_PPC64LE);
+	if (rc != 0)
+		goto out;
+
+	rc = profile_load(ctx, profile_bad);
+	if (rc != -EINVAL) {
+		rc = -1;
+		goto out;
+	}
+	rc = profile_load(ctx, profile);
+	if (rc != 0)
+		goto out;
+
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(read), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(close), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(futex), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(exit_group), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ERRNO(5), SCMP_SYS(openat), 1,
+			      SCMP_A0(SCMP_CMP_EQ, 42));
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_TRAP, SCMP_SYS(write), 0);
+	if (rc != 0)
+		goto out;
+
+	/* the profiled syscalls must be dispatched first in both layouts */
+	rc = order_check(ctx, 2);
+	if (rc != 0)
+		goto out;
+	rc = order_check(ctx, 1);
+	if (rc != 0)
+		goto out;
+
+	rc = util_filter_output(&opts, ctx);
+	if (rc)
+		goto out;
+
+out:
+	seccomp_release(ctx);
+	return (rc < 0 ? -rc : rc);
+}
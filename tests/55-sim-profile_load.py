@@ -0,0 +1,110 @@
+#!/usr/bin/env python
+
+#
+# Seccomp Library test program
+#
+# Copyright (c) 2020 Nestybox, Inc.
+#
+
+#
+# This library is free software; you can redistribute it and/or modify it
+# under the terms of version 2.1 of the GNU Lesser General Public License as
+# published by the Free Software Foundation.
+#
+# This library is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+# for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this library; if not, see <http://www.gnu.org/licenses>.
+#
+
+import argparse
+import os
+import struct
+import sys
+import tempfile
+
+import util
+
+from seccomp import *
+
+def profile_load(f, text):
+    r, w = os.pipe()
+    os.write(w, text.encode())
+    os.close(w)
+    with os.fdopen(r) as profile:
+        f.load_profile(profile)
+
+# the expected dispatch order, a lower rank must be checked first
+order_sys = [("read", 0), ("futex", 0), ("close", 1), ("openat", 2),
+             ("exit_group", 3), ("write", 3)]
+order_arch = [Arch.X86_64, Arch.X86, Arch.AARCH64, Arch.ARM, Arch.PPC64LE]
+
+def order_check(f, optimize):
+    f.set_attr(Attr.CTL_OPTIMIZE, optimize)
+    with tempfile.TemporaryFile() as bpf:
+        f.export_bpf(bpf)
+        bpf.seek(0)
+        data = bpf.read()
+    prog = [struct.unpack("=HBBI", data[i:i + 8])
+            for i in range(0, len(data), 8)]
+    jeq = [i for i, (code, jt, jf, k) in enumerate(prog) if code == 0x15]
+    for arch in order_arch:
+        start = [i for i in jeq if prog[i][3] == arch][0]
+        pos = {}
+        for name, rank in order_sys:
+            num = resolve_syscall(arch, name)
+            pos[name] = [i for i in jeq if i > start and prog[i][3] == num][0]
+        for name, rank in order_sys:
+            for name_b, rank_b in order_sys:
+                if rank < rank_b and pos[name] > pos[name_b]:
+                    raise RuntimeError("Profile did not reorder the filter")
+
+def test(args):
+    f = SyscallFilter(KILL)
+    # getpid has no rule so it is a priority only entry at the head of the
+    # syscall list, check the arches which reload the syscall
+    f.remove_arch(Arch())
+    f.add_arch(Arch("x86_64"))
+    f.add_arch(Arch("x86"))
+    f.add_arch(Arch("aarch64"))
+    f.add_arch(Arch("arm"))
+    f.add_arch(Arch("ppc64le"))
+    try:
+        profile_load(f, "    42\n")
+    except RuntimeError:
+        pass
+    else:
+        raise RuntimeError("Malformed profile was accepted")
+    # the output of "scmp_app_inspector -f"
+    profile_load(f, "=" * 60 + "\n"
+                    "Syscall Report (\"./app\")\n"
+                    "   freq syscall\n"
+                    + "=" * 60 + "\n"
+                    "    812 getpid\n"
+                    "    500 read\n"
+                    "    500 futex\n"
+                    "     20 close\n"
+                    "      3 openat\n"
+                    "      1 --- SIGCHLD {si_signo=SIGCHLD} ---\n"
+                    "      1 exit_group\n"
+                    "      1 +++ exited with 0 +++\n")
+    f.add_rule(ALLOW, "read")
+    f.add_rule(ALLOW, "close")
+    f.add_rule(ALLOW, "futex")
+    f.add_rule(ALLOW, "exit_group")
+    f.add_rule(ERRNO(5), "openat", Arg(0, EQ, 42))
+    f.add_rule(TRAP, "write")
+    # the profiled syscalls must be dispatched first in both layouts
+    order_check(f, 2)
+    order_check(f, 1)
+    return f
+
+args = util.get_opt()
+ctx = test(args)
+util.filter_output(args, ctx)
+
+# kate: syntax python;
+# kate: indent-mode python; space-indent on; indent-width 4; mixedindent off;
@@ -0,0 +1,81 @@
+/**
+ * Seccomp Library test program
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <seccomp.h>
+
+#include "util.h"
+
+int main(int argc, char *argv[])
+{
+	int rc;
+	uint64_t val;
+	struct util_options opts;
+	scmp_filter_ctx ctx = NULL;
+
+	rc = util_getopt(argc, argv, &opts);
+	if (rc < 0)
+		goto out;
+
+	ctx = seccomp_init(SCMP_ACT_KILL);
+	if (ctx == NULL)
+		return ENOMEM;
+
+	/* the syscall and argument numbers are all fake to make the test
+	 * simpler */
+
+	rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ERRNO(1), 1000, 1,
+				    SCMP_A0(SCMP_CMP_MASKED_EQ, 0xff, 0x01));
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ERRNO(1), 1000, 1,
+				    SCMP_A1(SCMP_CMP_MASKED_EQ, 0xff, 0x02));
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ERRNO(2), 1001, 2,
+				    SCMP_A0(SCMP_CMP_MASKED_EQ, 0xf0, 0x10),
+				    SCMP_A1(SCMP_CMP_EQ, 5));
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ERRNO(2), 1002, 1,
+				    SCMP_A0(SCMP_CMP_MASKED_EQ, 0xf0, 0x10));
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ALLOW, 1003, 0);
+	if (rc != 0)
+		goto out;
+
+	rc = util_filter_output(&opts, ctx);
+	if (rc)
+		goto out;
+
+	/* the masked comparisons should always leave something to remove */
+	rc = seccomp_stat_get(ctx, SCMP_FLTSTAT_PEEPHOLE, &val);
+	if (rc != 0)
+		goto out;
+	if (opts.bpf_flg && val == 0)
+		rc = -EFAULT;
+
+out:
+	seccomp_release(ctx);
+	return (rc < 0 ? -rc : rc);
+}
@@ -0,0 +1,48 @@
+#!/usr/bin/env python
+
+#
+# Seccomp Library test program
+#
+# Copyright (c) 2020 Nestybox, Inc.
+#
+
+#
+# This library is free software; you can redistribute it and/or modify it
+# under the terms of version 2.1 of the GNU Lesser General Public License as
+# published by the Free Software Foundation.
+#
+# This library is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+# for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this library; if not, see <http://www.gnu.org/licenses>.
+#
+
+import argparse
+import sys
+
+import util
+
+from seccomp import *
+
+def test(args):
+    f = SyscallFilter(KILL)
+    # the syscall and argument numbers are all fake to make the test simpler
+    f.add_rule_exactly(ERRNO(1), 1000, Arg(0, MASKED_EQ, 0xff, 0x01))
+    f.add_rule_exactly(ERRNO(1), 1000, Arg(1, MASKED_EQ, 0xff, 0x02))
+    f.add_rule_exactly(ERRNO(2), 1001,
+                       Arg(0, MASKED_EQ, 0xf0, 0x10), Arg(1, EQ, 5))
+    f.add_rule_exactly(ERRNO(2), 1002, Arg(0, MASKED_EQ, 0xf0, 0x10))
+    f.add_rule_exactly(ALLOW, 1003)
+    return f
+
+args = util.get_opt()
+ctx = test(args)
+util.filter_output(args, ctx)
+if args.bpf and ctx.get_stat(Stat.PEEPHOLE) == 0:
+    raise RuntimeError("Failed removing instructions")
+
+# kate: syntax python;
+# kate: indent-mode python; space-indent on; indent-width 4; mixedindent off;
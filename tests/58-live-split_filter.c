@@ -0,0 +1,147 @@
+/**
+ * Seccomp Library test program
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <seccomp.h>
+
+#include "util.h"
+
+#define SPLIT_RULES		300
+#define SPLIT_ERRNO		999
+
+int main(int argc, char *argv[])
+{
+	int rc;
+	int iter;
+	uint64_t val;
+	scmp_filter_ctx ctx = NULL;
+
+	rc = util_action_parse(argv[1]);
+	if (rc != SCMP_ACT_ALLOW) {
+		rc = 1;
+		goto out;
+	}
+
+	ctx = seccomp_init(SCMP_ACT_ERRNO(SPLIT_ERRNO));
+	if (ctx == NULL)
+		return ENOMEM;
+
+	rc = seccomp_attr_set(ctx, SCMP_FLTATR_CTL_SPLIT, 1);
+	if (rc != 0)
+		goto out;
+
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(open), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(openat), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(write), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(close), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(rt_sigreturn), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(exit_group), 0);
+	if (rc != 0)
+		goto out;
+	/* NOTE - releasing the generated filters may return memory to the
+	 *        system after they have been loaded */
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(brk), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(munmap), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_syscall_priority(ctx, SCMP_SYS(write), 255);
+	if (rc != 0)
+		goto out;
+
+	/* NOTE - syscalls referenced by number, they are not valid syscalls
+	 *        but the filter is evaluated before the kernel notices */
+
+	/* enough argument chains to exceed BPF_MAXINSNS */
+	for (iter = 0; iter < SPLIT_RULES; iter++) {
+		rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ERRNO(iter + 1),
+					    1000 + iter, 3,
+					    SCMP_A0(SCMP_CMP_EQ, iter),
+					    SCMP_A1(SCMP_CMP_NE, 0x0),
+					    SCMP_A2(SCMP_CMP_LT, SSIZE_MAX));
+		if (rc != 0)
+			goto out;
+	}
+
+	rc = seccomp_load(ctx);
+	if (rc != 0)
+		goto out;
+
+	rc = seccomp_stat_get(ctx, SCMP_FLTSTAT_FILTERS, &val);
+	if (rc != 0)
+		goto out;
+	if (val < 2) {
+		rc = -EFAULT;
+		goto out;
+	}
+
+	/* every rule must still be enforced, whichever filter it landed in */
+	for (iter = 0; iter < SPLIT_RULES; iter++) {
+		rc = syscall(1000 + iter, iter, 1, 2);
+		if (rc != -1 || errno != iter + 1) {
+			rc = -EFAULT;
+			goto out;
+		}
+	}
+
+	/* arguments which don't match must still get the default action */
+	for (iter = 0; iter < SPLIT_RULES; iter++) {
+		rc = syscall(1000 + iter, iter + SPLIT_RULES, 1, 2);
+		if (rc != -1 || errno != SPLIT_ERRNO) {
+			rc = -EFAULT;
+			goto out;
+		}
+		rc = syscall(1000 + iter, iter, 0, 2);
+		if (rc != -1 || errno != SPLIT_ERRNO) {
+			rc = -EFAULT;
+			goto out;
+		}
+	}
+	rc = syscall(1000 + SPLIT_RULES, 0, 1, 2);
+	if (rc != -1 || errno != SPLIT_ERRNO) {
+		rc = -EFAULT;
+		goto out;
+	}
+
+	rc = util_file_write("/dev/null");
+	if (rc != 0)
+		goto out;
+
+	rc = 160;
+
+out:
+	seccomp_release(ctx);
+	return (rc < 0 ? -rc : rc);
+}
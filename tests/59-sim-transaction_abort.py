@@ -0,0 +1,55 @@
+#!/usr/bin/env python
+
+#
+# Seccomp Library test program
+#
+# Copyright (c) 2020 Nestybox, Inc.
+#
+
+#
+# This library is free software; you can redistribute it and/or modify it
+# under the terms of version 2.1 of the GNU Lesser General Public License as
+# published by the Free Software Foundation.
+#
+# This library is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+# for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this library; if not, see <http://www.gnu.org/licenses>.
+#
+
+import argparse
+import sys
+
+import util
+
+from seccomp import *
+
+def test(args):
+    f = SyscallFilter(KILL)
+    f.remove_arch(Arch())
+    f.add_arch(Arch("x86"))
+    f.add_arch(Arch("aarch64"))
+    f.add_arch(Arch("arm"))
+    # getpid has no rule so it is a priority only entry at the head of the
+    # syscall list, which the aborted transaction must keep
+    f.syscall_priority("getpid", 255)
+    f.add_rule(ALLOW, "write")
+    f.add_rule(ALLOW, "read", Arg(0, EQ, 0))
+    # a conflicting rule aborts the transaction
+    try:
+        f.add_rule(ERRNO(1), "read", Arg(0, EQ, 0))
+    except RuntimeError:
+        pass
+    else:
+        raise RuntimeError("Conflicting rule was accepted")
+    return f
+
+args = util.get_opt()
+ctx = test(args)
+util.filter_output(args, ctx)
+
+# kate: syntax python;
+# kate: indent-mode python; space-indent on; indent-width 4; mixedindent off;
@@ -0,0 +1,104 @@
+/**
+ * Seccomp Library test program
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <seccomp.h>
+
+#include "util.h"
+
+int main(int argc, char *argv[])
+{
+	int rc;
+	struct util_options opts;
+	scmp_filter_ctx ctx = NULL;
+	struct scmp_arg_cmp a_1000[] = { SCMP_A0(SCMP_CMP_EQ, 1),
+					 SCMP_A1(SCMP_CMP_EQ, 2) };
+	struct scmp_arg_cmp a_1001[] = { SCMP_A0(SCMP_CMP_GT, 3) };
+	struct scmp_arg_cmp a_1002[] = { SCMP_A1(SCMP_CMP_MASKED_EQ,
+						 0xff00, 0x5400) };
+	struct scmp_arg_cmp a_bad[] = { SCMP_A0(SCMP_CMP_EQ, 1),
+					SCMP_A0(SCMP_CMP_EQ, 2) };
+	struct scmp_rule rules[] = {
+		{ SCMP_ACT_ALLOW, 1000, 2, a_1000 },
+		{ SCMP_ACT_ALLOW, 1000, 1, &a_1000[1] },
+		{ SCMP_ACT_ERRNO(1), 1001, 1, a_1001 },
+		{ SCMP_ACT_ERRNO(2), 1002, 1, a_1002 },
+		{ SCMP_ACT_ALLOW, 1003, 0, NULL },
+	};
+	struct scmp_rule rules_bad_arg[] = {
+		{ SCMP_ACT_ALLOW, 1004, 0, NULL },
+		{ SCMP_ACT_ALLOW, 1005, 2, a_bad },
+	};
+	struct scmp_rule rules_bad_act[] = {
+		{ SCMP_ACT_ALLOW, 1004, 0, NULL },
+		{ SCMP_ACT_KILL, 1005, 0, NULL },
+	};
+	struct scmp_rule rules_conflict[] = {
+		{ SCMP_ACT_ALLOW, 1004, 0, NULL },
+		{ SCMP_ACT_ERRNO(3), 1001, 1, a_1001 },
+	};
+
+	rc = util_getopt(argc, argv, &opts);
+	if (rc < 0)
+		goto out;
+
+	ctx = seccomp_init(SCMP_ACT_KILL);
+	if (ctx == NULL)
+		return ENOMEM;
+
+	/* the syscall and argument numbers are all fake to make the test
+	 * simpler */
+
+	rc = seccomp_rule_add_bulk(ctx, rules, 5, SCMP_RULE_EXACT);
+	if (rc != 0)
+		goto out;
+
+	/* none of the rules in a failed set should be added */
+	rc = seccomp_rule_add_bulk(ctx, rules_bad_arg, 2, SCMP_RULE_EXACT);
+	if (rc != -EINVAL) {
+		rc = -EFAULT;
+		goto out;
+	}
+	rc = seccomp_rule_add_bulk(ctx, rules_bad_act, 2, SCMP_RULE_EXACT);
+	if (rc != -EPERM) {
+		rc = -EFAULT;
+		goto out;
+	}
+	rc = seccomp_rule_add_bulk(ctx, rules_conflict, 2, SCMP_RULE_EXACT);
+	if (rc != -EEXIST) {
+		rc = -EFAULT;
+		goto out;
+	}
+	rc = seccomp_rule_add_bulk(ctx, rules, 5, ~SCMP_RULE_EXACT);
+	if (rc != -EINVAL) {
+		rc = -EFAULT;
+		goto out;
+	}
+
+	rc = util_filter_output(&opts, ctx);
+	if (rc)
+		goto out;
+
+out:
+	seccomp_release(ctx);
+	return (rc < 0 ? -rc : rc);
+}
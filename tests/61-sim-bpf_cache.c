@@ -0,0 +1,285 @@
+/**
+ * Seccomp Library test program
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <seccomp.h>
+
+#include "util.h"
+
+static int build(scmp_filter_ctx ctx)
+{
+	int rc;
+
+	/* the syscall and argument numbers are all fake to make the test
+	 * simpler */
+
+	rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ERRNO(1), 1000, 1,
+				    SCMP_A0(SCMP_CMP_EQ, 1));
+	if (rc != 0)
+		return rc;
+	rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ERRNO(2), 1001, 2,
+				    SCMP_A0(SCMP_CMP_GT, 3),
+				    SCMP_A1(SCMP_CMP_MASKED_EQ, 0xff00, 0x1200));
+	if (rc != 0)
+		return rc;
+	rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ALLOW, 1002, 0);
+	if (rc != 0)
+		return rc;
+
+	return seccomp_syscall_priority(ctx, 1002, 100);
+}
+
+/* the size of the cache file header, the key follows the header */
+#define CACHE_HDR_LEN		32
+
+struct prgm {
+	uint8_t buf[4096];
+	size_t len;
+};
+
+static int generate(struct prgm *prgm, uint64_t *hits)
+{
+	int rc;
+	scmp_filter_ctx ctx;
+
+	ctx = seccomp_init(SCMP_ACT_KILL);
+	if (ctx == NULL)
+		return -ENOMEM;
+	rc = build(ctx);
+	if (rc != 0)
+		goto out;
+	prgm->len = sizeof(prgm->buf);
+	rc = seccomp_export_bpf_mem(ctx, prgm->buf, &prgm->len);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_stat_get(ctx, SCMP_FLTSTAT_CACHE_HITS, hits);
+
+out:
+	seccomp_release(ctx);
+	return rc;
+}
+
+static int cache_file(const char *dir, char *name, size_t name_len)
+{
+	int rc = -ENOENT;
+	DIR *d;
+	struct dirent *ent;
+
+	d = opendir(dir);
+	if (d == NULL)
+		return -errno;
+	while ((ent = readdir(d)) != NULL) {
+		if (ent->d_name[0] == '.')
+			continue;
+		snprintf(name, name_len, "%s/%s", dir, ent->d_name);
+		rc = 0;
+		break;
+	}
+	closedir(d);
+
+	return rc;
+}
+
+static int cache_check(const struct prgm *ref, uint64_t hits_exp)
+{
+	int rc;
+	uint64_t hits;
+	struct prgm prgm;
+
+	rc = generate(&prgm, &hits);
+	if (rc != 0)
+		return rc;
+	if (hits != hits_exp || prgm.len != ref->len ||
+	    memcmp(prgm.buf, ref->buf, ref->len) != 0)
+		return -EFAULT;
+	return 0;
+}
+
+static int disk_test(void)
+{
+	int rc, fd;
+	char dir[] = "/tmp/61-sim-bpf_cache.XXXXXX";
+	char name[PATH_MAX];
+	uint8_t byte;
+	uint64_t hits;
+	struct prgm ref;
+
+	/* generate the filter without the cache */
+	rc = seccomp_cache_set(0, NULL);
+	if (rc != 0)
+		return rc;
+	rc = generate(&ref, &hits);
+	if (rc != 0)
+		return rc;
+
+	if (mkdtemp(dir) == NULL)
+		return -errno;
+
+	/* only keep the filters on disk, not in memory */
+	rc = seccomp_cache_set(0, dir);
+	if (rc != 0)
+		goto out;
+	rc = cache_check(&ref, 0);
+	if (rc != 0)
+		goto out;
+	rc = cache_file(dir, name, sizeof(name));
+	if (rc != 0)
+		goto out;
+	rc = cache_check(&ref, 1);
+	if (rc != 0)
+		goto out;
+
+	/* a truncated file must be regenerated */
+	if (truncate(name, CACHE_HDR_LEN + 1) < 0) {
+		rc = -errno;
+		goto out;
+	}
+	rc = cache_check(&ref, 0);
+	if (rc != 0)
+		goto out;
+	rc = cache_check(&ref, 1);
+	if (rc != 0)
+		goto out;
+
+	/* as must a file with a different key */
+	fd = open(name, O_RDWR);
+	if (fd < 0) {
+		rc = -errno;
+		goto out;
+	}
+	if (pread(fd, &byte, 1, CACHE_HDR_LEN) != 1) {
+		rc = -EIO;
+		close(fd);
+		goto out;
+	}
+	byte ^= 0xff;
+	if (pwrite(fd, &byte, 1, CACHE_HDR_LEN) != 1)
+		rc = -EIO;
+	close(fd);
+	if (rc != 0)
+		goto out;
+	rc = cache_check(&ref, 0);
+	if (rc != 0)
+		goto out;
+	rc = cache_check(&ref, 1);
+
+out:
+	seccomp_cache_set(0, NULL);
+	while (cache_file(dir, name, sizeof(name)) == 0)
+		if (unlink(name) < 0)
+			break;
+	rmdir(dir);
+	return rc;
+}
+
+int main(int argc, char *argv[])
+{
+	int rc, fd = -1;
+	uint64_t val;
+	struct util_options opts;
+	scmp_filter_ctx ctx = NULL, ctx_prev = NULL;
+
+	rc = util_getopt(argc, argv, &opts);
+	if (rc < 0)
+		goto out;
+
+	/* share the filter through the cache directory */
+	rc = disk_test();
+	if (rc != 0)
+		goto out;
+
+	rc = seccomp_cache_set(4, NULL);
+	if (rc != 0)
+		goto out;
+	fd = open("/dev/null", O_WRONLY);
+	if (fd < 0) {
+		rc = -errno;
+		goto out;
+	}
+
+	/* generate the filter once to fill the cache */
+	ctx_prev = seccomp_init(SCMP_ACT_KILL);
+	if (ctx_prev == NULL) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	rc = build(ctx_prev);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_export_bpf(ctx_prev, fd);
+	if (rc != 0)
+		goto out;
+
+	/* an identical filter should come from the cache */
+	ctx = seccomp_init(SCMP_ACT_KILL);
+	if (ctx == NULL) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	rc = build(ctx);
+	if (rc != 0)
+		goto out;
+	rc = util_filter_output(&opts, ctx);
+	if (rc)
+		goto out;
+	rc = seccomp_stat_get(ctx, SCMP_FLTSTAT_CACHE_HITS, &val);
+	if (rc != 0)
+		goto out;
+	if (opts.bpf_flg && val != 1) {
+		rc = -EFAULT;
+		goto out;
+	}
+
+	/* a changed filter must not come from the cache */
+	rc = seccomp_rule_add_exact(ctx_prev, SCMP_ACT_ALLOW, 1003, 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_export_bpf(ctx_prev, fd);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_stat_get(ctx_prev, SCMP_FLTSTAT_CACHE_HITS, &val);
+	if (rc != 0)
+		goto out;
+	if (val != 0) {
+		rc = -EFAULT;
+		goto out;
+	}
+	rc = seccomp_stat_get(ctx_prev, SCMP_FLTSTAT_CACHE_MISSES, &val);
+	if (rc != 0)
+		goto out;
+	if (val != 2)
+		rc = -EFAULT;
+
+out:
+	if (fd >= 0)
+		close(fd);
+	seccomp_cache_set(0, NULL);
+	seccomp_release(ctx_prev);
+	seccomp_release(ctx);
+	return (rc < 0 ? -rc : rc);
+}
@@ -0,0 +1,105 @@
+#!/usr/bin/env python
+
+#
+# Seccomp Library test program
+#
+# Copyright (c) 2020 Nestybox, Inc.
+#
+
+#
+# This library is free software; you can redistribute it and/or modify it
+# under the terms of version 2.1 of the GNU Lesser General Public License as
+# published by the Free Software Foundation.
+#
+# This library is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+# for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this library; if not, see <http://www.gnu.org/licenses>.
+#
+
+import argparse
+import os
+import shutil
+import sys
+import tempfile
+
+import util
+
+from seccomp import *
+
+def build():
+    f = SyscallFilter(KILL)
+    # the syscall and argument numbers are all fake to make the test simpler
+    f.add_rule_exactly(ERRNO(1), 1000, Arg(0, EQ, 1))
+    f.add_rule_exactly(ERRNO(2), 1001,
+                       Arg(0, GT, 3), Arg(1, MASKED_EQ, 0xff00, 0x1200))
+    f.add_rule_exactly(ALLOW, 1002)
+    f.syscall_priority(1002, 100)
+    return f
+
+# the size of the cache file header, the key follows the header
+CACHE_HDR_LEN = 32
+
+def cache_check(ref, hits):
+    f = build()
+    bpf = f.export_bpf_mem()
+    if f.get_stat(Stat.CACHE_HITS) != hits or bpf != ref:
+        raise RuntimeError("Unexpected filter from the cache directory")
+
+def disk_test():
+    # generate the filter without the cache
+    set_cache(0)
+    ref = build().export_bpf_mem()
+    path = tempfile.mkdtemp(prefix="61-sim-bpf_cache.")
+    try:
+        # only keep the filters on disk, not in memory
+        set_cache(0, path)
+        cache_check(ref, 0)
+        name = os.path.join(path, os.listdir(path)[0])
+        cache_check(ref, 1)
+        # a truncated file must be regenerated
+        os.truncate(name, CACHE_HDR_LEN + 1)
+        cache_check(ref, 0)
+        cache_check(ref, 1)
+        # as must a file with a different key
+        with open(name, "r+b") as cache:
+            cache.seek(CACHE_HDR_LEN)
+            byte = cache.read(1)
+            cache.seek(CACHE_HDR_LEN)
+            cache.write(bytes([byte[0] ^ 0xff]))
+        cache_check(ref, 0)
+        cache_check(ref, 1)
+    finally:
+        set_cache(0)
+        shutil.rmtree(path)
+
+def test(args):
+    # share the filter through the cache directory
+    disk_test()
+    set_cache(4)
+    null = open("/dev/null", "w")
+    # generate the filter once to fill the cache
+    f_prev = build()
+    f_prev.export_bpf(null)
+    # a changed filter must not come from the cache
+    f_prev.add_rule_exactly(ALLOW, 1003)
+    f_prev.export_bpf(null)
+    if f_prev.get_stat(Stat.CACHE_HITS) != 0 or \
+       f_prev.get_stat(Stat.CACHE_MISSES) != 2:
+        raise RuntimeError("Used a stale filter from the cache")
+    null.close()
+    # an identical filter should come from the cache
+    return build()
+
+args = util.get_opt()
+ctx = test(args)
+util.filter_output(args, ctx)
+if args.bpf and ctx.get_stat(Stat.CACHE_HITS) != 1:
+    raise RuntimeError("Failed to find the filter in the cache")
+set_cache(0)
+
+# kate: syntax python;
+# kate: indent-mode python; space-indent on; indent-width 4; mixedindent off;
@@ -0,0 +1,100 @@
+/**
+ * Seccomp Library test program
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <seccomp.h>
+
+#include "util.h"
+
+int main(int argc, char *argv[])
+{
+	int rc;
+	ssize_t wr;
+	size_t len, len_small;
+	void *buf = NULL;
+	struct util_options opts;
+	scmp_filter_ctx ctx = NULL;
+
+	rc = util_getopt(argc, argv, &opts);
+	if (rc < 0)
+		goto out;
+
+	ctx = seccomp_init(SCMP_ACT_KILL);
+	if (ctx == NULL)
+		return ENOMEM;
+
+	/* the syscall and argument numbers are all fake to make the test
+	 * simpler */
+
+	rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ALLOW, 1000, 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ERRNO(5), 1001, 1,
+				    SCMP_A0(SCMP_CMP_EQ, 7));
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add_exact(ctx, SCMP_ACT_TRAP, 1002, 2,
+				    SCMP_A0(SCMP_CMP_LT, 3),
+				    SCMP_A2(SCMP_CMP_NE, 9));
+	if (rc != 0)
+		goto out;
+
+	if (!opts.bpf_flg) {
+		rc = util_filter_output(&opts, ctx);
+		goto out;
+	}
+
+	/* query the size of the filter */
+	rc = seccomp_export_bpf_mem(ctx, NULL, &len);
+	if (rc != 0)
+		goto out;
+	if (len == 0) {
+		rc = -EFAULT;
+		goto out;
+	}
+	buf = malloc(len);
+	if (buf == NULL) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	/* a buffer that is too small must be rejected */
+	len_small = len - 1;
+	rc = seccomp_export_bpf_mem(ctx, buf, &len_small);
+	if (rc != -ERANGE || len_small != len) {
+		rc = -EFAULT;
+		goto out;
+	}
+
+	rc = seccomp_export_bpf_mem(ctx, buf, &len);
+	if (rc != 0)
+		goto out;
+	wr = write(STDOUT_FILENO, buf, len);
+	if (wr < 0 || (size_t)wr != len)
+		rc = -EIO;
+
+out:
+	free(buf);
+	seccomp_release(ctx);
+	return (rc < 0 ? -rc : rc);
+}
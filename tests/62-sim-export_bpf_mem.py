@@ -0,0 +1,51 @@
+#!/usr/bin/env python
+
+#
+# Seccomp Library test program
+#
+# Copyright (c) 2020 Nestybox, Inc.
+#
+
+#
+# This library is free software; you can redistribute it and/or modify it
+# under the terms of version 2.1 of the GNU Lesser General Public License as
+# published by the Free Software Foundation.
+#
+# This library is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+# for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this library; if not, see <http://www.gnu.org/licenses>.
+#
+
+import argparse
+import os
+import sys
+
+import util
+
+from seccomp import *
+
+def test(args):
+    f = SyscallFilter(KILL)
+    # the syscall and argument numbers are all fake to make the test simpler
+    f.add_rule_exactly(ALLOW, 1000)
+    f.add_rule_exactly(ERRNO(5), 1001, Arg(0, EQ, 7))
+    f.add_rule_exactly(TRAP, 1002, Arg(0, LT, 3), Arg(2, NE, 9))
+    return f
+
+args = util.get_opt()
+ctx = test(args)
+if args.bpf:
+    bpf = ctx.export_bpf_mem()
+    if len(bpf) == 0 or len(bpf) % 8 != 0:
+        raise RuntimeError("Exported an invalid filter")
+    sys.stdout.flush()
+    os.write(sys.stdout.fileno(), bpf)
+else:
+    util.filter_output(args, ctx)
+
+# kate: syntax python;
+# kate: indent-mode python; space-indent on; indent-width 4; mixedindent off;
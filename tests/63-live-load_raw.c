@@ -0,0 +1,123 @@
+/**
+ * Seccomp Library test program
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <seccomp.h>
+
+#include "util.h"
+
+int main(int argc, char *argv[])
+{
+	int rc;
+	size_t len;
+	void *buf = NULL;
+	scmp_filter_ctx ctx = NULL;
+
+	rc = util_action_parse(argv[1]);
+	if (rc != SCMP_ACT_ALLOW) {
+		rc = 1;
+		goto out;
+	}
+
+	rc = util_trap_install();
+	if (rc != 0)
+		goto out;
+
+	ctx = seccomp_init(SCMP_ACT_TRAP);
+	if (ctx == NULL)
+		return ENOMEM;
+
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(open), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(openat), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(write), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(close), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(rt_sigreturn), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(exit_group), 0);
+	if (rc != 0)
+		goto out;
+
+	/* NOTE - syscall referenced by number, it is not a valid syscall but
+	 *        the filter is evaluated before the kernel notices */
+	rc = seccomp_rule_add_exact(ctx, SCMP_ACT_ERRNO(42), 1000, 1,
+				    SCMP_A0(SCMP_CMP_EQ, 7));
+	if (rc != 0)
+		goto out;
+
+	/* export the filter and drop the context before loading it */
+	rc = seccomp_export_bpf_mem(ctx, NULL, &len);
+	if (rc != 0)
+		goto out;
+	buf = malloc(len);
+	if (buf == NULL) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	rc = seccomp_export_bpf_mem(ctx, buf, &len);
+	if (rc != 0)
+		goto out;
+	seccomp_release(ctx);
+	ctx = NULL;
+
+	/* malformed programs and unknown flags must be rejected */
+	rc = seccomp_load_raw(buf, len - 1, SCMP_LOAD_NNP);
+	if (rc != -EINVAL) {
+		rc = -EFAULT;
+		goto out;
+	}
+	rc = seccomp_load_raw(buf, len, 0x80000000);
+	if (rc != -EINVAL) {
+		rc = -EFAULT;
+		goto out;
+	}
+
+	rc = seccomp_load_raw(buf, len, SCMP_LOAD_NNP);
+	if (rc != 0)
+		goto out;
+
+	rc = syscall(1000, 7);
+	if (rc != -1 || errno != 42) {
+		rc = -EFAULT;
+		goto out;
+	}
+
+	rc = util_file_write("/dev/null");
+	if (rc != 0)
+		goto out;
+
+	rc = 160;
+
+out:
+	seccomp_release(ctx);
+	return (rc < 0 ? -rc : rc);
+}
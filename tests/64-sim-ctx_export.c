@@ -0,0 +1,134 @@
+/**
+ * Seccomp Library test program
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <seccomp.h>
+
+#include "util.h"
+
+int main(int argc, char *argv[])
+{
+	int rc;
+	size_t len, len_new;
+	void *buf = NULL, *buf_new = NULL;
+	struct util_options opts;
+	scmp_filter_ctx ctx = NULL, ctx_new = NULL;
+
+	rc = util_getopt(argc, argv, &opts);
+	if (rc < 0)
+		goto out;
+
+	ctx = seccomp_init(SCMP_ACT_KILL);
+	if (ctx == NULL)
+		return ENOMEM;
+
+	rc = seccomp_arch_remove(ctx, SCMP_ARCH_NATIVE);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_arch_add(ctx, SCMP_ARCH_X86_64);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_arch_add(ctx, SCMP_ARCH_X86);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_attr_set(ctx, SCMP_FLTATR_CTL_OPTIMIZE, 2);
+	if (rc != 0)
+		goto out;
+
+	rc = seccomp_syscall_priority(ctx, SCMP_SYS(close), 200);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(read), 0);
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ERRNO(3), SCMP_SYS(close), 1,
+			      SCMP_A0(SCMP_CMP_EQ, 1));
+	if (rc != 0)
+		goto out;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ERRNO(4), SCMP_SYS(write), 2,
+			      SCMP_A0(SCMP_CMP_GE, 5),
+			      SCMP_A1(SCMP_CMP_MASKED_EQ, 0x0f, 0x02));
+	if (rc != 0)
+		goto out;
+
+	/* export the filter and drop the original */
+	rc = seccomp_export_ctx(ctx, NULL, &len);
+	if (rc != 0)
+		goto out;
+	buf = malloc(len);
+	if (buf == NULL) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	rc = seccomp_export_ctx(ctx, buf, &len);
+	if (rc != 0)
+		goto out;
+	seccomp_release(ctx);
+	ctx = NULL;
+
+	/* truncated and damaged filters must be rejected */
+	rc = seccomp_import_ctx(buf, len - 8, &ctx_new);
+	if (rc != -EINVAL) {
+		rc = -EFAULT;
+		goto out;
+	}
+	((uint8_t *)buf)[0] ^= 0xff;
+	rc = seccomp_import_ctx(buf, len, &ctx_new);
+	((uint8_t *)buf)[0] ^= 0xff;
+	if (rc != -EINVAL) {
+		rc = -EFAULT;
+		goto out;
+	}
+
+	rc = seccomp_import_ctx(buf, len, &ctx_new);
+	if (rc != 0)
+		goto out;
+
+	/* the imported filter must export to the same data */
+	rc = seccomp_export_ctx(ctx_new, NULL, &len_new);
+	if (rc != 0)
+		goto out;
+	buf_new = malloc(len_new);
+	if (buf_new == NULL) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	rc = seccomp_export_ctx(ctx_new, buf_new, &len_new);
+	if (rc != 0)
+		goto out;
+	if (len_new != len || memcmp(buf, buf_new, len) != 0) {
+		rc = -EFAULT;
+		goto out;
+	}
+
+	rc = util_filter_output(&opts, ctx_new);
+	if (rc)
+		goto out;
+
+out:
+	free(buf);
+	free(buf_new);
+	seccomp_release(ctx);
+	seccomp_release(ctx_new);
+	return (rc < 0 ? -rc : rc);
+}
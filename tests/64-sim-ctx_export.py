@@ -0,0 +1,59 @@
+#!/usr/bin/env python
+
+#
+# Seccomp Library test program
+#
+# Copyright (c) 2020 Nestybox, Inc.
+#
+
+#
+# This library is free software; you can redistribute it and/or modify it
+# under the terms of version 2.1 of the GNU Lesser General Public License as
+# published by the Free Software Foundation.
+#
+# This library is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+# for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this library; if not, see <http://www.gnu.org/licenses>.
+#
+
+import argparse
+import sys
+
+import util
+
+from seccomp import *
+
+def test(args):
+    f = SyscallFilter(KILL)
+    f.remove_arch(Arch())
+    f.add_arch(Arch("x86_64"))
+    f.add_arch(Arch("x86"))
+    f.set_attr(Attr.CTL_OPTIMIZE, 2)
+    f.syscall_priority("close", 200)
+    f.add_rule(ALLOW, "read")
+    f.add_rule(ERRNO(3), "close", Arg(0, EQ, 1))
+    f.add_rule(ERRNO(4), "write",
+               Arg(0, GE, 5), Arg(1, MASKED_EQ, 0x0f, 0x02))
+    data = f.export_ctx()
+    g = SyscallFilter(ALLOW)
+    try:
+        g.import_ctx(data[:-8])
+    except ValueError:
+        pass
+    else:
+        raise RuntimeError("Imported a truncated filter")
+    g.import_ctx(data)
+    if g.export_ctx() != data:
+        raise RuntimeError("Imported filter differs from the original")
+    return g
+
+args = util.get_opt()
+ctx = test(args)
+util.filter_output(args, ctx)
+
+# kate: syntax python;
+# kate: indent-mode python; space-indent on; indent-width 4; mixedindent off;
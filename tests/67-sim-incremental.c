@@ -0,0 +1,170 @@
+/**
+ * Seccomp Library test program
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <seccomp.h>
+
+#include "util.h"
+
+static int filter_rules(scmp_filter_ctx ctx, unsigned int stage)
+{
+	int rc;
+
+	if (stage == 0) {
+		rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(read), 0);
+		if (rc != 0)
+			return rc;
+		rc = seccomp_rule_add(ctx, SCMP_ACT_ERRNO(3), SCMP_SYS(close), 1,
+				      SCMP_A0(SCMP_CMP_EQ, 1));
+		if (rc != 0)
+			return rc;
+		rc = seccomp_rule_add(ctx, SCMP_ACT_ERRNO(4), SCMP_SYS(write), 2,
+				      SCMP_A0(SCMP_CMP_GE, 5),
+				      SCMP_A1(SCMP_CMP_MASKED_EQ, 0x0f, 0x02));
+		if (rc != 0)
+			return rc;
+		return seccomp_rule_add(ctx, SCMP_ACT_TRAP, SCMP_SYS(openat), 1,
+					SCMP_A2(SCMP_CMP_NE, 0));
+	}
+
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ERRNO(5), SCMP_SYS(close), 1,
+			      SCMP_A0(SCMP_CMP_EQ, 2));
+	if (rc != 0)
+		return rc;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ERRNO(6), SCMP_SYS(write), 1,
+			      SCMP_A0(SCMP_CMP_EQ, 0));
+	if (rc != 0)
+		return rc;
+	rc = seccomp_rule_add(ctx, SCMP_ACT_ALLOW, SCMP_SYS(getpid), 0);
+	if (rc != 0)
+		return rc;
+	return seccomp_syscall_priority(ctx, SCMP_SYS(openat), 100);
+}
+
+static scmp_filter_ctx filter(void)
+{
+	int rc;
+	scmp_filter_ctx ctx;
+
+	ctx = seccomp_init(SCMP_ACT_KILL);
+	if (ctx == NULL)
+		return NULL;
+
+	rc = seccomp_arch_remove(ctx, SCMP_ARCH_NATIVE);
+	if (rc != 0)
+		goto fail;
+	rc = seccomp_arch_add(ctx, SCMP_ARCH_X86_64);
+	if (rc != 0)
+		goto fail;
+	rc = seccomp_arch_add(ctx, SCMP_ARCH_X86);
+	if (rc != 0)
+		goto fail;
+	rc = seccomp_arch_add(ctx, SCMP_ARCH_AARCH64);
+	if (rc != 0)
+		goto fail;
+
+	return ctx;
+
+fail:
+	seccomp_release(ctx);
+	return NULL;
+}
+
+static void *filter_bpf(scmp_filter_ctx ctx, size_t *len)
+{
+	void *buf;
+
+	if (seccomp_export_bpf_mem(ctx, NULL, len) != 0)
+		return NULL;
+	buf = malloc(*len);
+	if (buf == NULL)
+		return NULL;
+	if (seccomp_export_bpf_mem(ctx, buf, len) != 0) {
+		free(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+int main(int argc, char *argv[])
+{
+	int rc;
+	size_t len, len_full;
+	void *buf = NULL, *buf_full = NULL;
+	struct util_options opts;
+	scmp_filter_ctx ctx = NULL, ctx_full = NULL;
+
+	rc = util_getopt(argc, argv, &opts);
+	if (rc < 0)
+		goto out;
+
+	ctx = filter();
+	ctx_full = filter();
+	if (ctx == NULL || ctx_full == NULL) {
+		rc = ENOMEM;
+		goto out;
+	}
+
+	/* generate the filter, then change it and generate it again */
+	rc = filter_rules(ctx, 0);
+	if (rc != 0)
+		goto out;
+	buf = filter_bpf(ctx, &len);
+	if (buf == NULL) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	free(buf);
+	rc = filter_rules(ctx, 1);
+	if (rc != 0)
+		goto out;
+	buf = filter_bpf(ctx, &len);
+
+	/* the result must match a filter generated from scratch */
+	rc = filter_rules(ctx_full, 0);
+	if (rc != 0)
+		goto out;
+	rc = filter_rules(ctx_full, 1);
+	if (rc != 0)
+		goto out;
+	buf_full = filter_bpf(ctx_full, &len_full);
+	if (buf == NULL || buf_full == NULL) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	if (len != len_full || memcmp(buf, buf_full, len) != 0) {
+		rc = -EFAULT;
+		goto out;
+	}
+
+	rc = util_filter_output(&opts, ctx);
+
+out:
+	free(buf);
+	free(buf_full);
+	seccomp_release(ctx);
+	seccomp_release(ctx_full);
+	return (rc < 0 ? -rc : rc);
+}
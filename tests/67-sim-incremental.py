@@ -0,0 +1,68 @@
+#!/usr/bin/env python
+
+#
+# Seccomp Library test program
+#
+# Copyright (c) 2020 Nestybox, Inc.
+#
+
+#
+# This library is free software; you can redistribute it and/or modify it
+# under the terms of version 2.1 of the GNU Lesser General Public License as
+# published by the Free Software Foundation.
+#
+# This library is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+# for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this library; if not, see <http://www.gnu.org/licenses>.
+#
+
+import argparse
+import sys
+
+import util
+
+from seccomp import *
+
+def add_rules(f, stage):
+    if stage == 0:
+        f.add_rule(ALLOW, "read")
+        f.add_rule(ERRNO(3), "close", Arg(0, EQ, 1))
+        f.add_rule(ERRNO(4), "write",
+                   Arg(0, GE, 5), Arg(1, MASKED_EQ, 0x0f, 0x02))
+        f.add_rule(TRAP, "openat", Arg(2, NE, 0))
+    else:
+        f.add_rule(ERRNO(5), "close", Arg(0, EQ, 2))
+        f.add_rule(ERRNO(6), "write", Arg(0, EQ, 0))
+        f.add_rule(ALLOW, "getpid")
+        f.syscall_priority("openat", 100)
+
+def build_filter():
+    f = SyscallFilter(KILL)
+    f.remove_arch(Arch())
+    f.add_arch(Arch("x86_64"))
+    f.add_arch(Arch("x86"))
+    f.add_arch(Arch("aarch64"))
+    return f
+
+def test(args):
+    f = build_filter()
+    add_rules(f, 0)
+    f.export_bpf_mem()
+    add_rules(f, 1)
+    f_full = build_filter()
+    add_rules(f_full, 0)
+    add_rules(f_full, 1)
+    if f.export_bpf_mem() != f_full.export_bpf_mem():
+        raise RuntimeError("Regenerated filter differs from the full filter")
+    return f
+
+args = util.get_opt()
+ctx = test(args)
+util.filter_output(args, ctx)
+
+# kate: syntax python;
+# kate: indent-mode python; space-indent on; indent-width 4; mixedindent off;
@@ -0,0 +1,109 @@
+/**
+ * Seccomp Library test program
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include <seccomp.h>
+
+#define ARCH_CNT	(sizeof(arch_list) / sizeof(arch_list[0]))
+#define NAME_CNT	(sizeof(name_list) / sizeof(name_list[0]))
+
+uint32_t arch_list[] = {
+	SCMP_ARCH_NATIVE,
+	SCMP_ARCH_X86,
+	SCMP_ARCH_X86_64,
+	SCMP_ARCH_X32,
+	SCMP_ARCH_ARM,
+	SCMP_ARCH_AARCH64,
+	SCMP_ARCH_MIPS,
+	SCMP_ARCH_MIPS64,
+	SCMP_ARCH_MIPS64N32,
+	SCMP_ARCH_MIPSEL,
+	SCMP_ARCH_MIPSEL64,
+	SCMP_ARCH_MIPSEL64N32,
+	SCMP_ARCH_PPC,
+	SCMP_ARCH_PPC64,
+	SCMP_ARCH_PPC64LE,
+	SCMP_ARCH_S390,
+	SCMP_ARCH_S390X,
+	SCMP_ARCH_PARISC,
+	SCMP_ARCH_PARISC64,
+};
+
+const char *name_list[] = {
+	"open",
+	"read",
+	"INVALID",
+	"socket",
+	"recvmmsg",
+	"shmctl",
+	"breakpoint",
+	"_llseek",
+	NULL,
+	"writev",
+};
+
+int main(int argc, char *argv[])
+{
+	int rc;
+	unsigned int iter_a, iter_n;
+	uint32_t arch_bad[2] = { SCMP_ARCH_NATIVE, -1 };
+	int syscalls[NAME_CNT * ARCH_CNT];
+
+	rc = seccomp_syscall_resolve_names(arch_list, ARCH_CNT,
+					   name_list, NAME_CNT, syscalls);
+	if (rc != 0)
+		return 1;
+
+	/* the results must match resolving the syscalls one at a time */
+	for (iter_n = 0; iter_n < NAME_CNT; iter_n++) {
+		for (iter_a = 0; iter_a < ARCH_CNT; iter_a++) {
+			rc = seccomp_syscall_resolve_name_arch(arch_list[iter_a],
+							name_list[iter_n]);
+			if (syscalls[iter_n * ARCH_CNT + iter_a] != rc)
+				return 1;
+		}
+	}
+	if (syscalls[0] != __SNR_open || syscalls[ARCH_CNT] != __SNR_read)
+		return 1;
+	if (syscalls[2 * ARCH_CNT] != __NR_SCMP_ERROR ||
+	    syscalls[8 * ARCH_CNT] != __NR_SCMP_ERROR)
+		return 1;
+
+	/* an invalid arch must fail without touching the results */
+	syscalls[0] = 0;
+	rc = seccomp_syscall_resolve_names(arch_bad, 2, name_list, NAME_CNT,
+					   syscalls);
+	if (rc != -EINVAL || syscalls[0] != 0)
+		return 1;
+	rc = seccomp_syscall_resolve_names(arch_list, ARCH_CNT, NULL, NAME_CNT,
+					   syscalls);
+	if (rc != -EINVAL)
+		return 1;
+
+	/* nothing to resolve */
+	rc = seccomp_syscall_resolve_names(arch_list, 0, name_list, NAME_CNT,
+					   NULL);
+	if (rc != 0)
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * Seccomp Library test program
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <seccomp.h>
+
+#define ARCH_CNT	(sizeof(arch_list) / sizeof(arch_list[0]))
+
+uint32_t arch_list[] = {
+	SCMP_ARCH_NATIVE,
+	SCMP_ARCH_X86,
+	SCMP_ARCH_X86_64,
+	SCMP_ARCH_X32,
+	SCMP_ARCH_ARM,
+	SCMP_ARCH_AARCH64,
+	SCMP_ARCH_MIPS,
+	SCMP_ARCH_MIPS64,
+	SCMP_ARCH_MIPS64N32,
+	SCMP_ARCH_MIPSEL,
+	SCMP_ARCH_MIPSEL64,
+	SCMP_ARCH_MIPSEL64N32,
+	SCMP_ARCH_PPC,
+	SCMP_ARCH_PPC64,
+	SCMP_ARCH_PPC64LE,
+	SCMP_ARCH_S390,
+	SCMP_ARCH_S390X,
+	SCMP_ARCH_PARISC,
+	SCMP_ARCH_PARISC64,
+};
+
+int main(int argc, char *argv[])
+{
+	int rc;
+	unsigned int iter;
+	int num;
+	const char *name;
+	char *name_dup = NULL;
+
+	rc = seccomp_syscall_resolve_name("read");
+	name = seccomp_syscall_resolve_num_arch_static(SCMP_ARCH_NATIVE, rc);
+	if (name == NULL || strcmp(name, "read") != 0)
+		goto fail;
+	if (seccomp_syscall_resolve_num_arch_static(-1, rc) != NULL)
+		goto fail;
+
+	for (iter = 0; iter < ARCH_CNT; iter++) {
+		/* regular and pseudo syscall numbers */
+		for (num = -10300; num < 1100; num++) {
+			name = seccomp_syscall_resolve_num_arch_static(
+							arch_list[iter], num);
+			name_dup = seccomp_syscall_resolve_num_arch(
+							arch_list[iter], num);
+			if ((name == NULL) != (name_dup == NULL))
+				goto fail;
+			if (name != NULL && strcmp(name, name_dup) != 0)
+				goto fail;
+			free(name_dup);
+			name_dup = NULL;
+
+			/* the name must stay the same across calls */
+			if (name != NULL &&
+			    seccomp_syscall_resolve_num_arch_static(
+					arch_list[iter], num) != name)
+				goto fail;
+		}
+	}
+
+	return 0;
+
+fail:
+	if (name_dup != NULL)
+		free(name_dup);
+	return 1;
+}
@@ -0,0 +1,48 @@
+#!/usr/bin/env python
+
+#
+# Seccomp Library test program
+#
+# Copyright (c) 2020 Nestybox, Inc.
+#
+
+#
+# This library is free software; you can redistribute it and/or modify it
+# under the terms of version 2.1 of the GNU Lesser General Public License as
+# published by the Free Software Foundation.
+#
+# This library is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+# for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with this library; if not, see <http://www.gnu.org/licenses>.
+#
+
+import argparse
+import sys
+
+import util
+
+from seccomp import *
+
+def test():
+    for arch in [Arch(), Arch("x86"), Arch("x86_64"), Arch("aarch64")]:
+        for name in ["open", "read", "socket", "writev"]:
+            sys_num = resolve_syscall(arch, name)
+            if sys_num < 0:
+                continue
+            if resolve_syscall(arch, sys_num) != name.encode():
+                raise RuntimeError("Test failure")
+    try:
+        resolve_syscall(Arch(), -1)
+    except ValueError:
+        pass
+    else:
+        raise RuntimeError("Test failure")
+
+test()
+
+# kate: syntax python;
+# kate: indent-mode python; space-indent on; indent-width 4; mixedindent off;
@@ -0,0 +1,173 @@
+/**
+ * BPF Generation Benchmark
+ *
+ * Copyright (c) 2020 Nestybox, Inc.
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of version 2.1 of the GNU Lesser General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, see <http://www.gnu.org/licenses>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <seccomp.h>
+
+/**
+ * Print the usage information to stderr and exit
+ * @param program the name of the current program being invoked
+ *
+ * Print the usage information and exit with EINVAL.
+ *
+ */
+static void exit_usage(const char *program)
+{
+	fprintf(stderr,
+		"usage: %s [-h] [-m] [-t] [-n <rules>] [-i <iterations>]\n",
+		program);
+	exit(EINVAL);
+}
+
+/**
+ * Return the elapsed time between two timestamps in milliseconds
+ * @param start the start time
+ * @param end the end time
+ */
+static double time_ms(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e3 +
+	       (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/**
+ * main
+ */
+int main(int argc, char *argv[])
+{
+	int rc;
+	int opt;
+	int fd = -1;
+	FILE *fp;
+	int multi = 0, tree = 0;
+	unsigned int iter, iter_j;
+	unsigned int rules = 100, iterations = 10;
+	struct stat st;
+	struct timespec t_start, t_end;
+	scmp_filter_ctx ctx = NULL;
+
+	/* parse the command line */
+	while ((opt = getopt(argc, argv, "hmtn:i:")) > 0) {
+		switch (opt) {
+		case 'm':
+			multi = 1;
+			break;
+		case 't':
+			tree = 1;
+			break;
+		case 'n':
+			rules = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			iterations = strtoul(optarg, NULL, 0);
+			if (iterations == 0)
+				exit_usage(argv[0]);
+			break;
+		case 'h':
+		default:
+			/* usage information */
+			exit_usage(argv[0]);
+		}
+	}
+
+	ctx = seccomp_init(SCMP_ACT_ALLOW);
+	if (ctx == NULL)
+		return ENOMEM;
+	if (multi) {
+		rc = seccomp_arch_add(ctx, SCMP_ARCH_X86);
+		if (rc != 0 && rc != -EEXIST)
+			goto out;
+		rc = seccomp_arch_add(ctx, SCMP_ARCH_X32);
+		if (rc != 0 && rc != -EEXIST)
+			goto out;
+		rc = seccomp_arch_add(ctx, SCMP_ARCH_AARCH64);
+		if (rc != 0 && rc != -EEXIST)
+			goto out;
+	}
+	if (tree) {
+		rc = seccomp_attr_set(ctx, SCMP_FLTATR_CTL_OPTIMIZE, 2);
+		if (rc != 0)
+			goto out;
+	}
+
+	/* a mix of syscalls with several argument chains each */
+	for (iter = 0; iter < rules; iter++) {
+		for (iter_j = 0; iter_j < 3; iter_j++) {
+			rc = seccomp_rule_add(ctx,
+					      SCMP_ACT_ERRNO(iter % 7),
+					      iter % 300, 2,
+					      SCMP_A0(SCMP_CMP_EQ,
+						      iter * 3 + iter_j),
+					      SCMP_A1(SCMP_CMP_MASKED_EQ,
+						      0xff, iter_j));
+			if (rc != 0)
+				goto out;
+		}
+	}
+
+	/* measure the filter once */
+	fp = tmpfile();
+	if (fp == NULL) {
+		rc = -errno;
+		goto out;
+	}
+	rc = seccomp_export_bpf(ctx, fileno(fp));
+	if (rc == 0 && fstat(fileno(fp), &st) < 0)
+		rc = -errno;
+	fclose(fp);
+	if (rc != 0)
+		goto out;
+
+	/* time the filter generation */
+	fd = open("/dev/null", O_WRONLY);
+	if (fd < 0) {
+		rc = -errno;
+		goto out;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	for (iter = 0; iter < iterations; iter++) {
+		rc = seccomp_export_bpf(ctx, fd);
+		if (rc != 0)
+			goto out;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+	printf("rules: %u\n", rules * 3);
+	printf("instructions: %lld\n", (long long)st.st_size / 8);
+	printf("generation: %.3f ms\n",
+	       time_ms(&t_start, &t_end) / iterations);
+
+out:
+	if (fd >= 0)
+		close(fd);
+	seccomp_release(ctx);
+	if (rc < 0) {
+		fprintf(stderr, "error: %d\n", rc);
+		return -rc;
+	}
+	return 0;
+}
@@ -81,7 +81,8 @@ int main(int argc, char *argv[])
 	/* perform the syscall lookup */
 	if (isdigit(argv[optind][0]) || argv[optind][0] == '-') {
 		sys_num = atoi(argv[optind]);
-		sys_name = seccomp_syscall_resolve_num_arch(arch, sys_num);
+		sys_name = seccomp_syscall_resolve_num_arch_static(arch,
+								   sys_num);
 		printf("%s\n", (sys_name ? sys_name : "UNKNOWN"));
 	} else if (translate) {
 		sys_num = seccomp_syscall_resolve_name_rewrite(arch,